@@ -1,44 +1,391 @@
 #include "dm.h"
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+#ifdef DM_ZSTD
+#include <zstd.h>
+#endif
+#ifdef DM_LZ4
+#include <lz4.h>
+#endif
+
+// memory stats
+// global since arenas and pools don't know which context they belong to.
+// job workers and vulkan allocation callbacks record too, so every update is atomic
+static dm_mem_stats dm_mem_tag_stats[DM_MEM_TAG_COUNT];
+
+static const char* dm_mem_tag_names[DM_MEM_TAG_COUNT] = {
+    "unknown", "context", "frame", "pool", "renderer", "gpu device", "gpu host"
+};
+
+dm_mem_stats* dm_mem_get_tag_stats(dm_mem_tag tag)
+{
+    if(tag >= DM_MEM_TAG_COUNT) tag = DM_MEM_TAG_UNKNOWN;
+
+    return &dm_mem_tag_stats[tag];
+}
+
+void dm_mem_record_alloc(dm_mem_tag tag, size_t size)
+{
+    dm_mem_stats *stats = dm_mem_get_tag_stats(tag);
+
+    size_t in_use = DM_ATOMIC_ADD64(&stats->in_use, size);
+    DM_ATOMIC_ADD64(&stats->alloc_count, 1);
+
+    // another thread may have raised the peak in between, only ever move it up
+    size_t peak = DM_ATOMIC_LOAD64(&stats->peak);
+    while(in_use > peak && !DM_ATOMIC_CAS64(&stats->peak, peak, in_use)) peak = DM_ATOMIC_LOAD64(&stats->peak);
+}
+
+void dm_mem_record_free(dm_mem_tag tag, size_t size)
+{
+    dm_mem_stats *stats = dm_mem_get_tag_stats(tag);
+
+    DM_ATOMIC_SUB64(&stats->in_use, size);
+    DM_ATOMIC_ADD64(&stats->free_count, 1);
+}
+
+// an arena dropping everything past a marker at once, counted apart from frees
+void dm_mem_record_reset(dm_mem_tag tag, size_t size)
+{
+    dm_mem_stats *stats = dm_mem_get_tag_stats(tag);
+
+    DM_ATOMIC_SUB64(&stats->in_use, size);
+    DM_ATOMIC_ADD64(&stats->reset_count, 1);
+}
+
+void dm_mem_record_commit(dm_mem_tag tag, size_t size)
+{
+    DM_ATOMIC_ADD64(&dm_mem_get_tag_stats(tag)->committed, size);
+}
+
+void dm_mem_record_decommit(dm_mem_tag tag, size_t size)
+{
+    DM_ATOMIC_SUB64(&dm_mem_get_tag_stats(tag)->committed, size);
+}
+
+void dm_mem_record_failed(dm_mem_tag tag)
+{
+    DM_ATOMIC_ADD64(&dm_mem_get_tag_stats(tag)->failed_count, 1);
+}
+
+void dm_mem_get_stats(dm_mem_tag tag, dm_mem_stats *stats)
+{
+    dm_mem_stats *src = dm_mem_get_tag_stats(tag);
+
+    stats->in_use       = DM_ATOMIC_LOAD64(&src->in_use);
+    stats->peak         = DM_ATOMIC_LOAD64(&src->peak);
+    stats->committed    = DM_ATOMIC_LOAD64(&src->committed);
+    stats->alloc_count  = DM_ATOMIC_LOAD64(&src->alloc_count);
+    stats->free_count   = DM_ATOMIC_LOAD64(&src->free_count);
+    stats->reset_count  = DM_ATOMIC_LOAD64(&src->reset_count);
+    stats->failed_count = DM_ATOMIC_LOAD64(&src->failed_count);
+}
+
+const char* dm_mem_tag_name(dm_mem_tag tag)
+{
+    if(tag >= DM_MEM_TAG_COUNT) return "invalid";
+
+    return dm_mem_tag_names[tag];
+}
+
+void dm_mem_dump_stats()
+{
+    LOG_INFO("Memory stats:");
+    for(u32 i=0; i<DM_MEM_TAG_COUNT; i++)
+    {
+        dm_mem_stats stats;
+        dm_mem_get_stats(i, &stats);
+        if(!stats.alloc_count && !stats.failed_count && !stats.committed) continue;
+
+        LOG_INFO("    %-10s in use: %zu  peak: %zu  committed: %zu  allocs: %llu  frees: %llu  resets: %llu  failed: %llu",
+                 dm_mem_tag_names[i], stats.in_use, stats.peak, stats.committed,
+                 (unsigned long long)stats.alloc_count, (unsigned long long)stats.free_count,
+                 (unsigned long long)stats.reset_count, (unsigned long long)stats.failed_count);
+    }
+}
+
+// alloc guard
+#ifdef DM_ALLOC_GUARD
+typedef struct dm_alloc_guard_t
+{
+    u64  frame;
+    u32  warmup_frames;
+    bool fail_on_alloc;
+} dm_alloc_guard;
+
+static dm_alloc_guard dm_alloc_guard_state = { .warmup_frames=DM_ALLOC_GUARD_DEFAULT_WARMUP };
+
+// thread local so allocations from driver or worker threads don't count against the frame
+static DM_THREAD_LOCAL bool dm_alloc_guard_armed;
+static DM_THREAD_LOCAL u64  dm_alloc_guard_heap_allocs;
+static DM_THREAD_LOCAL u64  dm_alloc_guard_host_allocs;
+
+#ifdef __GLIBC__
+// nothing in here may log or allocate
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void *ptr, size_t size);
+extern void* __libc_memalign(size_t alignment, size_t size);
+extern void  __libc_free(void *ptr);
+
+void* malloc(size_t size)
+{
+    if(dm_alloc_guard_armed) dm_alloc_guard_heap_allocs++;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    if(dm_alloc_guard_armed) dm_alloc_guard_heap_allocs++;
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void *ptr, size_t size)
+{
+    if(dm_alloc_guard_armed) dm_alloc_guard_heap_allocs++;
+    return __libc_realloc(ptr, size);
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+    if(dm_alloc_guard_armed) dm_alloc_guard_heap_allocs++;
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+    if(dm_alloc_guard_armed) dm_alloc_guard_heap_allocs++;
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size)
+{
+    if(dm_alloc_guard_armed) dm_alloc_guard_heap_allocs++;
+
+    // same checks glibc does, memalign alone would round a bad alignment up
+    if(!alignment || alignment % sizeof(void*) || (alignment & (alignment - 1))) return EINVAL;
+
+    void *memory = __libc_memalign(alignment, size);
+    if(!memory) return ENOMEM;
+
+    *ptr = memory;
+    return 0;
+}
+#endif
+
+void dm_alloc_guard_begin_frame()
+{
+    dm_alloc_guard_heap_allocs = 0;
+    dm_alloc_guard_host_allocs = 0;
+    dm_alloc_guard_armed = ++dm_alloc_guard_state.frame > dm_alloc_guard_state.warmup_frames;
+}
+
+// for exits that never reach dm_alloc_guard_end_frame, nothing is reported
+void dm_alloc_guard_disarm()
+{
+    dm_alloc_guard_armed = false;
+}
+
+bool dm_alloc_guard_end_frame()
+{
+    if(!dm_alloc_guard_armed) return true;
+    dm_alloc_guard_armed = false;
+
+    if(!dm_alloc_guard_heap_allocs && !dm_alloc_guard_host_allocs) return true;
+
+    if(dm_alloc_guard_state.fail_on_alloc)
+    {
+        LOG_ERROR("Frame %llu allocated in steady state: %llu heap, %llu vulkan host", (unsigned long long)dm_alloc_guard_state.frame, (unsigned long long)dm_alloc_guard_heap_allocs, (unsigned long long)dm_alloc_guard_host_allocs);
+        return false;
+    }
+
+    LOG_WARN("Frame %llu allocated in steady state: %llu heap, %llu vulkan host", (unsigned long long)dm_alloc_guard_state.frame, (unsigned long long)dm_alloc_guard_heap_allocs, (unsigned long long)dm_alloc_guard_host_allocs);
+    return true;
+}
+#endif
+
+void dm_alloc_guard_configure(u32 warmup_frames, bool fail_on_alloc)
+{
+#ifdef DM_ALLOC_GUARD
+    dm_alloc_guard_state.warmup_frames = warmup_frames;
+    dm_alloc_guard_state.fail_on_alloc = fail_on_alloc;
+#endif
+}
+
+void dm_alloc_guard_record_alloc()
+{
+#ifdef DM_ALLOC_GUARD
+    if(dm_alloc_guard_armed) dm_alloc_guard_host_allocs++;
+#endif
+}
+
+// skips the interposed malloc, for allocations that are already counted elsewhere
+void* dm_alloc_guard_untracked_malloc(size_t size)
+{
+#if defined(DM_ALLOC_GUARD) && defined(__GLIBC__)
+    return __libc_malloc(size);
+#else
+    return malloc(size);
+#endif
+}
+
+void dm_alloc_guard_untracked_free(void *ptr)
+{
+#if defined(DM_ALLOC_GUARD) && defined(__GLIBC__)
+    __libc_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
 // arena
-void dm_arena_create(dm_arena *arena, size_t size)
+#define DM_ARENA_HUGE_PAGE_SIZE (2 * DM_MEGABYTE)
+
+static size_t dm_arena_get_commit_size(dm_arena *arena)
+{
+    if(arena->flags & DM_ARENA_FLAG_HUGE_PAGES) return DM_ARENA_HUGE_PAGE_SIZE;
+
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    size_t page_size = info.dwPageSize;
+#else
+    size_t page_size = sysconf(_SC_PAGESIZE);
+#endif
+
+    return page_size > DM_ARENA_COMMIT_SIZE ? page_size : DM_ARENA_COMMIT_SIZE;
+}
+
+static bool dm_arena_commit(dm_arena *arena, size_t size)
 {
-#ifdef __AVX__
-    size = DM_ALIGN(size, 32);
+    size_t commit_size = dm_arena_get_commit_size(arena);
+
+    size = DM_ALIGN(size, commit_size);
+    if(size <= arena->capacity) return true;
+    if(size > arena->reserved)
+    {
+        LOG_ERROR("Arena would grow beyond its reserved range");
+        return false;
+    }
+
+    u8* base = (u8*)arena->start + arena->capacity;
+    size_t grow = size - arena->capacity;
+
+#ifdef _WIN32
+    if(!VirtualAlloc(base, grow, MEM_COMMIT, PAGE_READWRITE))
+    {
+        LOG_ERROR("VirtualAlloc commit failed");
+        return false;
+    }
 #else
-    size = DM_ALIGN(size, 16);
+    if(mprotect(base, grow, PROT_READ | PROT_WRITE) != 0)
+    {
+        LOG_ERROR("mprotect failed");
+        return false;
+    }
 #endif
+
+    dm_mem_record_commit(arena->tag, grow);
     arena->capacity = size;
-    arena->start = calloc(sizeof(u8), size);
-    arena->current = arena->start;
+
+    return true;
+}
+
+bool dm_arena_create_ex(dm_arena *arena, size_t size, size_t reserve, dm_arena_flag flags, dm_mem_tag tag)
+{
+    *arena = (dm_arena){ .flags=flags, .tag=tag };
+
+    size_t commit_size = dm_arena_get_commit_size(arena);
+    if(reserve < size) reserve = size;
+    reserve = DM_ALIGN(reserve, commit_size);
+
+#ifdef _WIN32
+    arena->start = VirtualAlloc(NULL, reserve, MEM_RESERVE, PAGE_NOACCESS);
+#else
+    arena->start = mmap(NULL, reserve, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if(arena->start == MAP_FAILED) arena->start = NULL;
+#endif
+    if(!arena->start)
+    {
+        LOG_ERROR("Could not reserve %zu bytes for %s arena", reserve, dm_mem_tag_name(tag));
+        dm_mem_record_failed(tag);
+        return false;
+    }
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    // mmap only page aligns the base, the hint only applies to the 2MB aligned part of the range
+    if(flags & DM_ARENA_FLAG_HUGE_PAGES)
+    {
+        uintptr_t huge_start = DM_ALIGN((uintptr_t)arena->start, (uintptr_t)DM_ARENA_HUGE_PAGE_SIZE);
+        uintptr_t huge_end   = ((uintptr_t)arena->start + reserve) & ~((uintptr_t)DM_ARENA_HUGE_PAGE_SIZE - 1);
+
+        if(huge_end > huge_start) madvise((void*)huge_start, huge_end - huge_start, MADV_HUGEPAGE);
+    }
+#endif
+
+    arena->reserved = reserve;
+    arena->current  = arena->start;
+
+    return dm_arena_commit(arena, size);
+}
+
+bool dm_arena_create(dm_arena *arena, size_t size)
+{
+    return dm_arena_create_ex(arena, size, DM_ARENA_DEFAULT_RESERVE, 0, DM_MEM_TAG_UNKNOWN);
 }
 
 void dm_arena_detroy(dm_arena *arena)
 {
-    free(arena->start);
+    if(!arena->start) return;
+
+    if(arena->size) dm_mem_record_reset(arena->tag, arena->size);
+    dm_mem_record_decommit(arena->tag, arena->capacity);
+
+#ifdef _WIN32
+    VirtualFree(arena->start, 0, MEM_RELEASE);
+#else
+    munmap(arena->start, arena->reserved);
+#endif
     arena->start = NULL;
     arena->current = NULL;
+    arena->size = 0;
+    arena->capacity = 0;
+    arena->reserved = 0;
+    arena->peak = 0;
 }
 
 void* dm_arena_alloc(dm_arena *arena, size_t size, size_t* offset)
 {
-    if(arena->size + size >= arena->capacity) 
+    size = DM_ALIGN(size, DM_ARENA_ALIGNMENT);
+
+    if(arena->size + size > arena->capacity && !dm_arena_commit(arena, arena->size + size)) 
     {
-        LOG_ERROR("Trying to allocate beyond size of arena");
+        LOG_ERROR("Trying to allocate %zu bytes beyond size of %s arena (%zu used, %zu reserved)", size, dm_mem_tag_name(arena->tag), arena->size, arena->reserved);
+        dm_mem_record_failed(arena->tag);
         return NULL;
     }
 
-#ifdef __AVX__
-    size = DM_ALIGN(size, 32);
-#else
-    size = DM_ALIGN(size, 16);
-#endif
-
-    *offset = arena->size;
+    if(offset) *offset = arena->size;
     arena->size += size;
     arena->current += size;
+    if(arena->size > arena->peak) arena->peak = arena->size;
+
+    dm_mem_record_alloc(arena->tag, size);
 
-    return arena->current - size;;
+    // fresh pages are zero but memory reused after a reset is not, callers expect calloc behaviour
+    void *result = arena->current - size;
+    memset(result, 0, size);
+
+    return result;
 }
 
 void* dm_arena_get_ptr(dm_arena arena, size_t offset)
@@ -46,6 +393,138 @@ void* dm_arena_get_ptr(dm_arena arena, size_t offset)
     return arena.start + offset;
 }
 
+// memory after a marker is handed out again by later allocs, which zero it
+dm_arena_marker dm_arena_get_marker(dm_arena *arena)
+{
+    return arena->size;
+}
+
+void dm_arena_reset_to_marker(dm_arena *arena, dm_arena_marker marker)
+{
+    if(marker > arena->size)
+    {
+        LOG_ERROR("Arena marker is past the current arena size");
+        return;
+    }
+
+    if(marker < arena->size) dm_mem_record_reset(arena->tag, arena->size - marker);
+
+    arena->size    = marker;
+    arena->current = arena->start + marker;
+}
+
+void dm_arena_reset(dm_arena *arena)
+{
+    dm_arena_reset_to_marker(arena, 0);
+}
+
+// pool
+// slot header sits in front of the element, a live slot has an odd generation.
+// generations wrap at the handle's bit width. the modulus (1 << DM_HANDLE_GENERATION_BITS) is even,
+// so wrapping keeps the parity. the mask itself is odd and has to stay all ones
+typedef struct dm_pool_slot_t
+{
+    u32 generation;
+    u32 next_free;
+} dm_pool_slot;
+
+#define DM_POOL_SLOT_HEADER_SIZE DM_ALIGN(sizeof(dm_pool_slot), DM_ARENA_ALIGNMENT)
+#define DM_POOL_INVALID_SLOT     UINT32_MAX
+
+dm_pool_slot* dm_pool_get_header(dm_pool *pool, u32 index)
+{
+    return (dm_pool_slot*)((u8*)pool->slots.start + (size_t)index * pool->stride);
+}
+
+bool dm_pool_create(dm_pool *pool, size_t element_size, u32 capacity)
+{
+    *pool = (dm_pool){ 0 };
+
+    pool->stride    = DM_POOL_SLOT_HEADER_SIZE + DM_ALIGN(element_size, DM_ARENA_ALIGNMENT);
+    pool->free_head = DM_POOL_INVALID_SLOT;
+
+    return dm_arena_create_ex(&pool->slots, pool->stride * capacity, DM_ARENA_DEFAULT_RESERVE, 0, DM_MEM_TAG_POOL);
+}
+
+void dm_pool_destroy(dm_pool *pool)
+{
+    dm_arena_detroy(&pool->slots);
+    *pool = (dm_pool){ 0 };
+}
+
+void* dm_pool_alloc(dm_pool *pool, u32 *index, u32 *generation)
+{
+    dm_pool_slot *slot = NULL;
+    u32 slot_index;
+
+    if(pool->free_head != DM_POOL_INVALID_SLOT)
+    {
+        slot_index = pool->free_head;
+        slot = dm_pool_get_header(pool, slot_index);
+        pool->free_head = slot->next_free;
+    }
+    else
+    {
+        if(pool->count >= DM_POOL_MAX_SLOTS)
+        {
+            LOG_ERROR("Pool is out of handle indices");
+            return NULL;
+        }
+
+        slot = dm_arena_alloc(&pool->slots, pool->stride, NULL);
+        if(!slot) return NULL;
+
+        slot_index = pool->count++;
+    }
+
+    slot->generation = (slot->generation + 1) & DM_POOL_GENERATION_MASK;
+    slot->next_free = DM_POOL_INVALID_SLOT;
+    pool->live_count++;
+
+    void* element = (u8*)slot + DM_POOL_SLOT_HEADER_SIZE;
+    memset(element, 0, pool->stride - DM_POOL_SLOT_HEADER_SIZE);
+
+    *index      = slot_index;
+    *generation = slot->generation;
+
+    return element;
+}
+
+void* dm_pool_get(dm_pool *pool, u32 index, u32 generation)
+{
+    if(index >= pool->count) return NULL;
+
+    dm_pool_slot *slot = dm_pool_get_header(pool, index);
+    if(slot->generation != generation || !(generation & 1)) return NULL;
+
+    return (u8*)slot + DM_POOL_SLOT_HEADER_SIZE;
+}
+
+// returns NULL for free slots, used to walk every live element
+void* dm_pool_get_slot(dm_pool *pool, u32 index)
+{
+    if(index >= pool->count) return NULL;
+
+    dm_pool_slot *slot = dm_pool_get_header(pool, index);
+    if(!(slot->generation & 1)) return NULL;
+
+    return (u8*)slot + DM_POOL_SLOT_HEADER_SIZE;
+}
+
+bool dm_pool_free(dm_pool *pool, u32 index, u32 generation)
+{
+    if(!dm_pool_get(pool, index, generation)) return false;
+
+    dm_pool_slot *slot = dm_pool_get_header(pool, index);
+
+    slot->generation = (slot->generation + 1) & DM_POOL_GENERATION_MASK;
+    slot->next_free = pool->free_head;
+    pool->free_head = index;
+    pool->live_count--;
+
+    return true;
+}
+
 extern bool dm_window_create(dm_context *context, u16 width, u16 height, const char *title);
 extern void dm_window_destroy(dm_context *context);
 extern void dm_window_poll_events(dm_context *context);
@@ -58,6 +537,14 @@ extern bool dm_renderer_end_frame(dm_context* context);
 extern bool dm_renderer_resize(dm_context *context, u16 width, u16 height);
 extern size_t dm_renderer_get_internal_size();
 
+extern bool dm_jobs_init(dm_context *context);
+extern void dm_jobs_shutdown(dm_context *context);
+extern size_t dm_jobs_get_internal_size();
+
+extern bool dm_io_init(dm_context *context);
+extern void dm_io_shutdown(dm_context *context);
+extern size_t dm_io_get_internal_size();
+
 // context
 bool dm_init(dm_context* context, u16 width, u16 height, const char* title, dm_context_flag flags)
 {
@@ -65,8 +552,24 @@ bool dm_init(dm_context* context, u16 width, u16 height, const char* title, dm_c
 
     size += dm_window_get_internal_size();
     size += dm_renderer_get_internal_size();
+    size += dm_jobs_get_internal_size();
+    size += dm_io_get_internal_size();
+
+    if(!dm_arena_create_ex(&context->arena, size, DM_ARENA_DEFAULT_RESERVE, 0, DM_MEM_TAG_CONTEXT)) return false;
+
+    for(u32 i=0; i<DM_FRAMES_IN_FLIGHT; i++)
+    {
+        if(!dm_arena_create_ex(&context->frame_arenas[i], DM_FRAME_ARENA_SIZE, DM_ARENA_DEFAULT_RESERVE, 0, DM_MEM_TAG_FRAME)) return false;
+    }
+
+    // up before the window and renderer so asset reads can overlap device creation
+    if(!dm_jobs_init(context)) return false;
+    if(!dm_io_init(context))   return false;
 
-    dm_arena_create(&context->arena, size);
+    dm_renderer_limits *limits = &context->renderer.limits;
+    if(!limits->textures) limits->textures = DM_DEFAULT_MAX_TEXTURES;
+    if(!limits->buffers)  limits->buffers  = DM_DEFAULT_MAX_BUFFERS;
+    if(!limits->samplers) limits->samplers = DM_DEFAULT_MAX_SAMPLERS;
 
     if(!dm_window_create(context, width, height, title)) return false;
     if(!dm_renderer_init(context))
@@ -84,12 +587,29 @@ bool dm_init(dm_context* context, u16 width, u16 height, const char* title, dm_c
 
 void dm_shutdown(dm_context* context)
 {
+    // usage at shutdown, before teardown releases everything
+    dm_mem_dump_stats();
+
     dm_renderer_shutdown(context);
     dm_window_destroy(context);
 
+    dm_io_shutdown(context);
+    dm_jobs_shutdown(context);
+
+    dm_archive_close(&context->archive);
+
+    for(u32 i=0; i<DM_FRAMES_IN_FLIGHT; i++)
+    {
+        dm_arena_detroy(&context->frame_arenas[i]);
+    }
     dm_arena_detroy(&context->arena);
 }
 
+void* dm_frame_alloc(dm_context *context, size_t size)
+{
+    return dm_arena_alloc(&context->frame_arenas[context->renderer.current_frame], size, NULL);
+}
+
 bool dm_is_running(dm_context *context)
 {
     return context->flags & DM_CONTEXT_FLAG_IS_RUNNING;
@@ -118,43 +638,612 @@ void dm_update_end(dm_context *context)
 
 bool dm_render_begin(dm_context* context)
 {
-    return dm_renderer_begin_frame(context);
+#ifdef DM_ALLOC_GUARD
+    dm_alloc_guard_begin_frame();
+#endif
+
+    // begin frame waits until the gpu has finished with this frame slot
+    if(!dm_renderer_begin_frame(context))
+    {
+#ifdef DM_ALLOC_GUARD
+        dm_alloc_guard_disarm();
+#endif
+        return false;
+    }
+
+    dm_arena_reset(&context->frame_arenas[context->renderer.current_frame]);
+
+    return true;
 }
 
 bool dm_render_end(dm_context* context)
 {
-    return dm_renderer_end_frame(context);
-}
+    if(!dm_renderer_end_frame(context))
+    {
+#ifdef DM_ALLOC_GUARD
+        dm_alloc_guard_disarm();
+#endif
+        return false;
+    }
 
-void* dm_read_bytes(const char *path, size_t *size)
-{
-    FILE *fp;
-    void* data = NULL;
-
-    fp = fopen(path, "rb");
-    if(fp)
-    {
-        fseek(fp, 0, SEEK_END);
-        *size = ftell(fp);
-        fseek(fp, 0, SEEK_SET);
-        
-        data = malloc(*size);
-        
-        size_t t = fread(data, *size, 1, fp);
-        char d[512];
-        memcpy(d, data, 512);
-        if(t!=1) 
+#ifdef DM_ALLOC_GUARD
+    if(!dm_alloc_guard_end_frame()) return false;
+#endif
+
+    return true;
+}
+
+void* dm_read_bytes(const char *path, size_t *size)
+{
+    FILE *fp = fopen(path, "rb");
+    if(!fp)
+    {
+        LOG_ERROR("Could not open file: %s", path);
+        return NULL;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long file_size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if(file_size < 0)
+    {
+        LOG_ERROR("Could not get size of file: %s", path);
+        fclose(fp);
+        return NULL;
+    }
+
+    *size = file_size;
+    void* data = malloc(*size ? *size : 1);
+    if(!data)
+    {
+        LOG_ERROR("Could not allocate %zu bytes for file: %s", *size, path);
+        fclose(fp);
+        return NULL;
+    }
+
+    if(*size && fread(data, *size, 1, fp) != 1)
+    {
+        LOG_ERROR("Could not read file: %s", path);
+        free(data);
+        fclose(fp);
+        return NULL;
+    }
+
+    fclose(fp);
+
+    return data;
+}
+
+// writes to a temporary file first and renames it over path,
+// so readers never see a partially written file
+bool dm_write_bytes(const char *path, const void *data, size_t size)
+{
+    // unique per call so threads writing the same path don't clobber each other's temporary
+    static volatile u32 tmp_index;
+
+    char tmp_path[4096];
+    if(snprintf(tmp_path, sizeof(tmp_path), "%s.%u.tmp", path, DM_ATOMIC_ADD(&tmp_index, 1)) >= (int)sizeof(tmp_path))
+    {
+        LOG_ERROR("Path is too long: %s", path);
+        return false;
+    }
+
+    FILE *fp = fopen(tmp_path, "wb");
+    if(!fp)
+    {
+        LOG_ERROR("Could not open file: %s", tmp_path);
+        return false;
+    }
+
+    bool result = !size || fwrite(data, size, 1, fp) == 1;
+    if(fclose(fp) != 0) result = false;
+
+#ifdef _WIN32
+    if(result) result = MoveFileExA(tmp_path, path, MOVEFILE_REPLACE_EXISTING);
+#else
+    if(result) result = rename(tmp_path, path) == 0;
+#endif
+
+    if(!result)
+    {
+        LOG_ERROR("Could not write file: %s", path);
+        remove(tmp_path);
+    }
+
+    return result;
+}
+
+bool dm_file_exists(const char *path)
+{
+#ifdef _WIN32
+    DWORD attributes = GetFileAttributesA(path);
+    return attributes != INVALID_FILE_ATTRIBUTES && !(attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISREG(st.st_mode);
+#endif
+}
+
+// last write time in nanoseconds, only good for comparing files against each other
+bool dm_file_get_mtime(const char *path, u64 *mtime)
+{
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if(!GetFileAttributesExA(path, GetFileExInfoStandard, &data)) return false;
+
+    *mtime = (((u64)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime) * 100;
+#else
+    struct stat st;
+    if(stat(path, &st) != 0) return false;
+
+    *mtime = (u64)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+
+    return true;
+}
+
+// succeeds if the directory already exists
+bool dm_directory_create(const char *path)
+{
+#ifdef _WIN32
+    if(CreateDirectoryA(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS) return true;
+#else
+    if(mkdir(path, 0755) == 0 || errno == EEXIST) return true;
+#endif
+
+    LOG_ERROR("Could not create directory: %s", path);
+    return false;
+}
+
+// the mapping keeps the file alive, so handles are closed right away
+bool dm_file_map(const char *path, dm_mapped_file *file)
+{
+    *file = (dm_mapped_file){ 0 };
+
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if(handle == INVALID_HANDLE_VALUE)
+    {
+        LOG_ERROR("Could not open file: %s", path);
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(handle, &size))
+    {
+        LOG_ERROR("Could not get size of file: %s", path);
+        CloseHandle(handle);
+        return false;
+    }
+    file->size = size.QuadPart;
+
+    // empty files can't be mapped
+    if(!file->size)
+    {
+        CloseHandle(handle);
+        return true;
+    }
+
+    HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(handle);
+    if(!mapping)
+    {
+        LOG_ERROR("CreateFileMapping failed for file: %s", path);
+        return false;
+    }
+
+    file->data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+#else
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+    {
+        LOG_ERROR("Could not open file: %s", path);
+        return false;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0)
+    {
+        LOG_ERROR("Could not get size of file: %s", path);
+        close(fd);
+        return false;
+    }
+    file->size = st.st_size;
+
+    // empty files can't be mapped
+    if(!file->size)
+    {
+        close(fd);
+        return true;
+    }
+
+    void* data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data != MAP_FAILED)
+    {
+        // assets are read front to back once, so read ahead aggressively
+        madvise(data, file->size, MADV_SEQUENTIAL);
+        madvise(data, file->size, MADV_WILLNEED);
+        file->data = data;
+    }
+#endif
+
+    if(!file->data)
+    {
+        LOG_ERROR("Could not map file: %s", path);
+        file->size = 0;
+        return false;
+    }
+
+    return true;
+}
+
+bool dm_file_get_size(const char *path, size_t *size)
+{
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if(!GetFileAttributesExA(path, GetFileExInfoStandard, &data))
+    {
+        LOG_ERROR("Could not get size of file: %s", path);
+        return false;
+    }
+    *size = ((u64)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+#else
+    struct stat st;
+    if(stat(path, &st) != 0)
+    {
+        LOG_ERROR("Could not get size of file: %s", path);
+        return false;
+    }
+    *size = st.st_size;
+#endif
+
+    return true;
+}
+
+void dm_file_unmap(dm_mapped_file *file)
+{
+    if(file->data && file->source == DM_MAPPED_FILE_SOURCE_MAPPED)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(file->data);
+#else
+        munmap((void*)file->data, file->size);
+#endif
+    }
+    else if(file->source == DM_MAPPED_FILE_SOURCE_ALLOCATED)
+    {
+        free((void*)file->data);
+    }
+
+    *file = (dm_mapped_file){ 0 };
+}
+
+// archive
+bool dm_archive_open(dm_archive *archive, const char *path, const char *mount_point)
+{
+    *archive = (dm_archive){ 0 };
+
+    if(!dm_file_map(path, &archive->file)) return false;
+
+    const u8 *base = archive->file.data;
+    size_t    size = archive->file.size;
+
+    const dm_archive_header *header = (const dm_archive_header*)base;
+    if(size < sizeof(dm_archive_header) || header->magic != DM_ARCHIVE_MAGIC)
+    {
+        LOG_ERROR("Not an archive: %s", path);
+        dm_archive_close(archive);
+        return false;
+    }
+    if(header->version != DM_ARCHIVE_VERSION)
+    {
+        LOG_ERROR("Archive %s has version %u, expected %u", path, header->version, DM_ARCHIVE_VERSION);
+        dm_archive_close(archive);
+        return false;
+    }
+
+    // never trust offsets from disk
+    u64 toc_size = (u64)header->entry_count * sizeof(dm_archive_entry);
+    bool valid = header->toc_offset <= size && toc_size <= size - header->toc_offset && !(header->toc_offset % sizeof(u64));
+    valid = valid && header->names_offset <= size && header->names_size <= size - header->names_offset;
+
+    const dm_archive_entry *entries = (const dm_archive_entry*)(base + header->toc_offset);
+    for(u32 i=0; valid && i<header->entry_count; i++)
+    {
+        const dm_archive_entry entry = entries[i];
+
+        valid = entry.offset <= size && entry.packed_size <= size - entry.offset && !(entry.offset % sizeof(u64));
+        valid = valid && (u64)entry.name_offset + entry.name_length <= header->names_size;
+        valid = valid && (i == 0 || entries[i-1].hash <= entry.hash);
+        if(!valid) break;
+
+        // divided rather than multiplied so huge sizes can't wrap around
+        u64 chunk_size  = entry.chunk_size ? entry.chunk_size : DM_ARCHIVE_CHUNK_SIZE;
+        u64 chunk_count = entry.size / chunk_size + (entry.size % chunk_size != 0);
+        valid = chunk_count <= DM_ARCHIVE_MAX_CHUNKS;
+
+        if(entry.compression == DM_ARCHIVE_COMPRESSION_NONE)
         {
-            LOG_ERROR("Something bad happened with fread");
-            return NULL;
+            valid = valid && entry.packed_size == entry.size;
+            continue;
         }
-        
-        fclose(fp);
+
+        // the chunk offset table has to fit, and every chunk has to start after it and stay inside the entry
+        valid = valid && entry.compression <= DM_ARCHIVE_COMPRESSION_ZSTD && entry.chunk_size;
+        valid = valid && chunk_count < entry.packed_size / sizeof(u64);
+        if(!valid) break;
+
+        const u64 *chunk_offsets = (const u64*)(base + entry.offset);
+        u64 table_size = (chunk_count + 1) * sizeof(u64);
+        for(u64 c=0; valid && c<=chunk_count; c++)
+        {
+            u64 previous = c ? chunk_offsets[c-1] : table_size;
+            valid = chunk_offsets[c] >= previous && chunk_offsets[c] <= entry.packed_size;
+        }
+    }
+    if(!valid)
+    {
+        LOG_ERROR("Archive is corrupt: %s", path);
+        dm_archive_close(archive);
+        return false;
+    }
+
+    archive->entries     = entries;
+    archive->names       = (const char*)(base + header->names_offset);
+    archive->entry_count = header->entry_count;
+
+    if(mount_point && mount_point[0])
+    {
+        size_t length = strlen(mount_point);
+        if(length + 2 > sizeof(archive->mount_point))
+        {
+            LOG_ERROR("Mount point is too long: %s", mount_point);
+            dm_archive_close(archive);
+            return false;
+        }
+
+        memcpy(archive->mount_point, mount_point, length);
+        if(mount_point[length-1] != '/') archive->mount_point[length++] = '/';
+        archive->mount_point[length] = '\0';
+        archive->mount_point_length  = length;
+    }
+
+    LOG_INFO("Opened archive %s with %u entries", path, archive->entry_count);
+
+    return true;
+}
+
+void dm_archive_close(dm_archive *archive)
+{
+    u32 pins = DM_ATOMIC_LOAD(&archive->pins);
+    if(pins)
+    {
+        LOG_ERROR("Archive still has %u pinned users, leaving it mapped", pins);
+        return;
+    }
+
+    dm_file_unmap(&archive->file);
+    *archive = (dm_archive){ 0 };
+}
+
+const dm_archive_entry* dm_archive_find(dm_archive *archive, const char *name)
+{
+    if(!archive->entry_count) return NULL;
+
+    if(archive->mount_point_length)
+    {
+        if(strncmp(name, archive->mount_point, archive->mount_point_length) != 0) return NULL;
+        name += archive->mount_point_length;
+    }
+
+    size_t length = strlen(name);
+    u64    hash   = dm_hash_fnv1a(name, length);
+
+    // first entry with a matching hash, then walk past any collisions
+    u32 low = 0, high = archive->entry_count;
+    while(low < high)
+    {
+        u32 mid = low + (high - low) / 2;
+        if(archive->entries[mid].hash < hash) low = mid + 1;
+        else                                  high = mid;
+    }
+
+    for(u32 i=low; i<archive->entry_count && archive->entries[i].hash == hash; i++)
+    {
+        const dm_archive_entry *entry = &archive->entries[i];
+        if(entry->name_length == length && memcmp(archive->names + entry->name_offset, name, length) == 0) return entry;
+    }
+
+    return NULL;
+}
+
+bool dm_archive_mount(dm_context *context, const char *path, const char *mount_point)
+{
+    dm_archive_close(&context->archive);
+    if(context->archive.file.data) return false;
+
+    return dm_archive_open(&context->archive, path, mount_point);
+}
+
+// looks in the mounted archive first and only touches the filesystem on a miss
+bool dm_asset_map(dm_context *context, const char *path, dm_mapped_file *file)
+{
+    return dm_asset_map_ex(context, path, false, file);
+}
+
+// decode_inline keeps compressed entries off the job workers, see dm_archive_read_decode
+bool dm_asset_map_ex(dm_context *context, const char *path, bool decode_inline, dm_mapped_file *file)
+{
+    const dm_archive_entry *entry = dm_archive_find(&context->archive, path);
+    if(!entry) return dm_file_map(path, file);
+
+    if(entry->compression == DM_ARCHIVE_COMPRESSION_NONE)
+    {
+        *file = (dm_mapped_file){
+            .data=(const u8*)context->archive.file.data + entry->offset,
+            .size=entry->size,
+            .source=DM_MAPPED_FILE_SOURCE_BORROWED
+        };
+
+        return true;
+    }
+
+    // compressed entries have to land somewhere, callers with their own destination should use dm_archive_read_begin
+    void *data = malloc(entry->size ? entry->size : 1);
+    if(!data)
+    {
+        LOG_ERROR("Could not allocate %llu bytes for asset: %s", (unsigned long long)entry->size, path);
+        return false;
+    }
+
+    bool decoded;
+    if(decode_inline)
+    {
+        decoded = dm_archive_read_decode(&context->archive, entry, data);
     }
     else
     {
-        LOG_ERROR("Could not open file: %s", path);
+        dm_archive_read read;
+        decoded = dm_archive_read_begin(context, &context->archive, entry, data, &read) && dm_archive_read_wait(context, &read);
+    }
+    if(!decoded)
+    {
+        LOG_ERROR("Could not decompress asset: %s", path);
+        free(data);
+        return false;
     }
 
-    return data;
+    *file = (dm_mapped_file){
+        .data=data,
+        .size=entry->size,
+        .source=DM_MAPPED_FILE_SOURCE_ALLOCATED
+    };
+
+    return true;
+}
+
+bool dm_archive_decode_chunk(dm_archive_read *read, u32 chunk)
+{
+    u64 dst_offset = (u64)chunk * read->chunk_size;
+    u64 dst_size   = read->size - dst_offset < read->chunk_size ? read->size - dst_offset : read->chunk_size;
+    u8* dst        = read->dst + dst_offset;
+
+    if(read->compression == DM_ARCHIVE_COMPRESSION_NONE)
+    {
+        memcpy(dst, read->src + dst_offset, dst_size);
+        return true;
+    }
+
+    u64 src_begin = read->chunk_offsets[chunk];
+    u64 src_end   = read->chunk_offsets[chunk + 1];
+    if(src_begin > src_end || src_end > read->packed_size) return false;
+
+#ifdef DM_LZ4
+    if(read->compression == DM_ARCHIVE_COMPRESSION_LZ4)
+    {
+        return LZ4_decompress_safe((const char*)read->src + src_begin, (char*)dst, (int)(src_end - src_begin), (int)dst_size) == (int)dst_size;
+    }
+#endif
+#ifdef DM_ZSTD
+    if(read->compression == DM_ARCHIVE_COMPRESSION_ZSTD)
+    {
+        size_t result = ZSTD_decompress(dst, dst_size, read->src + src_begin, src_end - src_begin);
+        return !ZSTD_isError(result) && result == dst_size;
+    }
+#endif
+
+    return false;
+}
+
+// a handful of jobs pull chunk indices until there are none left,
+// so any number of chunks costs at most one job per worker
+void dm_archive_read_job(void *data)
+{
+    dm_archive_read *read = data;
+
+    while(true)
+    {
+        u32 chunk = DM_ATOMIC_ADD(&read->next_chunk, 1) - 1;
+        if(chunk >= read->chunk_count) return;
+
+        if(!dm_archive_decode_chunk(read, chunk)) DM_ATOMIC_STORE(&read->failed, 1);
+    }
+}
+
+bool dm_archive_read_setup(dm_archive *archive, const dm_archive_entry *entry, void *dst, dm_archive_read *read)
+{
+    *read = (dm_archive_read){
+        .src=(const u8*)archive->file.data + entry->offset,
+        .dst=dst,
+        .size=entry->size,
+        .packed_size=entry->packed_size,
+        .compression=entry->compression,
+        .chunk_size=entry->chunk_size ? entry->chunk_size : DM_ARCHIVE_CHUNK_SIZE
+    };
+
+    // dm_archive_open already rejected entries with more chunks than fit
+    u64 chunk_count = read->size / read->chunk_size + (read->size % read->chunk_size != 0);
+    if(chunk_count > DM_ARCHIVE_MAX_CHUNKS)
+    {
+        LOG_ERROR("Archive entry has too many chunks: %llu", (unsigned long long)chunk_count);
+        return false;
+    }
+    read->chunk_count = (u32)chunk_count;
+
+    bool supported = entry->compression == DM_ARCHIVE_COMPRESSION_NONE;
+#ifdef DM_LZ4
+    supported = supported || entry->compression == DM_ARCHIVE_COMPRESSION_LZ4;
+#endif
+#ifdef DM_ZSTD
+    supported = supported || entry->compression == DM_ARCHIVE_COMPRESSION_ZSTD;
+#endif
+    if(!supported)
+    {
+        LOG_ERROR("Archive entry uses compression %u which this build does not support", entry->compression);
+        return false;
+    }
+
+    if(entry->compression != DM_ARCHIVE_COMPRESSION_NONE) read->chunk_offsets = (const u64*)read->src;
+
+    return true;
+}
+
+bool dm_archive_read_begin(dm_context *context, dm_archive *archive, const dm_archive_entry *entry, void *dst, dm_archive_read *read)
+{
+    if(!dm_archive_read_setup(archive, entry, dst, read)) return false;
+
+    u32 job_count = context->jobs.worker_count + 1;
+    if(job_count > read->chunk_count) job_count = read->chunk_count;
+
+    for(u32 i=0; i<job_count; i++)
+    {
+        dm_job_submit(context, dm_archive_read_job, read, &read->counter);
+    }
+
+    return true;
+}
+
+// false if any chunk failed to decode, dst is undefined then
+bool dm_archive_read_wait(dm_context *context, dm_archive_read *read)
+{
+    dm_job_wait(context, &read->counter);
+
+    return !read->failed;
+}
+
+// decodes every chunk on the calling thread. for callers holding a lock a job could want,
+// waiting on the workers would run other jobs right here
+bool dm_archive_read_decode(dm_archive *archive, const dm_archive_entry *entry, void *dst)
+{
+    dm_archive_read read;
+    if(!dm_archive_read_setup(archive, entry, dst, &read)) return false;
+
+    for(u32 i=0; i<read.chunk_count; i++)
+    {
+        if(!dm_archive_decode_chunk(&read, i)) return false;
+    }
+
+    return true;
 }
@@ -5,6 +5,10 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
 #ifndef NDEBUG
 #define DM_DEBUG
 #endif
@@ -60,16 +64,33 @@ typedef enum dm_resource_type_t
 #endif
 } dm_resource_type;
 
+// handles pack type, pool slot index and generation into 32 bits.
+// generation is bumped every time a slot is reused, so stale handles are caught
+#define DM_HANDLE_TYPE_BITS       4
+#define DM_HANDLE_INDEX_BITS      16
+#define DM_HANDLE_GENERATION_BITS 12
+
 typedef struct dm_pipeline_t
 {
-    dm_pipeline_type type  : 8;
-    u32              index : 24;
+    dm_pipeline_type type       : DM_HANDLE_TYPE_BITS;
+    u32              index      : DM_HANDLE_INDEX_BITS;
+    u32              generation : DM_HANDLE_GENERATION_BITS;
 } dm_pipeline;
 
+// pipelines created with the _async functions start out pending
+typedef enum dm_pipeline_status_t
+{
+    DM_PIPELINE_STATUS_INVALID,
+    DM_PIPELINE_STATUS_PENDING,
+    DM_PIPELINE_STATUS_READY,
+    DM_PIPELINE_STATUS_FAILED
+} dm_pipeline_status;
+
 typedef struct dm_resource_t
 {
-    dm_resource_type type  : 8;
-    u32              index : 24;
+    dm_resource_type type       : DM_HANDLE_TYPE_BITS;
+    u32              index      : DM_HANDLE_INDEX_BITS;
+    u32              generation : DM_HANDLE_GENERATION_BITS;
 } dm_resource;
 
 /********************
@@ -89,15 +110,16 @@ typedef struct dm_resource_t
 
 #define DM_MAX_DESCRIPTOR_HEAPS (DM_MAX_PIPES * 3)
 
-// these are defined PER FRAME
-#define DM_MAX_TEXTURES 10
-#define DM_MAX_BUFFERS  (10 * 2 + DM_MAX_TEXTURES) // CPU,GPU and textures need buffers
-#define DM_MAX_SAMPLERS 10
+// defaults for dm_renderer_limits. resource pools start with room for this many and grow at runtime,
+// descriptor heaps are sized by the limits
+#define DM_DEFAULT_MAX_TEXTURES 1024
+#define DM_DEFAULT_MAX_BUFFERS  1024
+#define DM_DEFAULT_MAX_SAMPLERS 64
 #ifdef DM_RAY_TRACE
-#define DM_MAX_ACCELS   10
-#define DM_MAX_RESOURCES (DM_MAX_TEXTURES + DM_MAX_BUFFERS + DM_MAX_SAMPLERS + DM_MAX_ACCELS)
+#define DM_DEFAULT_MAX_ACCELS   64
+#define DM_DEFAULT_MAX_RESOURCES (DM_DEFAULT_MAX_TEXTURES + DM_DEFAULT_MAX_BUFFERS + DM_DEFAULT_MAX_SAMPLERS + DM_DEFAULT_MAX_ACCELS)
 #else
-#define DM_MAX_RESOURCES (DM_MAX_TEXTURES + DM_MAX_BUFFERS + DM_MAX_SAMPLERS)
+#define DM_DEFAULT_MAX_RESOURCES (DM_DEFAULT_MAX_TEXTURES + DM_DEFAULT_MAX_BUFFERS + DM_DEFAULT_MAX_SAMPLERS)
 #endif
 
 /**************
@@ -110,10 +132,23 @@ typedef enum dm_raster_shader_stage_t
     DM_RASTER_SHADER_STAGE_MAX
 } dm_raster_shader_stage;
 
+#define DM_MAX_SHADER_DEFINES 8
+
+// compiled in as "#define name value", an empty value still defines the name.
+// every distinct set of defines is its own variant, compiled the first time a pipeline asks for it
+typedef struct dm_shader_define_t
+{
+    char name[32];
+    char value[32];
+} dm_shader_define;
+
 typedef struct dm_raster_shader_t
 {
     char path[512];
-    char entry[512];
+    char entry[512]; // "main" if empty
+
+    dm_shader_define defines[DM_MAX_SHADER_DEFINES];
+    u32              define_count;
 } dm_raster_shader;
 
 typedef enum dm_blend_op_t
@@ -134,6 +169,26 @@ typedef enum dm_blend_factor_t
     DM_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA
 } dm_blend_factor;
 
+typedef enum dm_cull_mode_t
+{
+    DM_CULL_MODE_INVALID,
+    DM_CULL_MODE_NONE,
+    DM_CULL_MODE_FRONT,
+    DM_CULL_MODE_BACK
+} dm_cull_mode;
+
+typedef enum dm_primitive_topology_t
+{
+    DM_PRIMITIVE_TOPOLOGY_INVALID,
+    DM_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+    DM_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP,
+    DM_PRIMITIVE_TOPOLOGY_LINE_LIST,
+    DM_PRIMITIVE_TOPOLOGY_LINE_STRIP,
+    DM_PRIMITIVE_TOPOLOGY_POINT_LIST
+} dm_primitive_topology;
+
+// raster pipelines are created with back face culling, triangle lists and depth test/write on.
+// the blend state and those can be changed per draw with dm_render_command_set_*
 typedef struct dm_raster_pipe_desc_t
 {
     dm_raster_shader shaders[DM_RASTER_SHADER_STAGE_MAX];
@@ -144,6 +199,49 @@ typedef struct dm_raster_pipe_desc_t
     dm_blend_factor alpha_src_factor, alpha_dst_factor;
 } dm_raster_pipe_desc;
 
+/***************
+ * COMPUTE PIPE
+ ***************/
+#define DM_MAX_SPEC_CONSTANTS 16
+
+// value is the raw 32 bits, bools are 0 or 1 and floats are bit cast
+typedef struct dm_spec_constant_t
+{
+    u32 id, value;
+} dm_spec_constant;
+
+// workgroup sizes are spec constants too when the shader declares local_size_x_id and friends
+typedef struct dm_compute_pipe_desc_t
+{
+    char path[512];
+    char entry[512]; // "main" if empty
+
+    dm_shader_define defines[DM_MAX_SHADER_DEFINES];
+    u32              define_count;
+
+    dm_spec_constant constants[DM_MAX_SPEC_CONSTANTS];
+    u32              constant_count;
+} dm_compute_pipe_desc;
+
+#define DM_COMPUTE_TUNE_MAX_CANDIDATES 16
+#define DM_COMPUTE_TUNE_MAX_RESOURCES  10
+
+// the shader declares its workgroup size with local_size_x_id/y_id/z_id = size_ids.
+// each candidate is timed dispatching enough groups to cover work, with resources pushed like dm_render_command_push_resources
+typedef struct dm_compute_tune_desc_t
+{
+    dm_compute_pipe_desc pipe;
+
+    u32 size_ids[3];
+    u32 candidates[DM_COMPUTE_TUNE_MAX_CANDIDATES][3];
+    u32 candidate_count;
+
+    u32 work[3];
+
+    dm_resource resources[DM_COMPUTE_TUNE_MAX_RESOURCES];
+    u32         resource_count;
+} dm_compute_tune_desc;
+
 /****************
  * RENDER TARGET
  *****************/
@@ -229,11 +327,22 @@ typedef enum dm_buffer_type_t
     DM_BUFFER_TYPE_STORAGE
 } dm_buffer_type;
 
+// how often the cpu touches the buffer, picks the memory it lives in
+typedef enum dm_buffer_usage_t
+{
+    DM_BUFFER_USAGE_STATIC,   // uploaded once, device local. the staging memory is freed after the upload
+    DM_BUFFER_USAGE_DYNAMIC,  // rewritten every frame, one host visible copy per frame in flight
+    DM_BUFFER_USAGE_STREAM,   // device local, partial updates every frame go through the per-frame staging ring
+    DM_BUFFER_USAGE_READBACK  // written by the gpu and read with dm_renderer_read_buffer, host cached
+} dm_buffer_usage;
+
 typedef struct dm_buffer_desc_t
 {
     size_t size;
     dm_buffer_type type;
     void* data; // must be long-lasting so it does not decay before creating buffer
+    const char* asset; // instead of data, entry in the mounted archive decoded straight into the staging buffer. size 0 takes the entry size
+    dm_buffer_usage usage;
 } dm_buffer_desc;
 
 /**********
@@ -244,17 +353,283 @@ typedef struct dm_sampler_desc_t
     int d;
 } dm_sampler_desc;
 
+/**********
+ * THREADS
+ ***********/
+#ifdef _WIN32
+// SRWLOCK and CONDITION_VARIABLE are a single pointer
+typedef struct dm_mutex_t { void* handle; } dm_mutex;
+typedef struct dm_cond_t  { void* handle; } dm_cond;
+typedef void* dm_thread;
+#else
+typedef pthread_mutex_t dm_mutex;
+typedef pthread_cond_t  dm_cond;
+typedef pthread_t       dm_thread;
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define DM_ATOMIC_ADD(PTR, VALUE)   (_InterlockedExchangeAdd((volatile long*)(PTR), (long)(VALUE)) + (VALUE))
+#define DM_ATOMIC_SUB(PTR, VALUE)   (_InterlockedExchangeAdd((volatile long*)(PTR), -(long)(VALUE)) - (VALUE))
+#define DM_ATOMIC_LOAD(PTR)         ((u32)_InterlockedOr((volatile long*)(PTR), 0))
+#define DM_ATOMIC_STORE(PTR, VALUE) _InterlockedExchange((volatile long*)(PTR), (long)(VALUE))
+
+#define DM_ATOMIC_ADD64(PTR, VALUE)           (_InterlockedExchangeAdd64((volatile long long*)(PTR), (long long)(VALUE)) + (VALUE))
+#define DM_ATOMIC_SUB64(PTR, VALUE)           (_InterlockedExchangeAdd64((volatile long long*)(PTR), -(long long)(VALUE)) - (VALUE))
+#define DM_ATOMIC_LOAD64(PTR)                 ((u64)_InterlockedOr64((volatile long long*)(PTR), 0))
+#define DM_ATOMIC_CAS64(PTR, EXPECTED, VALUE) (_InterlockedCompareExchange64((volatile long long*)(PTR), (long long)(VALUE), (long long)(EXPECTED)) == (long long)(EXPECTED))
+#else
+#define DM_ATOMIC_ADD(PTR, VALUE)   __atomic_add_fetch(PTR, VALUE, __ATOMIC_ACQ_REL)
+#define DM_ATOMIC_SUB(PTR, VALUE)   __atomic_sub_fetch(PTR, VALUE, __ATOMIC_ACQ_REL)
+#define DM_ATOMIC_LOAD(PTR)         __atomic_load_n(PTR, __ATOMIC_ACQUIRE)
+#define DM_ATOMIC_STORE(PTR, VALUE) __atomic_store_n(PTR, VALUE, __ATOMIC_RELEASE)
+
+#define DM_ATOMIC_ADD64(PTR, VALUE)           DM_ATOMIC_ADD(PTR, VALUE)
+#define DM_ATOMIC_SUB64(PTR, VALUE)           DM_ATOMIC_SUB(PTR, VALUE)
+#define DM_ATOMIC_LOAD64(PTR)                 DM_ATOMIC_LOAD(PTR)
+#define DM_ATOMIC_CAS64(PTR, EXPECTED, VALUE) __sync_bool_compare_and_swap(PTR, EXPECTED, VALUE)
+#endif
+
+#ifdef _MSC_VER
+#define DM_THREAD_LOCAL __declspec(thread)
+#else
+#define DM_THREAD_LOCAL __thread
+#endif
+
+// jobs
+// fixed set of worker threads pulling from one queue, a full queue runs the job on the caller.
+// workers have thread indices 1 to worker_count, every other thread is 0, so per thread state can live in an array
+#define DM_JOB_MAX_WORKERS 16
+#define DM_JOB_QUEUE_SIZE  1024
+
+typedef void (*dm_job_func)(void *data);
+
+// bumped for every job submitted with it, dropped as each one finishes
+typedef struct dm_job_counter_t
+{
+    volatile u32 value;
+} dm_job_counter;
+
+typedef struct dm_jobs_t
+{
+    u32 worker_count;
+
+    size_t offset;
+} dm_jobs;
+
+// io
+// batched async reads, io_uring when built with DM_IO_URING and the kernel allows it, jobs otherwise.
+// callbacks run on whichever thread polls or waits on the ticket
+#define DM_IO_QUEUE_DEPTH 256
+
+typedef enum dm_io_status_t
+{
+    DM_IO_STATUS_PENDING,
+    DM_IO_STATUS_DONE,
+    DM_IO_STATUS_FAILED,
+} dm_io_status;
+
+typedef struct dm_io_request_t dm_io_request;
+typedef void (*dm_io_callback)(dm_io_request *request);
+
+// buffer must hold size bytes, it and the request must stay alive until the batch completes.
+// a file shorter than offset + size fails, bytes_read says how much of it did land
+typedef struct dm_io_request_t
+{
+    const char *path;
+    void       *buffer;
+    size_t      offset, size;
+
+    dm_io_callback callback;
+    void*          user_data;
+
+    size_t                bytes_read;
+    volatile dm_io_status status;
+
+    // filled in by the io engine
+    void*    batch;
+    intptr_t file;
+    bool     notified;
+} dm_io_request;
+
+typedef struct dm_io_ticket_t
+{
+    u32 index, generation;
+} dm_io_ticket;
+
+typedef struct dm_io_t
+{
+    bool uring;
+
+    size_t offset;
+} dm_io;
+
 /**********
  * CONTEXT
  ***********/
+// memory stats
+// every arena and backend allocation path reports into one of these tags, from any thread.
+// peak is the high-water mark of in_use since dm_init. arenas release in bulk, so their
+// allocations are balanced by resets rather than frees
+typedef enum dm_mem_tag_t
+{
+    DM_MEM_TAG_UNKNOWN,
+    DM_MEM_TAG_CONTEXT,
+    DM_MEM_TAG_FRAME,
+    DM_MEM_TAG_POOL,
+    DM_MEM_TAG_RENDERER,
+    DM_MEM_TAG_GPU_DEVICE,
+    DM_MEM_TAG_GPU_HOST,
+    DM_MEM_TAG_COUNT
+} dm_mem_tag;
+
+typedef struct dm_mem_stats_t
+{
+    size_t in_use, peak, committed;
+    u64    alloc_count, free_count, reset_count, failed_count;
+} dm_mem_stats;
+
+// alloc guard
+// build with DM_ALLOC_GUARD to count heap allocations made on the calling thread
+// between dm_render_begin and dm_render_end once the warm-up frames have passed.
+// malloc and the aligned variants are interposed on glibc, vulkan host allocations are
+// counted everywhere and use the untracked allocator so they aren't counted twice
+#define DM_ALLOC_GUARD_DEFAULT_WARMUP 60
+
 // arena
+// reserves a large virtual range up front and commits pages as it grows,
+// so pointers into an arena stay valid for its whole lifetime.
+// the reserve only costs address space, define DM_ARENA_DEFAULT_RESERVE to change it
+#ifndef DM_ARENA_DEFAULT_RESERVE
+#define DM_ARENA_DEFAULT_RESERVE DM_GIGABYTE
+#endif
+#define DM_ARENA_COMMIT_SIZE     (64 * DM_KILABYTE)
+#ifdef __AVX__
+#define DM_ARENA_ALIGNMENT 32
+#else
+#define DM_ARENA_ALIGNMENT 16
+#endif
+
+typedef enum dm_arena_flag_t
+{
+    DM_ARENA_FLAG_HUGE_PAGES = 1,
+} dm_arena_flag;
+
 typedef struct dm_arena_t
 {
-    size_t size, capacity;
+    size_t size, capacity, reserved;
     void* start;
     void* current;
+
+    size_t peak;
+
+    dm_arena_flag flags;
+    dm_mem_tag    tag;
 } dm_arena;
 
+typedef size_t dm_arena_marker;
+
+// pool
+// fixed stride slots with a free list, backed by an arena so slots never move
+#define DM_POOL_MAX_SLOTS       (1 << DM_HANDLE_INDEX_BITS)
+#define DM_POOL_GENERATION_MASK ((1 << DM_HANDLE_GENERATION_BITS) - 1)
+
+typedef struct dm_pool_t
+{
+    dm_arena slots;
+    size_t   stride;
+    u32      count, live_count, free_head;
+} dm_pool;
+
+// where backends keep data that is expensive to rebuild, e.g. compiled shaders.
+// safe to delete at any time
+#ifndef DM_CACHE_DIRECTORY
+#define DM_CACHE_DIRECTORY "dm_cache"
+#endif
+
+// mapped file
+// read only view of a whole file, valid until dm_file_unmap.
+// borrowed views point into a mounted archive, allocated ones hold a decompressed archive entry
+typedef enum dm_mapped_file_source_t
+{
+    DM_MAPPED_FILE_SOURCE_MAPPED,
+    DM_MAPPED_FILE_SOURCE_BORROWED,
+    DM_MAPPED_FILE_SOURCE_ALLOCATED,
+} dm_mapped_file_source;
+
+typedef struct dm_mapped_file_t
+{
+    const void* data;
+    size_t      size;
+
+    dm_mapped_file_source source;
+} dm_mapped_file;
+
+// archive
+// header, toc sorted by name hash, name table, then entry data aligned for direct gpu upload.
+// everything is little endian and offsets are from the start of the file.
+// compressed entries are split into independently compressed chunks so they can be decoded in parallel,
+// their data starts with chunk_count + 1 u64 offsets relative to the start of the entry
+#define DM_ARCHIVE_MAGIC      0x4b504d44 // "DMPK"
+#define DM_ARCHIVE_VERSION    2
+#define DM_ARCHIVE_ALIGNMENT  256
+#define DM_ARCHIVE_CHUNK_SIZE (256 * DM_KILABYTE)
+// keeps chunk indices in a u32 with room for the extra claims of the read jobs
+#define DM_ARCHIVE_MAX_CHUNKS 0x80000000u
+
+typedef enum dm_archive_compression_t
+{
+    DM_ARCHIVE_COMPRESSION_NONE,
+    DM_ARCHIVE_COMPRESSION_LZ4,
+    DM_ARCHIVE_COMPRESSION_ZSTD,
+} dm_archive_compression;
+
+typedef struct dm_archive_header_t
+{
+    u32 magic, version;
+    u32 entry_count, alignment;
+    u64 toc_offset, names_offset, names_size;
+} dm_archive_header;
+
+// size is the decompressed size, packed_size what is stored in the archive
+typedef struct dm_archive_entry_t
+{
+    u64 hash;
+    u64 offset, size, packed_size;
+    u32 name_offset, name_length;
+    u32 compression, chunk_size;
+} dm_archive_entry;
+
+typedef struct dm_archive_t
+{
+    dm_mapped_file file;
+
+    const dm_archive_entry* entries;
+    const char*             names;
+    u32                     entry_count;
+
+    // stripped from lookups so existing relative paths resolve inside the archive
+    char   mount_point[256];
+    size_t mount_point_length;
+
+    // outside users referencing the mapping in place, it can't be unmapped while any are left
+    volatile u32 pins;
+} dm_archive;
+
+// one entry being decoded into caller memory by the job workers,
+// must stay alive until dm_archive_read_wait returns
+typedef struct dm_archive_read_t
+{
+    const u8*  src;
+    const u64* chunk_offsets;
+    u8*        dst;
+    u64        size, packed_size;
+    u32        compression, chunk_size, chunk_count;
+
+    volatile u32 next_chunk, failed;
+    dm_job_counter counter;
+} dm_archive_read;
+
 // window
 typedef struct dm_window_t
 {
@@ -264,11 +639,20 @@ typedef struct dm_window_t
 } dm_window;
 
 // renderer
+// how many textures, buffers and samplers can be in the descriptor heaps at once.
+// set before dm_init, 0 takes the DM_DEFAULT_MAX_* value
+typedef struct dm_renderer_limits_t
+{
+    u32 textures, buffers, samplers;
+} dm_renderer_limits;
+
 typedef struct dm_renderer_t
 {
     u16 width, height;
     u8 current_frame;
 
+    dm_renderer_limits limits;
+
     size_t offset;
 } dm_renderer;
 
@@ -280,21 +664,57 @@ typedef enum dm_context_flag_t
     DM_CONTEXT_FLAG_WINDOW_RESIZED   = 8,
 } dm_context_flag;
 
+// scratch memory for one frame in flight, reset in dm_render_begin once the gpu is done with that frame
+#define DM_FRAME_ARENA_SIZE DM_MEGABYTE
+
 typedef struct dm_context_t
 {
     dm_window window;
     dm_renderer renderer;
+    dm_jobs jobs;
+    dm_io io;
 
     dm_context_flag flags;
 
     dm_arena arena;
+    dm_arena frame_arenas[DM_FRAMES_IN_FLIGHT];
+
+    dm_archive archive;
 } dm_context;
 
 // functions
-void dm_arena_create(dm_arena *arena, size_t size);
+bool dm_arena_create(dm_arena *arena, size_t size);
+bool dm_arena_create_ex(dm_arena *arena, size_t size, size_t reserve, dm_arena_flag flags, dm_mem_tag tag);
 void dm_arena_detroy(dm_arena *arena);
 void* dm_arena_alloc(dm_arena *arena, size_t size, size_t *offset);
 void* dm_arena_get_ptr(dm_arena arena, size_t offset);
+dm_arena_marker dm_arena_get_marker(dm_arena *arena);
+void dm_arena_reset_to_marker(dm_arena *arena, dm_arena_marker marker);
+void dm_arena_reset(dm_arena *arena);
+
+void dm_mem_record_alloc(dm_mem_tag tag, size_t size);
+void dm_mem_record_free(dm_mem_tag tag, size_t size);
+void dm_mem_record_reset(dm_mem_tag tag, size_t size);
+void dm_mem_record_commit(dm_mem_tag tag, size_t size);
+void dm_mem_record_decommit(dm_mem_tag tag, size_t size);
+void dm_mem_record_failed(dm_mem_tag tag);
+void dm_mem_get_stats(dm_mem_tag tag, dm_mem_stats *stats);
+const char* dm_mem_tag_name(dm_mem_tag tag);
+void dm_mem_dump_stats();
+
+void dm_alloc_guard_configure(u32 warmup_frames, bool fail_on_alloc);
+void dm_alloc_guard_record_alloc();
+void* dm_alloc_guard_untracked_malloc(size_t size);
+void dm_alloc_guard_untracked_free(void *ptr);
+
+bool dm_pool_create(dm_pool *pool, size_t element_size, u32 capacity);
+void dm_pool_destroy(dm_pool *pool);
+void* dm_pool_alloc(dm_pool *pool, u32 *index, u32 *generation);
+void* dm_pool_get(dm_pool *pool, u32 index, u32 generation);
+void* dm_pool_get_slot(dm_pool *pool, u32 index);
+bool dm_pool_free(dm_pool *pool, u32 index, u32 generation);
+
+void* dm_frame_alloc(dm_context *context, size_t size);
 
 bool dm_init(dm_context *context, u16 width, u16 height, const char *title, dm_context_flag flags);
 void dm_shutdown(dm_context *context);
@@ -308,6 +728,42 @@ bool dm_window_resized(dm_context *context);
 double dm_window_get_time();
 
 void* dm_read_bytes(const char *path, size_t *size);
+bool dm_write_bytes(const char *path, const void *data, size_t size);
+bool dm_file_exists(const char *path);
+bool dm_file_get_mtime(const char *path, u64 *mtime);
+bool dm_directory_create(const char *path);
+bool dm_file_map(const char *path, dm_mapped_file *file);
+void dm_file_unmap(dm_mapped_file *file);
+bool dm_file_get_size(const char *path, size_t *size);
+
+bool dm_archive_open(dm_archive *archive, const char *path, const char *mount_point);
+void dm_archive_close(dm_archive *archive);
+const dm_archive_entry* dm_archive_find(dm_archive *archive, const char *name);
+bool dm_archive_read_begin(dm_context *context, dm_archive *archive, const dm_archive_entry *entry, void *dst, dm_archive_read *read);
+bool dm_archive_read_wait(dm_context *context, dm_archive_read *read);
+bool dm_archive_read_decode(dm_archive *archive, const dm_archive_entry *entry, void *dst);
+bool dm_archive_mount(dm_context *context, const char *path, const char *mount_point);
+bool dm_asset_map(dm_context *context, const char *path, dm_mapped_file *file);
+bool dm_asset_map_ex(dm_context *context, const char *path, bool decode_inline, dm_mapped_file *file);
+
+void dm_mutex_init(dm_mutex *mutex);
+void dm_mutex_destroy(dm_mutex *mutex);
+void dm_mutex_lock(dm_mutex *mutex);
+void dm_mutex_unlock(dm_mutex *mutex);
+void dm_cond_init(dm_cond *cond);
+void dm_cond_destroy(dm_cond *cond);
+void dm_cond_wait(dm_cond *cond, dm_mutex *mutex);
+void dm_cond_signal(dm_cond *cond);
+void dm_cond_broadcast(dm_cond *cond);
+
+void dm_job_submit(dm_context *context, dm_job_func func, void *data, dm_job_counter *counter);
+bool dm_job_is_done(dm_job_counter *counter);
+u32  dm_job_get_thread_index();
+void dm_job_wait(dm_context *context, dm_job_counter *counter);
+
+bool dm_io_submit(dm_context *context, dm_io_request *requests, u32 count, dm_io_ticket *ticket);
+bool dm_io_poll(dm_context *context, dm_io_ticket ticket);
+bool dm_io_wait(dm_context *context, dm_io_ticket ticket);
 
 bool dm_is_key_pressed(dm_context *context, int key);
 
@@ -321,7 +777,23 @@ bool dm_renderer_create_sampler(dm_context *context, dm_sampler_desc desc, dm_re
 
 bool dm_renderer_upload_resources_to_heap(dm_context *context, dm_resource *resources[], u32 count);
 
-bool dm_renderer_create_compute_pipeline(dm_context *context, dm_pipeline *handle);
+bool dm_renderer_create_compute_pipeline(dm_context *context, dm_compute_pipe_desc desc, dm_pipeline *handle);
+
+// benchmarks the candidate workgroup sizes and fills tuned with desc.pipe plus the fastest one's constants.
+// blocks while it runs, so call it at startup. results are cached per device, later runs just look them up
+bool dm_renderer_tune_compute_pipeline(dm_context *context, dm_compute_tune_desc desc, dm_compute_pipe_desc *tuned);
+
+// return right away and build on the job workers. until the pipeline is ready binding it binds
+// fallback instead, or skips the following draws/dispatches if fallback is not ready either
+bool dm_renderer_create_raster_pipeline_async(dm_context *context, dm_raster_pipe_desc desc, dm_pipeline fallback, dm_pipeline *handle);
+bool dm_renderer_create_compute_pipeline_async(dm_context *context, dm_compute_pipe_desc desc, dm_pipeline fallback, dm_pipeline *handle);
+dm_pipeline_status dm_renderer_get_pipeline_status(dm_context *context, dm_pipeline handle);
+
+void dm_renderer_destroy_pipeline(dm_context *context, dm_pipeline handle);
+void dm_renderer_destroy_render_target(dm_context *context, dm_resource handle);
+void dm_renderer_destroy_buffer(dm_context *context, dm_resource handle);
+void dm_renderer_destroy_texture(dm_context *context, dm_resource handle);
+void dm_renderer_destroy_sampler(dm_context *context, dm_resource handle);
 
 // commands
 void dm_render_command_begin_rendering(dm_context *context, dm_resource handle, float r, float g, float b, float a, float d);
@@ -332,7 +804,24 @@ void dm_render_command_push_constants(dm_context *context, dm_resource handle);
 void dm_render_command_push_resources(dm_context *context, dm_resource *resources, u32 count);
 void dm_render_command_draw(dm_context *context, u32 index_count, u32 instance_count);
 
+// dynamic raster state, so one pipeline can draw many material states. binding a raster pipeline
+// resets all of it to what the pipeline was created with.
+// vulkan needs VK_EXT_extended_dynamic_state3 for the blend state and for topologies other than triangles,
+// metal bakes blending into the pipeline. unsupported changes are ignored with a warning
+void dm_render_command_set_cull_mode(dm_context *context, dm_cull_mode mode);
+void dm_render_command_set_primitive_topology(dm_context *context, dm_primitive_topology topology);
+void dm_render_command_set_depth_test(dm_context *context, bool enable);
+void dm_render_command_set_depth_write(dm_context *context, bool enable);
+void dm_render_command_set_blend(dm_context *context, bool enable, dm_blend_op color_op, dm_blend_factor color_src, dm_blend_factor color_dst, dm_blend_op alpha_op, dm_blend_factor alpha_src, dm_blend_factor alpha_dst);
+
+// recorded into the current frame, updates inside begin/end rendering or outside a frame block instead.
+// overlapping and adjacent ranges of a buffer are merged before they are copied.
+// dynamic buffers are written right away into the current frame's copy, so the last update of a frame wins
 void dm_render_command_update_buffer(dm_context *context, dm_resource handle, void *data, size_t size);
+void dm_render_command_update_buffer_range(dm_context *context, dm_resource handle, void *data, size_t offset, size_t size);
+
+// readback buffers only. waits for the frames submitted so far, so read results a frame late to not stall
+bool dm_renderer_read_buffer(dm_context *context, dm_resource handle, void *data, size_t offset, size_t size);
 
 bool dm_render_command_update_texture(dm_context *context, dm_resource handle, void* data, size_t size, u16 width, u16 height);
 void dm_render_command_copy_texture(dm_context *context, dm_resource src, dm_resource dst);
@@ -345,4 +834,26 @@ void dm_compute_command_dispatch(dm_context *context, u16 x, u16 y, u16 z);
 // macros
 #define DM_ALIGN(VALUE, ALIGNMENT) ((VALUE + ALIGNMENT - 1) & ~(ALIGNMENT - 1))
 
+// hash
+// 64 bit fnv-1a, stable across runs and platforms so it can be written to disk
+#define DM_HASH_FNV1A_SEED  0xcbf29ce484222325ULL
+#define DM_HASH_FNV1A_PRIME 0x100000001b3ULL
+
+static inline u64 dm_hash_fnv1a_ex(const void *data, size_t size, u64 hash)
+{
+    const u8 *bytes = data;
+    for(size_t i=0; i<size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= DM_HASH_FNV1A_PRIME;
+    }
+
+    return hash;
+}
+
+static inline u64 dm_hash_fnv1a(const void *data, size_t size)
+{
+    return dm_hash_fnv1a_ex(data, size, DM_HASH_FNV1A_SEED);
+}
+
 #endif // __DM_H__
@@ -0,0 +1,444 @@
+#include "dm.h"
+
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef DM_IO_URING
+#include <liburing.h>
+#endif
+
+#define DM_IO_MAX_BATCHES 1024
+
+typedef struct dm_io_batch_t
+{
+    dm_io_request* requests;
+    u32            count;
+
+    // one count per request still in flight
+    dm_job_counter pending;
+} dm_io_batch;
+
+typedef struct dm_io_engine_t
+{
+    dm_pool  batches;
+    dm_mutex lock;
+
+#ifdef DM_IO_URING
+    struct io_uring ring;
+    u32             in_flight;
+
+    // set while one thread is blocked on the ring without the lock, it is the only one reaping then
+    bool    waiting;
+    dm_cond reaped;
+#endif
+    bool uring;
+} dm_io_engine;
+
+/************
+ * FALLBACK
+ ************/
+// blocking read on a job worker, the job counter takes care of the batch
+void dm_io_read_job(void *data)
+{
+    dm_io_request *request = data;
+    u8 *dst = request->buffer;
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(request->path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if(file == INVALID_HANDLE_VALUE)
+    {
+        LOG_ERROR("Could not open file: %s", request->path);
+        DM_ATOMIC_STORE(&request->status, DM_IO_STATUS_FAILED);
+        return;
+    }
+
+    while(request->bytes_read < request->size)
+    {
+        size_t   remaining = request->size - request->bytes_read;
+        u64      offset    = request->offset + request->bytes_read;
+        DWORD    chunk     = remaining > 0x40000000 ? 0x40000000 : (DWORD)remaining;
+        DWORD    read      = 0;
+
+        OVERLAPPED overlapped = { .Offset=(DWORD)offset, .OffsetHigh=(DWORD)(offset >> 32) };
+        if(!ReadFile(file, dst + request->bytes_read, chunk, &read, &overlapped))
+        {
+            if(GetLastError() == ERROR_HANDLE_EOF) break;
+
+            LOG_ERROR("Could not read file: %s", request->path);
+            CloseHandle(file);
+            DM_ATOMIC_STORE(&request->status, DM_IO_STATUS_FAILED);
+            return;
+        }
+        if(!read) break;
+
+        request->bytes_read += read;
+    }
+
+    CloseHandle(file);
+
+    if(request->bytes_read < request->size)
+    {
+        LOG_ERROR("Could not read file: %s (got %zu of %zu bytes)", request->path, request->bytes_read, request->size);
+        DM_ATOMIC_STORE(&request->status, DM_IO_STATUS_FAILED);
+        return;
+    }
+#else
+    int fd = open(request->path, O_RDONLY);
+    if(fd < 0)
+    {
+        LOG_ERROR("Could not open file: %s", request->path);
+        DM_ATOMIC_STORE(&request->status, DM_IO_STATUS_FAILED);
+        return;
+    }
+
+    while(request->bytes_read < request->size)
+    {
+        ssize_t read = pread(fd, dst + request->bytes_read, request->size - request->bytes_read, request->offset + request->bytes_read);
+        if(read < 0)
+        {
+            LOG_ERROR("Could not read file: %s", request->path);
+            close(fd);
+            DM_ATOMIC_STORE(&request->status, DM_IO_STATUS_FAILED);
+            return;
+        }
+        if(!read) break;
+
+        request->bytes_read += read;
+    }
+
+    close(fd);
+
+    if(request->bytes_read < request->size)
+    {
+        LOG_ERROR("Could not read file: %s (got %zu of %zu bytes)", request->path, request->bytes_read, request->size);
+        DM_ATOMIC_STORE(&request->status, DM_IO_STATUS_FAILED);
+        return;
+    }
+#endif
+
+    DM_ATOMIC_STORE(&request->status, DM_IO_STATUS_DONE);
+}
+
+/************
+ * IO_URING
+ ************/
+#ifdef DM_IO_URING
+void dm_io_finish_request(dm_io_request *request, dm_io_status status)
+{
+    dm_io_batch *batch = request->batch;
+
+    DM_ATOMIC_STORE(&request->status, status);
+    DM_ATOMIC_SUB(&batch->pending.value, 1);
+}
+
+// expects the lock to be held
+struct io_uring_sqe* dm_io_uring_get_sqe(dm_io_engine *engine)
+{
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&engine->ring);
+    if(sqe) return sqe;
+
+    // submitting hands the queued entries to the kernel and frees up the ring
+    io_uring_submit(&engine->ring);
+    return io_uring_get_sqe(&engine->ring);
+}
+
+bool dm_io_uring_queue_read(dm_io_engine *engine, dm_io_request *request)
+{
+    struct io_uring_sqe *sqe = dm_io_uring_get_sqe(engine);
+    if(!sqe)
+    {
+        LOG_ERROR("io_uring submission queue is full");
+        return false;
+    }
+
+    u8 *dst = request->buffer;
+    io_uring_prep_read(sqe, (int)request->file, dst + request->bytes_read, request->size - request->bytes_read, request->offset + request->bytes_read);
+    io_uring_sqe_set_data(sqe, request);
+    engine->in_flight++;
+
+    return true;
+}
+
+// expects the lock to be held
+void dm_io_uring_reap(dm_io_engine *engine)
+{
+    struct io_uring_cqe *cqe;
+    bool resubmit = false;
+
+    while(io_uring_peek_cqe(&engine->ring, &cqe) == 0)
+    {
+        dm_io_request *request = io_uring_cqe_get_data(cqe);
+        int result = cqe->res;
+
+        io_uring_cqe_seen(&engine->ring, cqe);
+        engine->in_flight--;
+
+        if(result < 0)
+        {
+            LOG_ERROR("Could not read file: %s (%s)", request->path, strerror(-result));
+            close((int)request->file);
+            dm_io_finish_request(request, DM_IO_STATUS_FAILED);
+            continue;
+        }
+
+        request->bytes_read += result;
+
+        // short read, ask for the rest. hitting the end of the file first or not getting the
+        // resubmit queued leaves the request truncated, which is a failure
+        if(request->bytes_read < request->size)
+        {
+            if(result && dm_io_uring_queue_read(engine, request))
+            {
+                resubmit = true;
+                continue;
+            }
+
+            LOG_ERROR("Could not read file: %s (got %zu of %zu bytes)", request->path, request->bytes_read, request->size);
+            close((int)request->file);
+            dm_io_finish_request(request, DM_IO_STATUS_FAILED);
+            continue;
+        }
+
+        close((int)request->file);
+        dm_io_finish_request(request, DM_IO_STATUS_DONE);
+    }
+
+    if(resubmit) io_uring_submit(&engine->ring);
+}
+
+// blocks in the kernel without the lock so submits and polls on other threads keep going
+void dm_io_uring_wait(dm_io_engine *engine, dm_job_counter *pending)
+{
+    dm_mutex_lock(&engine->lock);
+    while(!dm_job_is_done(pending))
+    {
+        // another thread is already blocked on the ring and reaps for everyone
+        if(engine->waiting)
+        {
+            dm_cond_wait(&engine->reaped, &engine->lock);
+            continue;
+        }
+
+        dm_io_uring_reap(engine);
+        if(dm_job_is_done(pending) || !engine->in_flight) break;
+
+        // nobody else consumes completions while waiting is set, so the one we block on can't be stolen
+        engine->waiting = true;
+        dm_mutex_unlock(&engine->lock);
+
+        struct io_uring_cqe *cqe;
+        io_uring_wait_cqe(&engine->ring, &cqe);
+
+        dm_mutex_lock(&engine->lock);
+        engine->waiting = false;
+        dm_io_uring_reap(engine);
+        dm_cond_broadcast(&engine->reaped);
+    }
+    dm_mutex_unlock(&engine->lock);
+}
+#endif
+
+/*********
+ * ENGINE
+ *********/
+bool dm_io_init(dm_context *context)
+{
+    dm_io_engine *engine = dm_arena_alloc(&context->arena, sizeof(dm_io_engine), &context->io.offset);
+    if(!engine) return false;
+
+    *engine = (dm_io_engine){ 0 };
+
+    if(!dm_pool_create(&engine->batches, sizeof(dm_io_batch), DM_IO_MAX_BATCHES)) return false;
+    dm_mutex_init(&engine->lock);
+
+#ifdef DM_IO_URING
+    dm_cond_init(&engine->reaped);
+
+    // can fail on old kernels or when blocked by seccomp, the job path still works there
+    int result = io_uring_queue_init(DM_IO_QUEUE_DEPTH, &engine->ring, 0);
+    if(result == 0) engine->uring = true;
+    else            LOG_WARN("io_uring_queue_init failed (%s), falling back to job workers", strerror(-result));
+#endif
+
+    context->io.uring = engine->uring;
+
+    return true;
+}
+
+void dm_io_shutdown(dm_context *context)
+{
+    dm_io_engine *engine = dm_arena_get_ptr(context->arena, context->io.offset);
+
+    // reads still in flight write into batches and caller buffers, let them land first
+    for(u32 i=0; i<engine->batches.count; i++)
+    {
+        dm_io_batch *batch = dm_pool_get_slot(&engine->batches, i);
+        if(!batch) continue;
+
+#ifdef DM_IO_URING
+        if(engine->uring)
+        {
+            dm_io_uring_wait(engine, &batch->pending);
+            continue;
+        }
+#endif
+        dm_job_wait(context, &batch->pending);
+    }
+
+#ifdef DM_IO_URING
+    if(engine->uring) io_uring_queue_exit(&engine->ring);
+    dm_cond_destroy(&engine->reaped);
+#endif
+
+    dm_mutex_destroy(&engine->lock);
+    dm_pool_destroy(&engine->batches);
+}
+
+size_t dm_io_get_internal_size()
+{
+    return sizeof(dm_io_engine);
+}
+
+bool dm_io_submit(dm_context *context, dm_io_request *requests, u32 count, dm_io_ticket *ticket)
+{
+    dm_io_engine *engine = dm_arena_get_ptr(context->arena, context->io.offset);
+
+    dm_mutex_lock(&engine->lock);
+    dm_io_batch *batch = dm_pool_alloc(&engine->batches, &ticket->index, &ticket->generation);
+    dm_mutex_unlock(&engine->lock);
+    if(!batch)
+    {
+        LOG_ERROR("Could not allocate io batch");
+        return false;
+    }
+
+    batch->requests = requests;
+    batch->count    = count;
+
+    for(u32 i=0; i<count; i++)
+    {
+        requests[i].batch      = batch;
+        requests[i].bytes_read = 0;
+        requests[i].notified   = false;
+        requests[i].status     = DM_IO_STATUS_PENDING;
+    }
+
+#ifdef DM_IO_URING
+    if(engine->uring)
+    {
+        batch->pending.value = count;
+
+        dm_mutex_lock(&engine->lock);
+        for(u32 i=0; i<count; i++)
+        {
+            dm_io_request *request = &requests[i];
+
+            int fd = open(request->path, O_RDONLY);
+            if(fd < 0)
+            {
+                LOG_ERROR("Could not open file: %s", request->path);
+                dm_io_finish_request(request, DM_IO_STATUS_FAILED);
+                continue;
+            }
+            request->file = fd;
+
+            if(!request->size)
+            {
+                close(fd);
+                dm_io_finish_request(request, DM_IO_STATUS_DONE);
+                continue;
+            }
+
+            if(!dm_io_uring_queue_read(engine, request))
+            {
+                close(fd);
+                dm_io_finish_request(request, DM_IO_STATUS_FAILED);
+            }
+        }
+        io_uring_submit(&engine->ring);
+        dm_mutex_unlock(&engine->lock);
+
+        return true;
+    }
+#endif
+
+    for(u32 i=0; i<count; i++)
+    {
+        dm_job_submit(context, dm_io_read_job, &requests[i], &batch->pending);
+    }
+
+    return true;
+}
+
+// runs callbacks for newly finished requests and retires the batch once everything landed
+bool dm_io_poll(dm_context *context, dm_io_ticket ticket)
+{
+    dm_io_engine *engine = dm_arena_get_ptr(context->arena, context->io.offset);
+
+    dm_mutex_lock(&engine->lock);
+    dm_io_batch *batch = dm_pool_get(&engine->batches, ticket.index, ticket.generation);
+#ifdef DM_IO_URING
+    if(batch && engine->uring && !engine->waiting) dm_io_uring_reap(engine);
+#endif
+    dm_mutex_unlock(&engine->lock);
+
+    // unknown tickets have already been retired
+    if(!batch) return true;
+
+    bool done = dm_job_is_done(&batch->pending);
+
+    for(u32 i=0; i<batch->count; i++)
+    {
+        dm_io_request *request = &batch->requests[i];
+        if(request->notified || DM_ATOMIC_LOAD(&request->status) == DM_IO_STATUS_PENDING) continue;
+
+        request->notified = true;
+        if(request->callback) request->callback(request);
+    }
+
+    if(!done) return false;
+
+    dm_mutex_lock(&engine->lock);
+    dm_pool_free(&engine->batches, ticket.index, ticket.generation);
+    dm_mutex_unlock(&engine->lock);
+
+    return true;
+}
+
+// returns false if any request in the batch failed
+bool dm_io_wait(dm_context *context, dm_io_ticket ticket)
+{
+    dm_io_engine *engine = dm_arena_get_ptr(context->arena, context->io.offset);
+
+    dm_mutex_lock(&engine->lock);
+    dm_io_batch *batch = dm_pool_get(&engine->batches, ticket.index, ticket.generation);
+    dm_mutex_unlock(&engine->lock);
+    if(!batch) return true;
+
+    dm_io_request *requests = batch->requests;
+    u32 count = batch->count;
+
+#ifdef DM_IO_URING
+    if(engine->uring) dm_io_uring_wait(engine, &batch->pending);
+    else
+#endif
+    {
+        dm_job_wait(context, &batch->pending);
+    }
+
+    dm_io_poll(context, ticket);
+
+    bool result = true;
+    for(u32 i=0; i<count; i++)
+    {
+        if(requests[i].status == DM_IO_STATUS_FAILED) result = false;
+    }
+
+    return result;
+}
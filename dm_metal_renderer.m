@@ -44,6 +44,8 @@ typedef struct dm_metal_buffer_t
     id<MTLBuffer> host;
     id<MTLBuffer> device;
     size_t size;
+
+    dm_buffer_usage usage;
 } dm_metal_buffer;
 
 typedef struct dm_metal_texture_t
@@ -74,27 +76,65 @@ typedef struct dm_metal_renderer_t
     u32 frame_index;
 
     // resources
-    dm_metal_render_target rts[DM_MAX_TEXTURES];
-    u32 rt_count;
-
-    dm_metal_raster_pipe rps[DM_MAX_PIPES];
-    u32 rp_count;
-
-    dm_metal_buffer buffers[DM_MAX_BUFFERS];
-    u32 buffer_count;
-
-    dm_metal_texture textures[DM_MAX_TEXTURES];
-    u32 texture_count;
-
-    dm_metal_sampler samplers[DM_MAX_SAMPLERS];
-    u32 sampler_count;
+    dm_pool rts, rps, buffers, textures, samplers;
 
     id<MTLBuffer> active_index_buffer;
     dm_pipeline active_pipeline;
+
+    // dynamic raster state, indexed by [test][write]
+    id<MTLDepthStencilState> depth_states[2][2];
+    bool                     depth_test, depth_write;
+    MTLPrimitiveType         primitive_type;
+    bool                     warned_dynamic_blend;
 } dm_metal_renderer;
 
 extern void *dm_window_get_native_window(dm_context *context);
 
+dm_metal_buffer* dm_metal_get_buffer(dm_metal_renderer *renderer, dm_resource handle)
+{
+    dm_metal_buffer *buffer = NULL;
+    if(handle.type == DM_RESOURCE_TYPE_BUFFER) buffer = dm_pool_get(&renderer->buffers, handle.index, handle.generation);
+    if(!buffer) LOG_ERROR("Invalid or stale buffer handle");
+
+    return buffer;
+}
+
+dm_metal_texture* dm_metal_get_texture(dm_metal_renderer *renderer, dm_resource handle)
+{
+    dm_metal_texture *texture = NULL;
+    if(handle.type == DM_RESOURCE_TYPE_TEXTURE) texture = dm_pool_get(&renderer->textures, handle.index, handle.generation);
+    if(!texture) LOG_ERROR("Invalid or stale texture handle");
+
+    return texture;
+}
+
+dm_metal_sampler* dm_metal_get_sampler(dm_metal_renderer *renderer, dm_resource handle)
+{
+    dm_metal_sampler *sampler = NULL;
+    if(handle.type == DM_RESOURCE_TYPE_SAMPLER) sampler = dm_pool_get(&renderer->samplers, handle.index, handle.generation);
+    if(!sampler) LOG_ERROR("Invalid or stale sampler handle");
+
+    return sampler;
+}
+
+dm_metal_render_target* dm_metal_get_render_target(dm_metal_renderer *renderer, dm_resource handle)
+{
+    dm_metal_render_target *target = NULL;
+    if(handle.type == DM_RESOURCE_TYPE_RENDER_TARGET) target = dm_pool_get(&renderer->rts, handle.index, handle.generation);
+    if(!target) LOG_ERROR("Invalid or stale render target handle");
+
+    return target;
+}
+
+dm_metal_raster_pipe* dm_metal_get_raster_pipe(dm_metal_renderer *renderer, dm_pipeline handle)
+{
+    dm_metal_raster_pipe *pipe = NULL;
+    if(handle.type == DM_PIPELINE_TYPE_RASTER) pipe = dm_pool_get(&renderer->rps, handle.index, handle.generation);
+    if(!pipe) LOG_ERROR("Invalid or stale pipeline handle");
+
+    return pipe;
+}
+
 bool dm_renderer_init(dm_context* context)
 {
     LOG_INFO("Initializing metal backend...");
@@ -102,6 +142,14 @@ bool dm_renderer_init(dm_context* context)
     dm_metal_renderer *renderer = dm_arena_alloc(&context->arena, sizeof(dm_metal_renderer), &context->renderer.offset);
     if(!renderer) return false;
 
+    dm_renderer_limits limits = context->renderer.limits;
+
+    if(!dm_pool_create(&renderer->rts, sizeof(dm_metal_render_target), limits.textures)) return false;
+    if(!dm_pool_create(&renderer->rps, sizeof(dm_metal_raster_pipe), DM_MAX_PIPES))       return false;
+    if(!dm_pool_create(&renderer->buffers, sizeof(dm_metal_buffer), limits.buffers))      return false;
+    if(!dm_pool_create(&renderer->textures, sizeof(dm_metal_texture), limits.textures))   return false;
+    if(!dm_pool_create(&renderer->samplers, sizeof(dm_metal_sampler), limits.samplers))   return false;
+
     renderer->device = MTLCreateSystemDefaultDevice();
 
     renderer->swapchain.layer = [CAMetalLayer layer];
@@ -125,46 +173,101 @@ bool dm_renderer_init(dm_context* context)
 
     [depth_desc release];
 
+    for(u8 test=0; test<2; test++)
+    {
+        for(u8 write=0; write<2; write++)
+        {
+            MTLDepthStencilDescriptor *state_desc = [MTLDepthStencilDescriptor new];
+
+            state_desc.depthWriteEnabled = write;
+            state_desc.depthCompareFunction = test ? MTLCompareFunctionLessEqual : MTLCompareFunctionAlways;
+
+            renderer->depth_states[test][write] = [renderer->device newDepthStencilStateWithDescriptor:state_desc];
+            [state_desc release];
+        }
+    }
+
     return true;
 }
 
+// metal command buffers retain what they reference, so resources can be released right away
+void dm_metal_release_buffer(dm_metal_buffer *buffer)
+{
+    if(buffer->host) dm_mem_record_free(DM_MEM_TAG_GPU_HOST, buffer->size);
+    [buffer->host release];
+    [buffer->device release];
+}
+
+void dm_metal_release_texture(dm_metal_texture *texture)
+{
+    if(texture->host) dm_mem_record_free(DM_MEM_TAG_GPU_HOST, texture->size);
+    [texture->host release];
+    [texture->device release];
+}
+
+void dm_metal_release_raster_pipe(dm_metal_raster_pipe *pipe)
+{
+    [pipe->vertex_encoder release];
+    [pipe->fragment_encoder release];
+    for(u8 j=0; j<DM_FRAMES_IN_FLIGHT; j++)
+    {
+        if(pipe->argument_buffer[j]) [pipe->argument_buffer[j] release];
+    }
+    [pipe->pipeline release];
+    [pipe->depth_state release];
+}
+
 void dm_renderer_shutdown(dm_context* context)
 {
     dm_metal_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
 
-    for(u32 i=0; i<renderer->buffer_count; i++)
+    for(u32 i=0; i<renderer->buffers.count; i++)
     {
-        [renderer->buffers[i].host release];
-        [renderer->buffers[i].device release];
+        dm_metal_buffer *buffer = dm_pool_get_slot(&renderer->buffers, i);
+        if(buffer) dm_metal_release_buffer(buffer);
     }
-    for(u32 i=0; i<renderer->texture_count; i++)
+    for(u32 i=0; i<renderer->textures.count; i++)
     {
-        [renderer->textures[i].host release];
-        [renderer->textures[i].device release];
+        dm_metal_texture *texture = dm_pool_get_slot(&renderer->textures, i);
+        if(texture) dm_metal_release_texture(texture);
     }
-    for(u32 i=0; i<renderer->sampler_count; i++)
+    for(u32 i=0; i<renderer->samplers.count; i++)
     {
-        [renderer->samplers[i].state release];
+        dm_metal_sampler *sampler = dm_pool_get_slot(&renderer->samplers, i);
+        if(sampler) [sampler->state release];
     }
-    for(u32 i=0; i<renderer->rp_count; i++)
+    for(u32 i=0; i<renderer->rps.count; i++)
     {
-        [renderer->rps[i].vertex_encoder release];
-        [renderer->rps[i].fragment_encoder release];
-        for(u8 j=0; j<DM_FRAMES_IN_FLIGHT; j++)
-        {
-            if(renderer->rps[i].argument_buffer[j]) [renderer->rps[i].argument_buffer[j] release];
-        }
-        [renderer->rps[i].pipeline release];
-        [renderer->rps[i].depth_state release];
+        dm_metal_raster_pipe *pipe = dm_pool_get_slot(&renderer->rps, i);
+        if(pipe) dm_metal_release_raster_pipe(pipe);
     }
-    for(u32 i=0; i<renderer->rt_count; i++)
+    for(u32 i=0; i<renderer->rts.count; i++)
     {
-        if(renderer->rts[i].swapchain) continue;
+        dm_metal_render_target *target = dm_pool_get_slot(&renderer->rts, i);
+        if(!target || target->swapchain) continue;
+
+        [target->color_texture release];
+    }
 
-        [renderer->rts[i].color_texture release];
+    dm_pool_destroy(&renderer->rts);
+    dm_pool_destroy(&renderer->rps);
+    dm_pool_destroy(&renderer->buffers);
+    dm_pool_destroy(&renderer->textures);
+    dm_pool_destroy(&renderer->samplers);
+
+    if(renderer->resource_heap)
+    {
+        dm_mem_record_free(DM_MEM_TAG_GPU_DEVICE, renderer->resource_heap.size);
+        [renderer->resource_heap release];
     }
 
-    if(renderer->resource_heap) [renderer->resource_heap release];
+    for(u8 test=0; test<2; test++)
+    {
+        for(u8 write=0; write<2; write++)
+        {
+            [renderer->depth_states[test][write] release];
+        }
+    }
 
     [renderer->queue release];
     [renderer->swapchain.depth_texture release];
@@ -231,15 +334,39 @@ size_t dm_renderer_get_internal_size()
     return sizeof(dm_metal_renderer);
 }
 
-id<MTLLibrary> dm_metal_create_shader(id<MTLDevice> device, const char *path)
+id<MTLLibrary> dm_metal_create_shader(dm_context *context, id<MTLDevice> device, const char *path)
 {
     LOG_DEBUG("Creating shader from %s", path);
 
+    id<MTLLibrary> library = NULL;
+    NSError* library_error = NULL;
+
+    // libraries packed into the mounted archive are created straight from the mapping.
+    // the default destructor would copy the bytes, a custom one references them in place
+    // and keeps the archive pinned until metal lets go of the data
+    const dm_archive_entry *entry = dm_archive_find(&context->archive, path);
+    if(entry)
+    {
+        dm_archive *archive = &context->archive;
+        const u8   *bytes   = (const u8*)archive->file.data + entry->offset;
+
+        DM_ATOMIC_ADD(&archive->pins, 1);
+        dispatch_data_t data = dispatch_data_create(bytes, entry->size, NULL, ^{ DM_ATOMIC_SUB(&archive->pins, 1); });
+
+        library = [device newLibraryWithData:data error:&library_error];
+        dispatch_release(data);
+        if(!library)
+        {
+            LOG_ERROR("newLibraryWithData failed");
+            LOG_ERROR("%s", [library_error.localizedDescription UTF8String]);
+        }
+
+        return library;
+    }
+
     NSString* file = [NSString stringWithUTF8String:path];
 
-    id<MTLLibrary> library = NULL;
     NSURL* library_url = [NSURL URLWithString:file];
-    NSError* library_error = NULL;
 
     library = [device newLibraryWithURL:library_url error:&library_error];
     if(!library)
@@ -322,7 +449,7 @@ bool dm_renderer_create_raster_pipeline(dm_context *context, dm_raster_pipe_desc
     char fragment_path[512];
     sprintf(fragment_path, "%s.metallib", fragment_shader.path);
 
-    id<MTLLibrary> vertex_library = dm_metal_create_shader(renderer->device, vertex_path);
+    id<MTLLibrary> vertex_library = dm_metal_create_shader(context, renderer->device, vertex_path);
     if(!vertex_library)
     {
         LOG_ERROR("Could not create shader from %s", vertex_path);
@@ -331,7 +458,7 @@ bool dm_renderer_create_raster_pipeline(dm_context *context, dm_raster_pipe_desc
     id<MTLFunction> vertex_function = dm_metal_create_shader_function(renderer->device, vertex_library, vertex_shader.entry);
     if(!vertex_function) return false;
 
-    id<MTLLibrary> fragment_library = dm_metal_create_shader(renderer->device, fragment_path);
+    id<MTLLibrary> fragment_library = dm_metal_create_shader(context, renderer->device, fragment_path);
     if(!fragment_library)
     {
         [vertex_library release];
@@ -415,9 +542,18 @@ bool dm_renderer_create_raster_pipeline(dm_context *context, dm_raster_pipe_desc
     }
 
     //
-    renderer->rps[renderer->rp_count] = pipeline;
-    handle->type = DM_PIPELINE_TYPE_RASTER;
-    handle->index = renderer->rp_count++;
+    u32 index, generation;
+    dm_metal_raster_pipe *slot = dm_pool_alloc(&renderer->rps, &index, &generation);
+    if(!slot)
+    {
+        dm_metal_release_raster_pipe(&pipeline);
+        return false;
+    }
+
+    *slot = pipeline;
+    handle->type       = DM_PIPELINE_TYPE_RASTER;
+    handle->index      = index;
+    handle->generation = generation;
 
     return true;
 }
@@ -498,9 +634,14 @@ bool dm_renderer_create_render_target(dm_context *context, dm_render_target_desc
     }
 
     //
-    renderer->rts[renderer->rt_count] = render_target;
-    handle->type = DM_RESOURCE_TYPE_RENDER_TARGET;
-    handle->index = renderer->rt_count++;
+    u32 index, generation;
+    dm_metal_render_target *slot = dm_pool_alloc(&renderer->rts, &index, &generation);
+    if(!slot) return false;
+
+    *slot = render_target;
+    handle->type       = DM_RESOURCE_TYPE_RENDER_TARGET;
+    handle->index      = index;
+    handle->generation = generation;
 
     return true;
 }
@@ -509,7 +650,26 @@ bool dm_renderer_create_buffer(dm_context* context, dm_buffer_desc desc, dm_reso
 {
     dm_metal_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
 
-    dm_metal_buffer buffer = { 0 };
+    // every usage keeps the cached host copy next to the private buffer, it only decides what can be read back
+    dm_metal_buffer buffer = { .usage=desc.usage };
+
+    const dm_archive_entry *asset = NULL;
+    if(desc.asset)
+    {
+        asset = dm_archive_find(&context->archive, desc.asset);
+        if(!asset)
+        {
+            LOG_ERROR("Asset is not in the mounted archive: %s", desc.asset);
+            return false;
+        }
+
+        if(!desc.size) desc.size = asset->size;
+        if(desc.size < asset->size)
+        {
+            LOG_ERROR("Buffer is too small for asset: %s", desc.asset);
+            return false;
+        }
+    }
 
     size_t heap_size = desc.size;
     MTLSizeAndAlign size_align = [renderer->device heapBufferSizeAndAlignWithLength:heap_size options:MTLResourceStorageModePrivate];
@@ -523,6 +683,7 @@ bool dm_renderer_create_buffer(dm_context* context, dm_buffer_desc desc, dm_reso
         if(!buffer.host)
         {
             LOG_ERROR("newBufferWithBytes failed");
+            dm_mem_record_failed(DM_MEM_TAG_GPU_HOST);
             return false;
         }
     }
@@ -532,14 +693,37 @@ bool dm_renderer_create_buffer(dm_context* context, dm_buffer_desc desc, dm_reso
         if(!buffer.host)
         {
             LOG_ERROR("newBufferWithLength failed");
+            dm_mem_record_failed(DM_MEM_TAG_GPU_HOST);
+            return false;
+        }
+    }
+    dm_mem_record_alloc(DM_MEM_TAG_GPU_HOST, heap_size);
+
+    // assets are decoded by the job workers straight into the shared buffer
+    if(asset)
+    {
+        dm_archive_read read;
+        if(!dm_archive_read_begin(context, &context->archive, asset, buffer.host.contents, &read) || !dm_archive_read_wait(context, &read))
+        {
+            LOG_ERROR("Could not decode asset: %s", desc.asset);
+            dm_metal_release_buffer(&buffer);
             return false;
         }
     }
 
     //
-    renderer->buffers[renderer->buffer_count] = buffer;
-    handle->type = DM_RESOURCE_TYPE_BUFFER;
-    handle->index = renderer->buffer_count++;
+    u32 index, generation;
+    dm_metal_buffer *slot = dm_pool_alloc(&renderer->buffers, &index, &generation);
+    if(!slot)
+    {
+        dm_metal_release_buffer(&buffer);
+        return false;
+    }
+
+    *slot = buffer;
+    handle->type       = DM_RESOURCE_TYPE_BUFFER;
+    handle->index      = index;
+    handle->generation = generation;
 
     return true;
 }
@@ -553,12 +737,26 @@ bool dm_renderer_create_texture(dm_context *context, dm_texture2d_desc desc, dm_
     MTLPixelFormat format = MTLPixelFormatRGBA8Unorm;
     texture.size = desc.size;
     texture.host = dm_metal_create_texture(renderer->device, format, desc.width, desc.height, desc.data, &texture.size);
-    if(!texture.host) return false;
+    if(!texture.host)
+    {
+        dm_mem_record_failed(DM_MEM_TAG_GPU_HOST);
+        return false;
+    }
+    dm_mem_record_alloc(DM_MEM_TAG_GPU_HOST, texture.size);
 
     //
-    renderer->textures[renderer->texture_count] = texture;
-    handle->type = DM_RESOURCE_TYPE_TEXTURE;
-    handle->index = renderer->texture_count++;
+    u32 index, generation;
+    dm_metal_texture *slot = dm_pool_alloc(&renderer->textures, &index, &generation);
+    if(!slot)
+    {
+        dm_metal_release_texture(&texture);
+        return false;
+    }
+
+    *slot = texture;
+    handle->type       = DM_RESOURCE_TYPE_TEXTURE;
+    handle->index      = index;
+    handle->generation = generation;
 
     return true;
 }
@@ -590,9 +788,18 @@ bool dm_renderer_create_sampler(dm_context *context, dm_sampler_desc desc, dm_re
     [sampler_desc release];
 
     //
-    renderer->samplers[renderer->sampler_count] = sampler;
-    handle->type = DM_RESOURCE_TYPE_SAMPLER;
-    handle->index = renderer->sampler_count++;
+    u32 index, generation;
+    dm_metal_sampler *slot = dm_pool_alloc(&renderer->samplers, &index, &generation);
+    if(!slot)
+    {
+        [sampler.state release];
+        return false;
+    }
+
+    *slot = sampler;
+    handle->type       = DM_RESOURCE_TYPE_SAMPLER;
+    handle->index      = index;
+    handle->generation = generation;
 
     return true;
 }
@@ -613,13 +820,20 @@ bool dm_renderer_upload_resources_to_heap(dm_context *context, dm_resource *reso
     {
         dm_resource *resource = resources[i];
 
+        dm_metal_buffer *buffer;
+        dm_metal_texture *texture;
+
         switch(resource->type)
         {
             case DM_RESOURCE_TYPE_BUFFER:
-                heap_desc.size += renderer->buffers[resource->index].size;
+                buffer = dm_metal_get_buffer(renderer, *resource);
+                if(!buffer) return false;
+                heap_desc.size += buffer->size;
                 break;
             case DM_RESOURCE_TYPE_TEXTURE:
-                heap_desc.size += renderer->textures[resource->index].size;
+                texture = dm_metal_get_texture(renderer, *resource);
+                if(!texture) return false;
+                heap_desc.size += texture->size;
                 break;
 
             case DM_RESOURCE_TYPE_SAMPLER:
@@ -636,8 +850,10 @@ bool dm_renderer_upload_resources_to_heap(dm_context *context, dm_resource *reso
     if(!renderer->resource_heap)
     {
         LOG_ERROR("newHeapWithDescriptor failed");
+        dm_mem_record_failed(DM_MEM_TAG_GPU_DEVICE);
         return false;
     }
+    dm_mem_record_alloc(DM_MEM_TAG_GPU_DEVICE, renderer->resource_heap.size);
 
     // actually upload to heap
     for(u32 i=0; i<count; i++)
@@ -651,7 +867,7 @@ bool dm_renderer_upload_resources_to_heap(dm_context *context, dm_resource *reso
         switch(resource->type)
         {
             case DM_RESOURCE_TYPE_BUFFER:
-                buffer = &renderer->buffers[resource->index];
+                buffer = dm_metal_get_buffer(renderer, *resource);
 
                 buffer->device = [renderer->resource_heap newBufferWithLength:buffer->size options:MTLResourceStorageModePrivate];
                 if(!buffer->device) 
@@ -663,7 +879,7 @@ bool dm_renderer_upload_resources_to_heap(dm_context *context, dm_resource *reso
                 [blit copyFromBuffer:buffer->host sourceOffset:0 toBuffer:buffer->device destinationOffset:0 size:buffer->size];
                 break;
             case DM_RESOURCE_TYPE_TEXTURE:
-                texture = &renderer->textures[resource->index];
+                texture = dm_metal_get_texture(renderer, *resource);
 
                 texture_desc = [MTLTextureDescriptor new];
                 texture_desc.textureType = texture->host.textureType;
@@ -710,17 +926,118 @@ bool dm_renderer_upload_samplers_to_heap(dm_context *context, dm_resource *sampl
     return true;
 }
 
-bool dm_renderer_create_compute_pipeline(dm_context *context, dm_pipeline *handle)
+bool dm_renderer_create_compute_pipeline(dm_context *context, dm_compute_pipe_desc desc, dm_pipeline *handle)
 {
     dm_metal_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
     return true;
 }
 
+// metal pipelines come from precompiled metallibs and are cheap to create,
+// so these just build synchronously and are ready straight away
+bool dm_renderer_create_raster_pipeline_async(dm_context *context, dm_raster_pipe_desc desc, dm_pipeline fallback, dm_pipeline *handle)
+{
+    return dm_renderer_create_raster_pipeline(context, desc, handle);
+}
+
+// metal compute isn't implemented yet, so there is nothing to time. the first candidate is used as is
+bool dm_renderer_tune_compute_pipeline(dm_context *context, dm_compute_tune_desc desc, dm_compute_pipe_desc *tuned)
+{
+    if(!desc.candidate_count) return false;
+
+    *tuned = desc.pipe;
+    for(u32 i=0; i<3; i++)
+    {
+        if(!desc.candidates[0][i] || tuned->constant_count >= DM_MAX_SPEC_CONSTANTS) continue;
+
+        tuned->constants[tuned->constant_count++] = (dm_spec_constant){ .id=desc.size_ids[i], .value=desc.candidates[0][i] };
+    }
+
+    return true;
+}
+
+bool dm_renderer_create_compute_pipeline_async(dm_context *context, dm_compute_pipe_desc desc, dm_pipeline fallback, dm_pipeline *handle)
+{
+    return dm_renderer_create_compute_pipeline(context, desc, handle);
+}
+
+dm_pipeline_status dm_renderer_get_pipeline_status(dm_context *context, dm_pipeline handle)
+{
+    dm_metal_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
+
+    if(handle.type != DM_PIPELINE_TYPE_RASTER || !dm_pool_get(&renderer->rps, handle.index, handle.generation)) return DM_PIPELINE_STATUS_INVALID;
+
+    return DM_PIPELINE_STATUS_READY;
+}
+
+void dm_renderer_destroy_pipeline(dm_context *context, dm_pipeline handle)
+{
+    dm_metal_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
+
+    dm_metal_raster_pipe *pipe = dm_metal_get_raster_pipe(renderer, handle);
+    if(!pipe) return;
+
+    dm_metal_release_raster_pipe(pipe);
+
+    if(renderer->active_pipeline.index == handle.index && renderer->active_pipeline.generation == handle.generation)
+        renderer->active_pipeline.type = DM_PIPELINE_TYPE_INVALID;
+
+    dm_pool_free(&renderer->rps, handle.index, handle.generation);
+}
+
+void dm_renderer_destroy_render_target(dm_context *context, dm_resource handle)
+{
+    dm_metal_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
+
+    dm_metal_render_target *target = dm_metal_get_render_target(renderer, handle);
+    if(!target) return;
+
+    if(!target->swapchain) [target->color_texture release];
+
+    dm_pool_free(&renderer->rts, handle.index, handle.generation);
+}
+
+void dm_renderer_destroy_buffer(dm_context *context, dm_resource handle)
+{
+    dm_metal_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
+
+    dm_metal_buffer *buffer = dm_metal_get_buffer(renderer, handle);
+    if(!buffer) return;
+
+    dm_metal_release_buffer(buffer);
+
+    dm_pool_free(&renderer->buffers, handle.index, handle.generation);
+}
+
+void dm_renderer_destroy_texture(dm_context *context, dm_resource handle)
+{
+    dm_metal_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
+
+    dm_metal_texture *texture = dm_metal_get_texture(renderer, handle);
+    if(!texture) return;
+
+    dm_metal_release_texture(texture);
+
+    dm_pool_free(&renderer->textures, handle.index, handle.generation);
+}
+
+void dm_renderer_destroy_sampler(dm_context *context, dm_resource handle)
+{
+    dm_metal_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
+
+    dm_metal_sampler *sampler = dm_metal_get_sampler(renderer, handle);
+    if(!sampler) return;
+
+    [sampler->state release];
+
+    dm_pool_free(&renderer->samplers, handle.index, handle.generation);
+}
+
 // commands
 void dm_render_command_begin_rendering(dm_context *context, dm_resource handle, float r, float g, float b, float a, float d)
 {
     dm_metal_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
-    dm_metal_render_target *target = &renderer->rts[handle.index];
+    dm_metal_render_target *target = dm_metal_get_render_target(renderer, handle);
+    if(!target) return;
 
     id<MTLTexture> color_texture = target->swapchain ? [renderer->swapchain.drawable texture] : target->color_texture;
 
@@ -772,16 +1089,21 @@ void dm_render_command_end_rendering(dm_context *context, dm_resource handle)
 void dm_render_command_bind_pipeline(dm_context *context, dm_pipeline handle)
 {
     dm_metal_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
-    dm_metal_raster_pipe pipeline = renderer->rps[handle.index];
+    dm_metal_raster_pipe *pipeline = dm_metal_get_raster_pipe(renderer, handle);
+    if(!pipeline) return;
 
     id<MTLRenderCommandEncoder> encoder = renderer->render_encoder;
 
-    [encoder setRenderPipelineState:pipeline.pipeline];
-    [encoder setDepthStencilState:pipeline.depth_state];
+    [encoder setRenderPipelineState:pipeline->pipeline];
+    [encoder setDepthStencilState:pipeline->depth_state];
     [encoder setCullMode:MTLCullModeBack];
     [encoder setFrontFacingWinding:MTLWindingClockwise];
     [encoder setTriangleFillMode:MTLTriangleFillModeFill];
 
+    renderer->depth_test     = true;
+    renderer->depth_write    = true;
+    renderer->primitive_type = MTLPrimitiveTypeTriangle;
+
     renderer->active_pipeline = handle;
 }
 
@@ -789,18 +1111,22 @@ void dm_render_command_bind_index_buffer(dm_context *context, dm_resource handle
 {
     dm_metal_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
 
-    renderer->active_index_buffer = renderer->buffers[handle.index].device;
+    dm_metal_buffer *buffer = dm_metal_get_buffer(renderer, handle);
+    if(!buffer) return;
+
+    renderer->active_index_buffer = buffer->device;
 }
 
 void dm_metal_push_raster_data(dm_metal_renderer *renderer, dm_pipeline handle, dm_resource *resources, u32 count)
 {
-    dm_metal_raster_pipe pipeline = renderer->rps[handle.index];
+    dm_metal_raster_pipe *pipeline = dm_metal_get_raster_pipe(renderer, handle);
+    if(!pipeline) return;
 
     id<MTLRenderCommandEncoder> encoder = renderer->render_encoder;
-    id<MTLBuffer> argument_buffer = pipeline.argument_buffer[renderer->frame_index];
+    id<MTLBuffer> argument_buffer = pipeline->argument_buffer[renderer->frame_index];
 
-    id<MTLArgumentEncoder> vertex_encoder = pipeline.vertex_encoder;
-    id<MTLArgumentEncoder> fragment_encoder = pipeline.fragment_encoder;
+    id<MTLArgumentEncoder> vertex_encoder = pipeline->vertex_encoder;
+    id<MTLArgumentEncoder> fragment_encoder = pipeline->fragment_encoder;
 
     [vertex_encoder setArgumentBuffer:argument_buffer offset:0];
     [fragment_encoder setArgumentBuffer:argument_buffer offset:0];
@@ -809,19 +1135,29 @@ void dm_metal_push_raster_data(dm_metal_renderer *renderer, dm_pipeline handle,
     {
         dm_resource resource = resources[i];
 
+        dm_metal_buffer *buffer;
+        dm_metal_texture *texture;
+        dm_metal_sampler *sampler;
+
         switch(resource.type)
         {
             case DM_RESOURCE_TYPE_BUFFER:
-                [vertex_encoder setBuffer:renderer->buffers[resource.index].device offset:0 atIndex:i];
-                [fragment_encoder setBuffer:renderer->buffers[resource.index].device offset:0 atIndex:i];
+                buffer = dm_metal_get_buffer(renderer, resource);
+                if(!buffer) continue;
+                [vertex_encoder setBuffer:buffer->device offset:0 atIndex:i];
+                [fragment_encoder setBuffer:buffer->device offset:0 atIndex:i];
                 break;
             case DM_RESOURCE_TYPE_TEXTURE:
-                [vertex_encoder setTexture:renderer->textures[resource.index].device atIndex:i];
-                [fragment_encoder setTexture:renderer->textures[resource.index].device atIndex:i];
+                texture = dm_metal_get_texture(renderer, resource);
+                if(!texture) continue;
+                [vertex_encoder setTexture:texture->device atIndex:i];
+                [fragment_encoder setTexture:texture->device atIndex:i];
                 break;
             case DM_RESOURCE_TYPE_SAMPLER:
-                [vertex_encoder setSamplerState:renderer->samplers[resource.index].state atIndex:i];
-                [fragment_encoder setSamplerState:renderer->samplers[resource.index].state atIndex:i];
+                sampler = dm_metal_get_sampler(renderer, resource);
+                if(!sampler) continue;
+                [vertex_encoder setSamplerState:sampler->state atIndex:i];
+                [fragment_encoder setSamplerState:sampler->state atIndex:i];
                 break;
             default:
                 LOG_WARN("Unknown/unsupported resource type");
@@ -855,23 +1191,121 @@ void dm_render_command_draw(dm_context *context, u32 index_count, u32 instance_c
     dm_metal_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
     id<MTLRenderCommandEncoder> encoder = renderer->render_encoder;
 
-    [encoder drawIndexedPrimitives:MTLPrimitiveTypeTriangle indexCount:index_count indexType:MTLIndexTypeUInt32 indexBuffer:renderer->active_index_buffer indexBufferOffset:0 instanceCount:instance_count];
+    [encoder drawIndexedPrimitives:renderer->primitive_type indexCount:index_count indexType:MTLIndexTypeUInt32 indexBuffer:renderer->active_index_buffer indexBufferOffset:0 instanceCount:instance_count];
 }
 
-void dm_render_command_update_buffer(dm_context *context, dm_resource handle, void *data, size_t size)
+void dm_render_command_set_cull_mode(dm_context *context, dm_cull_mode mode)
 {
     dm_metal_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
-    dm_metal_buffer buffer = renderer->buffers[handle.index];
+
+    MTLCullMode cull_mode;
+    switch(mode)
+    {
+        case DM_CULL_MODE_NONE:  cull_mode = MTLCullModeNone; break;
+        case DM_CULL_MODE_FRONT: cull_mode = MTLCullModeFront; break;
+        default:                 cull_mode = MTLCullModeBack; break;
+    }
+
+    [renderer->render_encoder setCullMode:cull_mode];
+}
+
+void dm_render_command_set_primitive_topology(dm_context *context, dm_primitive_topology topology)
+{
+    dm_metal_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
+
+    switch(topology)
+    {
+        case DM_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP: renderer->primitive_type = MTLPrimitiveTypeTriangleStrip; break;
+        case DM_PRIMITIVE_TOPOLOGY_LINE_LIST:      renderer->primitive_type = MTLPrimitiveTypeLine; break;
+        case DM_PRIMITIVE_TOPOLOGY_LINE_STRIP:     renderer->primitive_type = MTLPrimitiveTypeLineStrip; break;
+        case DM_PRIMITIVE_TOPOLOGY_POINT_LIST:     renderer->primitive_type = MTLPrimitiveTypePoint; break;
+        default:                                   renderer->primitive_type = MTLPrimitiveTypeTriangle; break;
+    }
+}
+
+void dm_render_command_set_depth_test(dm_context *context, bool enable)
+{
+    dm_metal_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
+
+    renderer->depth_test = enable;
+    [renderer->render_encoder setDepthStencilState:renderer->depth_states[renderer->depth_test][renderer->depth_write]];
+}
+
+void dm_render_command_set_depth_write(dm_context *context, bool enable)
+{
+    dm_metal_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
+
+    renderer->depth_write = enable;
+    [renderer->render_encoder setDepthStencilState:renderer->depth_states[renderer->depth_test][renderer->depth_write]];
+}
+
+// blending is part of MTLRenderPipelineState
+void dm_render_command_set_blend(dm_context *context, bool enable, dm_blend_op color_op, dm_blend_factor color_src, dm_blend_factor color_dst, dm_blend_op alpha_op, dm_blend_factor alpha_src, dm_blend_factor alpha_dst)
+{
+    dm_metal_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
+
+    if(!renderer->warned_dynamic_blend) LOG_WARN("Metal has no dynamic blend state, ignoring blend changes");
+    renderer->warned_dynamic_blend = true;
+}
+
+void dm_render_command_update_buffer_range(dm_context *context, dm_resource handle, void *data, size_t offset, size_t size)
+{
+    dm_metal_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
+    dm_metal_buffer *buffer = dm_metal_get_buffer(renderer, handle);
+    if(!buffer) return;
+
+    if(offset > buffer->size || size > buffer->size - offset)
+    {
+        LOG_ERROR("Buffer update of %zu bytes at offset %zu is outside the buffer (%zu bytes)", size, offset, buffer->size);
+        return;
+    }
 
     id<MTLCommandBuffer> cmd = [renderer->queue commandBuffer];
     id<MTLBlitCommandEncoder> blit = [cmd blitCommandEncoder];
 
-    memcpy(buffer.host.contents, data, size);
+    memcpy((u8*)buffer->host.contents + offset, data, size);
+
+    [blit copyFromBuffer:buffer->host sourceOffset:offset toBuffer:buffer->device destinationOffset:offset size:size];
+
+    [blit endEncoding];
+    [cmd commit];
+}
+
+void dm_render_command_update_buffer(dm_context *context, dm_resource handle, void *data, size_t size)
+{
+    dm_render_command_update_buffer_range(context, handle, data, 0, size);
+}
+
+bool dm_renderer_read_buffer(dm_context *context, dm_resource handle, void *data, size_t offset, size_t size)
+{
+    dm_metal_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
+    dm_metal_buffer *buffer = dm_metal_get_buffer(renderer, handle);
+    if(!buffer) return false;
+
+    if(buffer->usage != DM_BUFFER_USAGE_READBACK)
+    {
+        LOG_ERROR("Only readback buffers can be read");
+        return false;
+    }
+    if(offset > buffer->size || size > buffer->size - offset)
+    {
+        LOG_ERROR("Buffer read of %zu bytes at offset %zu is outside the buffer (%zu bytes)", size, offset, buffer->size);
+        return false;
+    }
+
+    // the device buffer is private, copy back through the host one after everything committed so far
+    id<MTLCommandBuffer> cmd = [renderer->queue commandBuffer];
+    id<MTLBlitCommandEncoder> blit = [cmd blitCommandEncoder];
 
-    [blit copyFromBuffer:buffer.host sourceOffset:0 toBuffer:buffer.device destinationOffset:0 size:size];
+    [blit copyFromBuffer:buffer->device sourceOffset:offset toBuffer:buffer->host destinationOffset:offset size:size];
 
     [blit endEncoding];
     [cmd commit];
+    [cmd waitUntilCompleted];
+
+    memcpy(data, (u8*)buffer->host.contents + offset, size);
+
+    return true;
 }
 
 bool dm_render_command_update_texture(dm_context *context, dm_resource handle, void* data, size_t size, u16 width, u16 height)
@@ -0,0 +1,311 @@
+#include "dm.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+// mutex
+void dm_mutex_init(dm_mutex *mutex)
+{
+#ifdef _WIN32
+    InitializeSRWLock((SRWLOCK*)&mutex->handle);
+#else
+    pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+void dm_mutex_destroy(dm_mutex *mutex)
+{
+#ifndef _WIN32
+    pthread_mutex_destroy(mutex);
+#endif
+}
+
+void dm_mutex_lock(dm_mutex *mutex)
+{
+#ifdef _WIN32
+    AcquireSRWLockExclusive((SRWLOCK*)&mutex->handle);
+#else
+    pthread_mutex_lock(mutex);
+#endif
+}
+
+void dm_mutex_unlock(dm_mutex *mutex)
+{
+#ifdef _WIN32
+    ReleaseSRWLockExclusive((SRWLOCK*)&mutex->handle);
+#else
+    pthread_mutex_unlock(mutex);
+#endif
+}
+
+// condition variable
+void dm_cond_init(dm_cond *cond)
+{
+#ifdef _WIN32
+    InitializeConditionVariable((CONDITION_VARIABLE*)&cond->handle);
+#else
+    pthread_cond_init(cond, NULL);
+#endif
+}
+
+void dm_cond_destroy(dm_cond *cond)
+{
+#ifndef _WIN32
+    pthread_cond_destroy(cond);
+#endif
+}
+
+void dm_cond_wait(dm_cond *cond, dm_mutex *mutex)
+{
+#ifdef _WIN32
+    SleepConditionVariableSRW((CONDITION_VARIABLE*)&cond->handle, (SRWLOCK*)&mutex->handle, INFINITE, 0);
+#else
+    pthread_cond_wait(cond, mutex);
+#endif
+}
+
+void dm_cond_signal(dm_cond *cond)
+{
+#ifdef _WIN32
+    WakeConditionVariable((CONDITION_VARIABLE*)&cond->handle);
+#else
+    pthread_cond_signal(cond);
+#endif
+}
+
+void dm_cond_broadcast(dm_cond *cond)
+{
+#ifdef _WIN32
+    WakeAllConditionVariable((CONDITION_VARIABLE*)&cond->handle);
+#else
+    pthread_cond_broadcast(cond);
+#endif
+}
+
+/********
+ * JOBS
+ ********/
+typedef struct dm_job_t
+{
+    dm_job_func     func;
+    void*           data;
+    dm_job_counter* counter;
+} dm_job;
+
+typedef struct dm_job_system_t
+{
+    dm_thread workers[DM_JOB_MAX_WORKERS];
+    u32       worker_count;
+
+    // ring buffer, head is the next job to run
+    dm_job queue[DM_JOB_QUEUE_SIZE];
+    u32    head, count;
+
+    dm_mutex lock;
+    dm_cond  has_work, job_done;
+    bool     running;
+
+    volatile u32 next_thread_index;
+} dm_job_system;
+
+static DM_THREAD_LOCAL u32 dm_job_thread_index;
+
+u32 dm_jobs_get_cpu_count()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? count : 1;
+#endif
+}
+
+// expects the lock to be held
+bool dm_jobs_pop(dm_job_system *jobs, dm_job *job)
+{
+    if(!jobs->count) return false;
+
+    *job = jobs->queue[jobs->head];
+    jobs->head = (jobs->head + 1) % DM_JOB_QUEUE_SIZE;
+    jobs->count--;
+
+    return true;
+}
+
+void dm_jobs_run(dm_job_system *jobs, dm_job job)
+{
+    job.func(job.data);
+
+    if(!job.counter) return;
+    DM_ATOMIC_SUB(&job.counter->value, 1);
+
+    // waiters sleep on the lock, so take it to not miss the wake up
+    dm_mutex_lock(&jobs->lock);
+    dm_cond_broadcast(&jobs->job_done);
+    dm_mutex_unlock(&jobs->lock);
+}
+
+void dm_jobs_worker(dm_job_system *jobs)
+{
+    dm_job job;
+
+    dm_job_thread_index = DM_ATOMIC_ADD(&jobs->next_thread_index, 1);
+
+    while(true)
+    {
+        dm_mutex_lock(&jobs->lock);
+        while(jobs->running && !jobs->count) dm_cond_wait(&jobs->has_work, &jobs->lock);
+
+        // drain whatever is left before exiting
+        if(!dm_jobs_pop(jobs, &job))
+        {
+            dm_mutex_unlock(&jobs->lock);
+            return;
+        }
+        dm_mutex_unlock(&jobs->lock);
+
+        dm_jobs_run(jobs, job);
+    }
+}
+
+#ifdef _WIN32
+DWORD WINAPI dm_jobs_thread_proc(LPVOID data)
+{
+    dm_jobs_worker(data);
+    return 0;
+}
+#else
+void* dm_jobs_thread_proc(void *data)
+{
+    dm_jobs_worker(data);
+    return NULL;
+}
+#endif
+
+bool dm_jobs_init(dm_context *context)
+{
+    dm_job_system *jobs = dm_arena_alloc(&context->arena, sizeof(dm_job_system), &context->jobs.offset);
+    if(!jobs) return false;
+
+    *jobs = (dm_job_system){ .running=true };
+
+    dm_mutex_init(&jobs->lock);
+    dm_cond_init(&jobs->has_work);
+    dm_cond_init(&jobs->job_done);
+
+    // leave a core for the main thread
+    u32 worker_count = dm_jobs_get_cpu_count();
+    worker_count = worker_count > 1 ? worker_count - 1 : 1;
+    if(worker_count > DM_JOB_MAX_WORKERS) worker_count = DM_JOB_MAX_WORKERS;
+
+    for(u32 i=0; i<worker_count; i++)
+    {
+#ifdef _WIN32
+        jobs->workers[i] = CreateThread(NULL, 0, dm_jobs_thread_proc, jobs, 0, NULL);
+        if(!jobs->workers[i])
+#else
+        if(pthread_create(&jobs->workers[i], NULL, dm_jobs_thread_proc, jobs) != 0)
+#endif
+        {
+            LOG_ERROR("Could not create job worker %u", i);
+            break;
+        }
+
+        jobs->worker_count++;
+    }
+
+    if(!jobs->worker_count) return false;
+
+    context->jobs.worker_count = jobs->worker_count;
+    LOG_INFO("Started %u job workers", jobs->worker_count);
+
+    return true;
+}
+
+void dm_jobs_shutdown(dm_context *context)
+{
+    dm_job_system *jobs = dm_arena_get_ptr(context->arena, context->jobs.offset);
+
+    dm_mutex_lock(&jobs->lock);
+    jobs->running = false;
+    dm_cond_broadcast(&jobs->has_work);
+    dm_mutex_unlock(&jobs->lock);
+
+    for(u32 i=0; i<jobs->worker_count; i++)
+    {
+#ifdef _WIN32
+        WaitForSingleObject(jobs->workers[i], INFINITE);
+        CloseHandle(jobs->workers[i]);
+#else
+        pthread_join(jobs->workers[i], NULL);
+#endif
+    }
+
+    dm_cond_destroy(&jobs->job_done);
+    dm_cond_destroy(&jobs->has_work);
+    dm_mutex_destroy(&jobs->lock);
+}
+
+size_t dm_jobs_get_internal_size()
+{
+    return sizeof(dm_job_system);
+}
+
+void dm_job_submit(dm_context *context, dm_job_func func, void *data, dm_job_counter *counter)
+{
+    dm_job_system *jobs = dm_arena_get_ptr(context->arena, context->jobs.offset);
+
+    dm_job job = { .func=func, .data=data, .counter=counter };
+    if(counter) DM_ATOMIC_ADD(&counter->value, 1);
+
+    dm_mutex_lock(&jobs->lock);
+    if(jobs->count < DM_JOB_QUEUE_SIZE)
+    {
+        jobs->queue[(jobs->head + jobs->count) % DM_JOB_QUEUE_SIZE] = job;
+        jobs->count++;
+
+        dm_cond_signal(&jobs->has_work);
+        dm_mutex_unlock(&jobs->lock);
+        return;
+    }
+    dm_mutex_unlock(&jobs->lock);
+
+    dm_jobs_run(jobs, job);
+}
+
+bool dm_job_is_done(dm_job_counter *counter)
+{
+    return DM_ATOMIC_LOAD(&counter->value) == 0;
+}
+
+u32 dm_job_get_thread_index()
+{
+    return dm_job_thread_index;
+}
+
+// the waiting thread helps out with queued jobs instead of just sleeping
+void dm_job_wait(dm_context *context, dm_job_counter *counter)
+{
+    dm_job_system *jobs = dm_arena_get_ptr(context->arena, context->jobs.offset);
+    dm_job job;
+
+    dm_mutex_lock(&jobs->lock);
+    while(!dm_job_is_done(counter))
+    {
+        if(dm_jobs_pop(jobs, &job))
+        {
+            dm_mutex_unlock(&jobs->lock);
+            dm_jobs_run(jobs, job);
+            dm_mutex_lock(&jobs->lock);
+            continue;
+        }
+
+        dm_cond_wait(&jobs->job_done, &jobs->lock);
+    }
+    dm_mutex_unlock(&jobs->lock);
+}
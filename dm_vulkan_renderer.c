@@ -10,16 +10,39 @@
 #include <shaderc/shaderc.h>
 
 #include <assert.h>
+#include <string.h>
+#include <limits.h>
 
 #define DM_SWAPCHAIN_MAX_IMAGES 5
 #define DM_SWAPCHAIN_FORMAT     VK_FORMAT_B8G8R8A8_SRGB
 #define DM_DEPTH_FORMAT         VK_FORMAT_D32_SFLOAT
 
+#define DM_VULKAN_INVALID_HEAP_INDEX UINT32_MAX
+
 extern VkSurfaceKHR dm_window_create_vulkan_surface(dm_context *context, VkInstance instance);
 extern const char** dm_window_get_vulkan_extensions(u32 *glfw_ext_count);
 
 bool dm_vulkan_decode_vr(VkResult vr);
 
+// host allocations made by the driver and vma go through these when the alloc guard is built in
+#ifdef DM_ALLOC_GUARD
+extern VkAllocationCallbacks dm_vulkan_allocation_callbacks;
+#define DM_VULKAN_ALLOCATOR (&dm_vulkan_allocation_callbacks)
+#else
+#define DM_VULKAN_ALLOCATOR NULL
+#endif
+
+// optional device extensions, enabled when the driver has them
+typedef struct dm_vulkan_gpu_extensions_t
+{
+    bool pipeline_binary;
+    bool shader_object;
+
+    // VK_EXT_extended_dynamic_state3 with dynamic blend enable/equation, and whether topology can change class
+    bool extended_dynamic_state3;
+    bool unrestricted_topology;
+} dm_vulkan_gpu_extensions;
+
 typedef struct dm_vulkan_gpu_t
 {
     VkPhysicalDevice physical;
@@ -27,14 +50,22 @@ typedef struct dm_vulkan_gpu_t
 
     VkQueue gfx_queue;
     u32     gfx_index;
+    u32     gfx_timestamp_bits;
 
     VkQueue compute_queue;
     u32     compute_index;
 
+    // the graphics queue when there is no dedicated transfer family
+    VkQueue transfer_queue;
+    u32     transfer_index;
+
     VkPhysicalDeviceFeatures   features;
     VkPhysicalDeviceProperties properties;
     VkPhysicalDeviceProperties2 props2;
     VkPhysicalDeviceDescriptorHeapPropertiesEXT heap_props;
+    VkPhysicalDevicePipelineBinaryPropertiesKHR binary_props;
+
+    dm_vulkan_gpu_extensions extensions;
 } dm_vulkan_gpu;
 
 typedef struct dm_vulkan_surface_t
@@ -77,6 +108,70 @@ typedef struct dm_vulkan_frame_data_t
     VkSemaphore     semaphore;
 } dm_vulkan_frame_data;
 
+#define DM_VULKAN_STAGING_FRAME_SIZE (8 * 1024 * 1024)
+#define DM_VULKAN_STAGING_ALIGNMENT  16
+
+// one persistently mapped buffer with a slice per frame in flight. begin_frame has already
+// waited on the frame that last used a slice, so it can be rewritten without any sync
+typedef struct dm_vulkan_staging_ring_t
+{
+    VkBuffer      buffer;
+    VmaAllocation allocation;
+    u8*           mapped;
+
+    // current frame's slice
+    VkDeviceSize offset, end;
+} dm_vulkan_staging_ring;
+
+#define DM_VULKAN_MAX_DIRTY_RANGES  16
+#define DM_VULKAN_MAX_DIRTY_BUFFERS 64
+
+// dst is the offset in the device buffer, src the one in the staging ring
+typedef struct dm_vulkan_dirty_range_t
+{
+    VkDeviceSize dst, src, size;
+} dm_vulkan_dirty_range;
+
+typedef struct dm_vulkan_dirty_buffer_t
+{
+    dm_resource           handle;
+    dm_vulkan_dirty_range ranges[DM_VULKAN_MAX_DIRTY_RANGES];
+    u32                   range_count;
+} dm_vulkan_dirty_buffer;
+
+#define DM_VULKAN_UPLOAD_BATCHES      4
+#define DM_VULKAN_UPLOAD_MAX_ACQUIRES 256
+
+typedef struct dm_vulkan_upload_batch_t
+{
+    VkCommandPool   pool;
+    VkCommandBuffer cmd;
+    u64             value;
+} dm_vulkan_upload_batch;
+
+// uploads are batched on the transfer queue, each batch signals the next value of the upload timeline.
+// with a dedicated transfer family the resources are released to the graphics family at the end of
+// the batch and the matching acquires wait here until they are recorded on the graphics queue
+typedef struct dm_vulkan_upload_engine_t
+{
+    VkQueue queue;
+    u32     family;
+
+    VkSemaphore semaphore;
+    u64         value; // last submitted
+
+    dm_vulkan_upload_batch batches[DM_VULKAN_UPLOAD_BATCHES];
+    u32  batch_index;
+    bool recording;
+
+    // the open batch overwrites resources earlier frames may still read
+    bool wait_frames;
+
+    VkBufferMemoryBarrier2 buffer_acquires[DM_VULKAN_UPLOAD_MAX_ACQUIRES];
+    VkImageMemoryBarrier2  image_acquires[DM_VULKAN_UPLOAD_MAX_ACQUIRES];
+    u32 buffer_acquire_count, image_acquire_count;
+} dm_vulkan_upload_engine;
+
 typedef struct dm_vulkan_resource_descriptor_heap_t
 {
     VkBuffer buffer;
@@ -85,7 +180,15 @@ typedef struct dm_vulkan_resource_descriptor_heap_t
     size_t buffer_size, image_size;
     size_t image_offset;
     size_t buffer_count, image_count;
-    size_t size, count;
+    size_t size;
+
+    // dynamic buffers take a descriptor per frame in flight, so there are that many buffer slots per buffer
+    size_t max_buffers, max_images;
+
+    // slots of destroyed resources, reused before growing the counts above
+    u32* free_buffers;
+    u32* free_images;
+    u32  free_buffer_count, free_image_count;
 
     void *start;
 } dm_vulkan_resource_descriptor_heap;
@@ -98,9 +201,35 @@ typedef struct dm_vulkan_sampler_descriptor_heap_t
     size_t sampler_size, sampler_count;
     size_t size, count, min_size;
 
+    size_t max_samplers;
+
+    u32* free_samplers;
+    u32  free_sampler_count;
+
     void *start;
 } dm_vulkan_sampler_descriptor_heap;
 
+typedef struct dm_vulkan_buffer_t
+{
+    VkBuffer      host, device;
+    VmaAllocation host_alloc, device_alloc;
+
+    size_t size;
+
+    // dynamic buffers keep one copy per frame in flight, stride apart. everything else only uses the first
+    size_t stride;
+    u32    heap_indices[DM_FRAMES_IN_FLIGHT];
+
+    // dynamic and readback buffers live in host visible memory and are written/read through this
+    u8* mapped;
+
+    // upload timeline value of the last batch reading host
+    u64 upload_value;
+
+    dm_buffer_type  type;
+    dm_buffer_usage usage;
+} dm_vulkan_buffer;
+
 typedef struct dm_vulkan_image_t
 {
     VkImage       image;
@@ -110,7 +239,7 @@ typedef struct dm_vulkan_image_t
     VkDescriptorType type;
     VkImageUsageFlags usage;
 
-    u32 buffer_index;
+    dm_vulkan_buffer staging;
     u32 width, height;
 
     u32 heap_index;
@@ -118,17 +247,6 @@ typedef struct dm_vulkan_image_t
     void *heap_address;
 } dm_vulkan_image;
 
-typedef struct dm_vulkan_buffer_t
-{
-    VkBuffer      host, device;
-    VmaAllocation host_alloc, device_alloc;
-
-    size_t size;
-    u32    heap_index;
-
-    dm_buffer_type type;
-} dm_vulkan_buffer;
-
 typedef struct dm_vulkan_render_target_t
 {
     dm_resource color_target; // ignored if swapchain
@@ -148,14 +266,99 @@ typedef struct dm_vulkan_sampler_t
     u32 heap_index;
 } dm_vulkan_sampler;
 
+typedef struct dm_vulkan_pipeline_build_t dm_vulkan_pipeline_build;
+
 #define DM_VULKAN_MAX_RESOURCES 10
 typedef struct dm_vulkan_pipeline_t
 {
     VkPipeline pipeline;
 
+    // raster pipelines in shader object mode have these instead of pipeline
+    VkShaderEXT shaders[DM_RASTER_SHADER_STAGE_MAX];
+
+    // what a raster pipeline resets dynamic blending to when bound
+    VkBool32                blend;
+    VkColorBlendEquationEXT blend_equation;
+
     u32 push_indices[DM_FRAMES_IN_FLIGHT][DM_VULKAN_MAX_RESOURCES];
+
+    dm_pipeline_status        status;
+    dm_pipeline               fallback;
+    dm_vulkan_pipeline_build* build;
+
+    // identical descriptions share one pipeline, it goes away with the last reference
+    u64 hash;
+    u32 ref_count;
 } dm_vulkan_pipeline;
 
+// owned by the job building it until counter hits zero, then handed over by dm_vulkan_poll_pipeline
+struct dm_vulkan_pipeline_build_t
+{
+    dm_context*          context;
+    dm_pipeline_type     type;
+    dm_raster_pipe_desc  raster_desc;
+    dm_compute_pipe_desc compute_desc;
+
+    dm_vulkan_pipeline result;
+    bool               success;
+    dm_job_counter     counter;
+};
+
+// open addressing, linear probing. a hash of 0 marks an empty slot
+#define DM_VULKAN_PIPELINE_TABLE_MIN_CAPACITY 32
+
+typedef struct dm_vulkan_pipeline_table_t
+{
+    u64*         hashes;
+    dm_pipeline* handles;
+    u32          capacity, count;
+} dm_vulkan_pipeline_table;
+
+// compiled spir-v by variant key, see dm_vulkan_shader_variant_key. same probing as the pipeline table
+#define DM_VULKAN_SHADER_STRING_MAX 512 // path and entry size in the pipe descs
+
+typedef struct dm_vulkan_spirv_t
+{
+    u32*   code;
+    size_t size;
+} dm_vulkan_spirv;
+
+typedef struct dm_vulkan_shader_variants_t
+{
+    u64*             keys;
+    dm_vulkan_spirv* spirv;
+    u32              capacity, count;
+} dm_vulkan_shader_variants;
+
+// objects released by dm_renderer_destroy_* are kept alive until the gpu 
+// has signalled the timeline value of the last frame that could use them
+typedef struct dm_vulkan_deferred_destroy_t
+{
+    VkPipeline    pipeline;
+    VkShaderEXT   shaders[DM_RASTER_SHADER_STAGE_MAX];
+    VkBuffer      buffers[2];
+    VmaAllocation buffer_allocs[2];
+    VkImage       image;
+    VmaAllocation image_alloc;
+
+    // descriptor heap slots can only be rewritten once no frame reads them
+    u32 buffer_heap_slot, image_heap_slot, sampler_heap_slot;
+
+    u64 timeline_value;
+} dm_vulkan_deferred_destroy;
+
+#define DM_VULKAN_DEFERRED_DESTROY_STRIDE DM_ALIGN(sizeof(dm_vulkan_deferred_destroy), DM_ARENA_ALIGNMENT)
+// entries start out owning no heap slots
+#define DM_VULKAN_DEFERRED_DESTROY_INIT { .buffer_heap_slot=DM_VULKAN_INVALID_HEAP_INDEX, .image_heap_slot=DM_VULKAN_INVALID_HEAP_INDEX, .sampler_heap_slot=DM_VULKAN_INVALID_HEAP_INDEX }
+
+#ifndef DM_OFFLINE_SHADERS_ONLY
+typedef struct dm_vulkan_shader_compiler_t
+{
+    shaderc_compiler_t        compiler;
+    shaderc_compile_options_t options;
+} dm_vulkan_shader_compiler;
+#endif
+
 typedef struct dm_vulkan_renderer_t
 {
     VkInstance       instance;
@@ -169,7 +372,14 @@ typedef struct dm_vulkan_renderer_t
     dm_vulkan_resource_descriptor_heap resource_heap;
     dm_vulkan_sampler_descriptor_heap  sampler_heap;
 
-    VkCommandPool single_use_pool;
+    VkCommandPool   single_use_pool;
+    VkCommandBuffer single_use_cmd;
+
+    dm_vulkan_staging_ring  staging_ring;
+    dm_vulkan_upload_engine upload;
+
+    dm_vulkan_dirty_buffer dirty_buffers[DM_VULKAN_MAX_DIRTY_BUFFERS];
+    u32                    dirty_buffer_count;
 
     VkSemaphore timeline_semaphore;
     u64         timeline_value;
@@ -177,16 +387,37 @@ typedef struct dm_vulkan_renderer_t
     u32 frame_index;
 
     // resources
-    dm_vulkan_image images[DM_MAX_TEXTURES * DM_FRAMES_IN_FLIGHT];
-    dm_vulkan_buffer buffers[DM_MAX_BUFFERS * DM_FRAMES_IN_FLIGHT]; 
-    dm_vulkan_sampler samplers[DM_MAX_SAMPLERS * DM_FRAMES_IN_FLIGHT];
-    u32 image_count, buffer_count, sampler_count;
+    dm_pool images, buffers, samplers;
+    dm_pool pipes, rts;
+
+    dm_arena destroy_queue;
+    u32      destroy_count;
+
+    dm_vulkan_pipeline_table pipeline_table;
+
+    VkPipelineCache pipeline_cache;
 
-    dm_vulkan_pipeline      pipes[DM_MAX_PIPELINES];
-    dm_vulkan_render_target rts[DM_MAX_TEXTURES];
-    u32 pipe_count, rt_count;
+    dm_vulkan_shader_variants shader_variants;
+    dm_mutex                  shader_variant_lock;
+
+#ifndef DM_OFFLINE_SHADERS_ONLY
+    // one per job thread, see dm_job_get_thread_index. the lock guards slot 0 since any non-worker thread can use it
+    dm_vulkan_shader_compiler shader_compilers[DM_JOB_MAX_WORKERS + 1];
+    u32                       shader_compiler_count;
+    dm_mutex                  shader_compiler_lock;
+#endif
 
     dm_pipeline active_pipeline;
+
+    // set when the last bind had nothing ready to bind
+    bool skip_draws, skip_dispatches;
+
+    // copies can only be recorded into the frame's command buffer outside of a render pass
+    bool frame_active, rendering_active;
+
+    // dynamic state the device can't change is only warned about once
+    bool warned_dynamic_blend, warned_dynamic_topology;
+    bool warned_staging_fallback;
 } dm_vulkan_renderer;
 
 #ifdef DM_DEBUG
@@ -233,6 +464,7 @@ bool dm_vulkan_create_buffer(VmaAllocator allocator, VkBufferUsageFlags usage, V
     if(dm_vulkan_decode_vr(vmaCreateBuffer(allocator, &buffer_info, &alloc_info, buffer, allocation, NULL))) return true;
 
     LOG_ERROR("vmaCreateBuffer failed");
+    dm_mem_record_failed(alloc_usage == VMA_MEMORY_USAGE_GPU_ONLY ? DM_MEM_TAG_GPU_DEVICE : DM_MEM_TAG_GPU_HOST);
     return false;
 }
 
@@ -327,7 +559,7 @@ VkInstance dm_vulkan_create_instance()
 #endif
     };
 
-    if(!dm_vulkan_decode_vr(vkCreateInstance(&create_info, NULL, &instance))) return VK_NULL_HANDLE;
+    if(!dm_vulkan_decode_vr(vkCreateInstance(&create_info, DM_VULKAN_ALLOCATOR, &instance))) return VK_NULL_HANDLE;
     volkLoadInstance(instance);
 
     return instance;
@@ -463,6 +695,25 @@ u32 dm_vulkan_find_graphics_queue(VkPhysicalDevice physical, VkSurfaceKHR surfac
     return index;
 }
 
+// transfer only families are the dedicated copy engines
+u32 dm_vulkan_find_transfer_queue(VkPhysicalDevice physical, VkQueueFamilyProperties *props, u32 queue_count)
+{
+    u32 index = UINT32_MAX;
+
+    for(u32 i=0; i<queue_count; i++)
+    {
+        VkQueueFlags flags = props[i].queueFlags;
+
+        if(flags & VK_QUEUE_TRANSFER_BIT && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+        {
+            index = i;
+            break;
+        }
+    }
+
+    return index;
+}
+
 u32 dm_vulkan_find_compute_queue(VkPhysicalDevice physical, VkQueueFamilyProperties *props, u32 queue_count)
 {
     u32 index = UINT32_MAX;
@@ -481,7 +732,90 @@ u32 dm_vulkan_find_compute_queue(VkPhysicalDevice physical, VkQueueFamilyPropert
     return index;
 }
 
-VkDevice dm_vulkan_create_device(VkInstance instance, VkPhysicalDevice physical_device, VkSurfaceKHR surface, u32 gfx_index, u32 compute_index)
+bool dm_vulkan_has_device_extension(const VkExtensionProperties *props, u32 count, const char *name)
+{
+    for(u32 i=0; i<count; i++)
+    {
+        if(strcmp(props[i].extensionName, name) == 0) return true;
+    }
+
+    return false;
+}
+
+dm_vulkan_gpu_extensions dm_vulkan_query_extensions(VkPhysicalDevice physical_device)
+{
+    dm_vulkan_gpu_extensions extensions = { 0 };
+
+    u32 count = 0;
+    vkEnumerateDeviceExtensionProperties(physical_device, NULL, &count, NULL);
+    VkExtensionProperties *props = malloc(count * sizeof(VkExtensionProperties));
+    if(!props) return extensions;
+    vkEnumerateDeviceExtensionProperties(physical_device, NULL, &count, props);
+
+    bool has_pipeline_binary = dm_vulkan_has_device_extension(props, count, VK_KHR_PIPELINE_BINARY_EXTENSION_NAME);
+#ifdef DM_VULKAN_SHADER_OBJECT
+    bool has_shader_object = dm_vulkan_has_device_extension(props, count, VK_EXT_SHADER_OBJECT_EXTENSION_NAME);
+#else
+    bool has_shader_object = false;
+#endif
+    bool has_extended_dynamic_state3 = dm_vulkan_has_device_extension(props, count, VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+
+    free(props);
+
+    // an extension being there doesn't mean its feature is
+    VkPhysicalDeviceFeatures2 features2 = {
+        .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2
+    };
+    VkPhysicalDevicePipelineBinaryFeaturesKHR binary_features = {
+        .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PIPELINE_BINARY_FEATURES_KHR
+    };
+    VkPhysicalDeviceShaderObjectFeaturesEXT shader_object_features = {
+        .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_OBJECT_FEATURES_EXT
+    };
+    VkPhysicalDeviceExtendedDynamicState3FeaturesEXT eds3_features = {
+        .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT
+    };
+    if(has_pipeline_binary)
+    {
+        binary_features.pNext = features2.pNext;
+        features2.pNext = &binary_features;
+    }
+    if(has_shader_object)
+    {
+        shader_object_features.pNext = features2.pNext;
+        features2.pNext = &shader_object_features;
+    }
+    if(has_extended_dynamic_state3)
+    {
+        eds3_features.pNext = features2.pNext;
+        features2.pNext = &eds3_features;
+    }
+    vkGetPhysicalDeviceFeatures2(physical_device, &features2);
+
+    extensions.pipeline_binary         = binary_features.pipelineBinaries;
+    extensions.shader_object           = shader_object_features.shaderObject;
+    extensions.extended_dynamic_state3 = eds3_features.extendedDynamicState3ColorBlendEnable && eds3_features.extendedDynamicState3ColorBlendEquation;
+
+    // shader objects have no topology class to stick to
+    extensions.unrestricted_topology = extensions.shader_object;
+    if(extensions.extended_dynamic_state3)
+    {
+        VkPhysicalDeviceExtendedDynamicState3PropertiesEXT eds3_props = {
+            .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_PROPERTIES_EXT
+        };
+        VkPhysicalDeviceProperties2 props2 = {
+            .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+            .pNext=&eds3_props
+        };
+        vkGetPhysicalDeviceProperties2(physical_device, &props2);
+
+        if(eds3_props.dynamicPrimitiveTopologyUnrestricted) extensions.unrestricted_topology = true;
+    }
+
+    return extensions;
+}
+
+VkDevice dm_vulkan_create_device(VkInstance instance, VkPhysicalDevice physical_device, VkSurfaceKHR surface, u32 gfx_index, u32 compute_index, u32 transfer_index, dm_vulkan_gpu_extensions optional)
 {
     VkDevice device = VK_NULL_HANDLE;
 
@@ -501,8 +835,15 @@ VkDevice dm_vulkan_create_device(VkInstance instance, VkPhysicalDevice physical_
         .pQueuePriorities=priorities
     };
 
+    VkDeviceQueueCreateInfo transfer_info = {
+        .sType=VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+        .queueCount=1,
+        .queueFamilyIndex=transfer_index,
+        .pQueuePriorities=priorities
+    };
+
     VkDeviceQueueCreateInfo queues[] = {
-        gfx_info, compute_info
+        gfx_info, compute_info, transfer_info
     };
 
     // features
@@ -565,7 +906,37 @@ VkDevice dm_vulkan_create_device(VkInstance instance, VkPhysicalDevice physical_
         .features.shaderInt64=1
     };
 
-    const char* extensions[] = {
+    // optional features go in front of the chain
+    VkPhysicalDevicePipelineBinaryFeaturesKHR binary_features = {
+        .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PIPELINE_BINARY_FEATURES_KHR,
+        .pipelineBinaries=1
+    };
+    if(optional.pipeline_binary)
+    {
+        binary_features.pNext = features2.pNext;
+        features2.pNext = &binary_features;
+    }
+    VkPhysicalDeviceShaderObjectFeaturesEXT shader_object_features = {
+        .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_OBJECT_FEATURES_EXT,
+        .shaderObject=1
+    };
+    if(optional.shader_object)
+    {
+        shader_object_features.pNext = features2.pNext;
+        features2.pNext = &shader_object_features;
+    }
+    VkPhysicalDeviceExtendedDynamicState3FeaturesEXT eds3_features = {
+        .sType=VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT,
+        .extendedDynamicState3ColorBlendEnable=1,
+        .extendedDynamicState3ColorBlendEquation=1
+    };
+    if(optional.extended_dynamic_state3)
+    {
+        eds3_features.pNext = features2.pNext;
+        features2.pNext = &eds3_features;
+    }
+
+    const char* extensions[16] = {
         VK_KHR_SWAPCHAIN_EXTENSION_NAME,
         VK_KHR_SHADER_UNTYPED_POINTERS_EXTENSION_NAME,
         VK_KHR_MAINTENANCE_5_EXTENSION_NAME,
@@ -583,6 +954,10 @@ VkDevice dm_vulkan_create_device(VkInstance instance, VkPhysicalDevice physical_
     ext_count += 4;
 #endif // DM_RAY_TRACE
 
+    if(optional.pipeline_binary) extensions[ext_count++] = VK_KHR_PIPELINE_BINARY_EXTENSION_NAME;
+    if(optional.shader_object)   extensions[ext_count++] = VK_EXT_SHADER_OBJECT_EXTENSION_NAME;
+    if(optional.extended_dynamic_state3) extensions[ext_count++] = VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME;
+
 #ifdef DM_DEBUG
     VkExtensionProperties ext_props[500] = { 0 };
     u32 ext_prop_count;
@@ -616,14 +991,14 @@ VkDevice dm_vulkan_create_device(VkInstance instance, VkPhysicalDevice physical_
     //
     VkDeviceCreateInfo create_info = {
         .sType=VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-        .queueCreateInfoCount=2,
+        .queueCreateInfoCount=transfer_index != gfx_index ? 3 : 2,
         .pQueueCreateInfos=queues,
         .pNext=&features2,
         .enabledExtensionCount=ext_count,
         .ppEnabledExtensionNames=extensions
     };
 
-    if(dm_vulkan_decode_vr(vkCreateDevice(physical_device, &create_info, NULL, &device))) return device;
+    if(dm_vulkan_decode_vr(vkCreateDevice(physical_device, &create_info, DM_VULKAN_ALLOCATOR, &device))) return device;
 
     LOG_ERROR("vkCreateDevice failed");
     return VK_NULL_HANDLE;
@@ -663,13 +1038,21 @@ dm_vulkan_gpu dm_vulkan_create_gpu(VkInstance instance, dm_vulkan_surface surfac
     u32 compute_index = dm_vulkan_find_compute_queue(physical, props, queue_count);
     if(compute_index == UINT32_MAX) { LOG_ERROR("Could not find compute queue."); return gpu; }
 
-    VkDevice device = dm_vulkan_create_device(instance, physical, surface.surface, gfx_index, compute_index);
+    u32 transfer_index = dm_vulkan_find_transfer_queue(physical, props, queue_count);
+    if(transfer_index == UINT32_MAX) { LOG_WARN("No dedicated transfer queue, uploads go through the graphics queue"); transfer_index = gfx_index; }
+
+    dm_vulkan_gpu_extensions extensions = dm_vulkan_query_extensions(physical);
+
+    VkDevice device = dm_vulkan_create_device(instance, physical, surface.surface, gfx_index, compute_index, transfer_index, extensions);
     if(device == VK_NULL_HANDLE) { LOG_ERROR("Could not create device."); return gpu; }
 
     gpu.physical       = physical;
     gpu.device         = device;
     gpu.gfx_index      = gfx_index;
+    gpu.gfx_timestamp_bits = props[gfx_index].timestampValidBits;
     gpu.compute_index  = compute_index;
+    gpu.transfer_index = transfer_index;
+    gpu.extensions     = extensions;
 
     vkGetPhysicalDeviceFeatures(physical, &gpu.features);
     vkGetPhysicalDeviceProperties(physical, &gpu.properties);
@@ -677,24 +1060,124 @@ dm_vulkan_gpu dm_vulkan_create_gpu(VkInstance instance, dm_vulkan_surface surfac
     gpu.heap_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_HEAP_PROPERTIES_EXT;
     gpu.props2.sType     = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
     gpu.props2.pNext     = &gpu.heap_props;
+    if(extensions.pipeline_binary)
+    {
+        gpu.binary_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PIPELINE_BINARY_PROPERTIES_KHR;
+        gpu.heap_props.pNext   = &gpu.binary_props;
+    }
     vkGetPhysicalDeviceProperties2(physical, &gpu.props2);
 
+    LOG_INFO("VK_KHR_pipeline_binary: %s", extensions.pipeline_binary ? "yes" : "no");
+    LOG_INFO("VK_EXT_extended_dynamic_state3: %s", extensions.extended_dynamic_state3 ? "yes" : "no, blending is baked into pipelines");
+#ifdef DM_VULKAN_SHADER_OBJECT
+    LOG_INFO("VK_EXT_shader_object: %s", extensions.shader_object ? "yes" : "no, using pipelines");
+#endif
+
     return gpu;
 }
 
+#ifdef DM_ALLOC_GUARD
+// vulkan wants aligned allocations with realloc, so keep the original pointer and size in front
+typedef struct dm_vulkan_host_alloc_t
+{
+    void*  base;
+    size_t size;
+} dm_vulkan_host_alloc;
+
+void* VKAPI_PTR dm_vulkan_host_allocate(void *user_data, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    dm_alloc_guard_record_alloc();
+
+    if(alignment < sizeof(void*)) alignment = sizeof(void*);
+
+    // counted above, the interposed malloc would count it again
+    u8 *base = dm_alloc_guard_untracked_malloc(size + alignment + sizeof(dm_vulkan_host_alloc));
+    if(!base) return NULL;
+
+    u8 *ptr = (u8*)DM_ALIGN((uintptr_t)(base + sizeof(dm_vulkan_host_alloc)), (uintptr_t)alignment);
+    ((dm_vulkan_host_alloc*)ptr)[-1] = (dm_vulkan_host_alloc){ .base=base, .size=size };
+
+    return ptr;
+}
+
+void VKAPI_PTR dm_vulkan_host_free(void *user_data, void *memory)
+{
+    if(!memory) return;
+
+    dm_alloc_guard_untracked_free(((dm_vulkan_host_alloc*)memory)[-1].base);
+}
+
+void* VKAPI_PTR dm_vulkan_host_reallocate(void *user_data, void *original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    if(!original) return dm_vulkan_host_allocate(user_data, size, alignment, scope);
+    if(!size)
+    {
+        dm_vulkan_host_free(user_data, original);
+        return NULL;
+    }
+
+    void *memory = dm_vulkan_host_allocate(user_data, size, alignment, scope);
+    if(!memory) return NULL;
+
+    size_t old_size = ((dm_vulkan_host_alloc*)original)[-1].size;
+    memcpy(memory, original, old_size < size ? old_size : size);
+    dm_vulkan_host_free(user_data, original);
+
+    return memory;
+}
+
+VkAllocationCallbacks dm_vulkan_allocation_callbacks = {
+    .pfnAllocation=dm_vulkan_host_allocate,
+    .pfnReallocation=dm_vulkan_host_reallocate,
+    .pfnFree=dm_vulkan_host_free
+};
+#endif
+
+// vma reports every VkDeviceMemory block it allocates or frees, so gpu stats are per block not per resource
+dm_mem_tag dm_vulkan_get_memory_tag(VmaAllocator allocator, uint32_t memory_type)
+{
+    VkMemoryPropertyFlags flags;
+    vmaGetMemoryTypeProperties(allocator, memory_type, &flags);
+
+    return (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) ? DM_MEM_TAG_GPU_HOST : DM_MEM_TAG_GPU_DEVICE;
+}
+
+void VKAPI_PTR dm_vulkan_vma_allocate_callback(VmaAllocator allocator, uint32_t memory_type, VkDeviceMemory memory, VkDeviceSize size, void *user_data)
+{
+    dm_mem_tag tag = dm_vulkan_get_memory_tag(allocator, memory_type);
+
+    dm_mem_record_alloc(tag, size);
+    dm_mem_record_commit(tag, size);
+}
+
+void VKAPI_PTR dm_vulkan_vma_free_callback(VmaAllocator allocator, uint32_t memory_type, VkDeviceMemory memory, VkDeviceSize size, void *user_data)
+{
+    dm_mem_tag tag = dm_vulkan_get_memory_tag(allocator, memory_type);
+
+    dm_mem_record_free(tag, size);
+    dm_mem_record_decommit(tag, size);
+}
+
 VmaAllocator create_vma_allocator(VkInstance instance, VkPhysicalDevice physical_device, VkDevice device)
 {
     VmaAllocator allocator = VK_NULL_HANDLE;
 
     VmaVulkanFunctions functions = { 0 };
 
+    VmaDeviceMemoryCallbacks memory_callbacks = {
+        .pfnAllocate=dm_vulkan_vma_allocate_callback,
+        .pfnFree=dm_vulkan_vma_free_callback
+    };
+
     VmaAllocatorCreateInfo info = {
         .instance=instance,
         .physicalDevice=physical_device,
         .device=device,
         .flags=VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT,
         .vulkanApiVersion=VK_API_VERSION_1_4,
-        .pVulkanFunctions=&functions
+        .pVulkanFunctions=&functions,
+        .pDeviceMemoryCallbacks=&memory_callbacks,
+        .pAllocationCallbacks=DM_VULKAN_ALLOCATOR
     };
 
     if(!dm_vulkan_decode_vr(vmaImportVulkanFunctionsFromVolk(&info, &functions))) { LOG_ERROR("vmaImportVulkanFunctionsFromVolk failed"); return VK_NULL_HANDLE; }
@@ -724,7 +1207,7 @@ VkSwapchainKHR dm_vulkan_create_vk_swap(dm_vulkan_gpu gpu, dm_vulkan_surface sur
         .presentMode=VK_PRESENT_MODE_FIFO_KHR,
     };
 
-    if(!dm_vulkan_decode_vr(vkCreateSwapchainKHR(gpu.device, &info, NULL, &swapchain)))
+    if(!dm_vulkan_decode_vr(vkCreateSwapchainKHR(gpu.device, &info, DM_VULKAN_ALLOCATOR, &swapchain)))
     { 
         LOG_ERROR("vkCreateSwapchainKHR failed"); 
         return VK_NULL_HANDLE; 
@@ -760,7 +1243,7 @@ dm_vulkan_swapchain_image dm_vulkan_create_swapchain_image(VkDevice device, VkIm
         .subresourceRange.levelCount=1
     };
 
-    if(!dm_vulkan_decode_vr(vkCreateImageView(device, &info, NULL, &view)))
+    if(!dm_vulkan_decode_vr(vkCreateImageView(device, &info, DM_VULKAN_ALLOCATOR, &view)))
     {
         LOG_ERROR("vkCreateImageView failed");
         return image;
@@ -771,7 +1254,7 @@ dm_vulkan_swapchain_image dm_vulkan_create_swapchain_image(VkDevice device, VkIm
         .sType=VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
     };
 
-    if(!dm_vulkan_decode_vr(vkCreateSemaphore(device, &semaphore_info, NULL, &semaphore)))
+    if(!dm_vulkan_decode_vr(vkCreateSemaphore(device, &semaphore_info, DM_VULKAN_ALLOCATOR, &semaphore)))
     {
         LOG_ERROR("vkCreateSemaphore failed");
         return image;
@@ -815,6 +1298,7 @@ dm_vulkan_depth_image dm_vulkan_create_depth_image(dm_vulkan_gpu gpu, VmaAllocat
     if(!dm_vulkan_decode_vr(vmaCreateImage(allocator, &info, &alloc_info, &vk_image, &vk_alloc, NULL)))
     {
         LOG_ERROR("vmaCreateImage failed");
+        dm_mem_record_failed(DM_MEM_TAG_GPU_DEVICE);
         return image;
     }
 
@@ -828,7 +1312,7 @@ dm_vulkan_depth_image dm_vulkan_create_depth_image(dm_vulkan_gpu gpu, VmaAllocat
         .subresourceRange.levelCount=1
     };
 
-    if(!dm_vulkan_decode_vr(vkCreateImageView(gpu.device, &depth_view_info, NULL, &vk_view)))
+    if(!dm_vulkan_decode_vr(vkCreateImageView(gpu.device, &depth_view_info, DM_VULKAN_ALLOCATOR, &vk_view)))
     {
         LOG_ERROR("vkCreateImageView failed");
         return image;
@@ -903,14 +1387,14 @@ void dm_vulkan_destroy_swapchain(dm_vulkan_swapchain* swapchain, dm_vulkan_gpu g
 
     for(u32 i=0; i<swapchain->count; i++)
     {
-        vkDestroyImageView(gpu.device, swapchain->images[i].view, NULL);
-        vkDestroySemaphore(gpu.device, swapchain->images[i].semaphore, NULL);
+        vkDestroyImageView(gpu.device, swapchain->images[i].view, DM_VULKAN_ALLOCATOR);
+        vkDestroySemaphore(gpu.device, swapchain->images[i].semaphore, DM_VULKAN_ALLOCATOR);
     }
 
-    vkDestroySwapchainKHR(gpu.device, swapchain->swapchain, NULL);
+    vkDestroySwapchainKHR(gpu.device, swapchain->swapchain, DM_VULKAN_ALLOCATOR);
 
     dm_vulkan_depth_image depth_image = swapchain->depth_image;
-    vkDestroyImageView(gpu.device, depth_image.view, NULL);
+    vkDestroyImageView(gpu.device, depth_image.view, DM_VULKAN_ALLOCATOR);
     vmaDestroyImage(allocator, depth_image.image, depth_image.allocation);
 }
 
@@ -927,7 +1411,7 @@ dm_vulkan_frame_data dm_vulkan_create_frame_data(dm_vulkan_gpu gpu)
         .queueFamilyIndex=gpu.gfx_index
     };
 
-    if(vkCreateCommandPool(gpu.device, &pool_info, NULL, &pool) != VK_SUCCESS)
+    if(vkCreateCommandPool(gpu.device, &pool_info, DM_VULKAN_ALLOCATOR, &pool) != VK_SUCCESS)
     {
         LOG_ERROR("vkCreateCommandPool");
         return data;
@@ -950,7 +1434,7 @@ dm_vulkan_frame_data dm_vulkan_create_frame_data(dm_vulkan_gpu gpu)
         .sType=VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
     };
 
-    if(!dm_vulkan_decode_vr(vkCreateSemaphore(gpu.device, &semaphore_info, NULL, &semaphore)))
+    if(!dm_vulkan_decode_vr(vkCreateSemaphore(gpu.device, &semaphore_info, DM_VULKAN_ALLOCATOR, &semaphore)))
     {
         LOG_ERROR("vkCreateSemaphore failed");
         return data;
@@ -970,10 +1454,11 @@ VkCommandPool dm_vulkan_create_single_use_pool(dm_vulkan_gpu gpu)
 
     VkCommandPoolCreateInfo info = {
         .sType=VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags=VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
         .queueFamilyIndex=gpu.gfx_index
     };
 
-    if(!dm_vulkan_decode_vr(vkCreateCommandPool(gpu.device, &info, NULL, &pool)))
+    if(!dm_vulkan_decode_vr(vkCreateCommandPool(gpu.device, &info, DM_VULKAN_ALLOCATOR, &pool)))
     {
         LOG_ERROR("vkCreateCommandPool");
         return VK_NULL_HANDLE;
@@ -982,6 +1467,21 @@ VkCommandPool dm_vulkan_create_single_use_pool(dm_vulkan_gpu gpu)
     return pool;
 }
 
+dm_vulkan_staging_ring dm_vulkan_create_staging_ring(VmaAllocator allocator)
+{
+    dm_vulkan_staging_ring ring = { 0 };
+
+    VmaAllocationCreateFlags flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    if(!dm_vulkan_create_buffer(allocator, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, flags, VMA_MEMORY_USAGE_AUTO, &ring.buffer, &ring.allocation, DM_VULKAN_STAGING_FRAME_SIZE * DM_FRAMES_IN_FLIGHT)) return ring;
+
+    VmaAllocationInfo info;
+    vmaGetAllocationInfo(allocator, ring.allocation, &info);
+    ring.mapped = info.pMappedData;
+
+    return ring;
+}
+
 VkSemaphore dm_vulkan_create_timeline_semaphore(dm_vulkan_gpu gpu, u64 value)
 {
     VkSemaphore semaphore = VK_NULL_HANDLE;
@@ -995,7 +1495,7 @@ VkSemaphore dm_vulkan_create_timeline_semaphore(dm_vulkan_gpu gpu, u64 value)
         .sType=VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
         .pNext=&type_info
     };
-    if(!dm_vulkan_decode_vr(vkCreateSemaphore(gpu.device, &info, NULL, &semaphore)))
+    if(!dm_vulkan_decode_vr(vkCreateSemaphore(gpu.device, &info, DM_VULKAN_ALLOCATOR, &semaphore)))
     {
         LOG_ERROR("vkCreateSemaphore failed");
         return VK_NULL_HANDLE;
@@ -1004,97 +1504,2224 @@ VkSemaphore dm_vulkan_create_timeline_semaphore(dm_vulkan_gpu gpu, u64 value)
     return semaphore;
 }
 
-dm_vulkan_resource_descriptor_heap dm_vulkan_create_resource_heap(VkDevice device, VmaAllocator allocator, VkPhysicalDeviceDescriptorHeapPropertiesEXT heap_props)
+// the single use command buffer is allocated once and recycled by resetting its pool,
+// submission waits for the queue so it is never in flight when reused
+VkCommandBuffer dm_vulkan_allocate_one_time_cmd(VkDevice device, VkCommandPool pool)
 {
-    dm_vulkan_resource_descriptor_heap heap = { 0 };
-
-    VkBuffer buffer = VK_NULL_HANDLE;
-    VmaAllocation allocation = VK_NULL_HANDLE;
-    void *start = NULL;
+    VkCommandBuffer cmd = VK_NULL_HANDLE;
 
-    size_t size = 0;
-    size_t buffer_size, image_offset, image_size;
+    VkCommandBufferAllocateInfo cmd_alloc = {
+        .sType=VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandBufferCount=1,
+        .commandPool=pool,
+        .level=VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+    };
+    if(!dm_vulkan_decode_vr(vkAllocateCommandBuffers(device, &cmd_alloc, &cmd)))
+    {
+        LOG_ERROR("vkAllocateCommandBuffers failed");
+        return VK_NULL_HANDLE;
+    }
 
-    buffer_size = DM_ALIGN(heap_props.bufferDescriptorSize, heap_props.bufferDescriptorAlignment);
-    image_offset = DM_ALIGN((buffer_size * DM_MAX_BUFFERS), heap_props.imageDescriptorSize);
-    image_size = DM_ALIGN(heap_props.imageDescriptorSize, heap_props.imageDescriptorAlignment);
-    LOG_DEBUG("Buffer descriptor size: %zu", buffer_size);
-    LOG_DEBUG("Buffer descriptor heap alignment: %zu", heap_props.bufferDescriptorAlignment);
-    LOG_DEBUG("Image descriptor size: %zu", image_size);
-    LOG_DEBUG("Image descriptor heap alignment: %zu", heap_props.imageDescriptorAlignment);
-    LOG_DEBUG("Image offset: %zu", image_offset);
-    LOG_DEBUG("Heap max push data size: %zu", heap_props.maxPushDataSize);
+    return cmd;
+}
 
-    size += image_offset;
-    size += DM_MAX_TEXTURES * image_size;
-    size += heap_props.minResourceHeapReservedRange;
-    size = DM_ALIGN(size, heap_props.resourceHeapAlignment);
+VkCommandBuffer dm_vulkan_one_time_cmd(VkDevice device, VkCommandPool pool, VkCommandBuffer cmd)
+{
+    vkResetCommandPool(device, pool, 0);
 
-    VkBufferUsageFlags usage = VK_BUFFER_USAGE_DESCRIPTOR_HEAP_BIT_EXT;
-    usage |= VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
-    usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    VkCommandBufferBeginInfo begin_info = {
+        .sType=VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags=VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+    };
+    vkBeginCommandBuffer(cmd, &begin_info);
 
-    if(!dm_vulkan_create_buffer(allocator, usage, VMA_ALLOCATION_CREATE_MAPPED_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, &buffer, &allocation, size)) return heap;
+    return cmd;
+}
 
-    if(!dm_vulkan_decode_vr(vmaMapMemory(allocator, allocation, &start)))
-    {
-        LOG_ERROR("vmaMapMemory failed");
-        return heap;
+void dm_vulkan_submit_one_time_cmd(VkQueue queue, VkCommandBuffer cmd)
+{
+    VkSubmitInfo submit_info = {
+        .sType=VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount=1,
+        .pCommandBuffers=&cmd
+    };
+
+    vkEndCommandBuffer(cmd);
+    vkQueueSubmit(queue, 1, &submit_info, NULL);
+    vkQueueWaitIdle(queue);
+}
+
+/****************
+ * UPLOAD ENGINE
+ ****************/
+bool dm_vulkan_create_upload_engine(dm_vulkan_gpu gpu, dm_vulkan_upload_engine *engine)
+{
+    engine->queue  = gpu.transfer_queue;
+    engine->family = gpu.transfer_index;
+
+    for(u32 i=0; i<DM_VULKAN_UPLOAD_BATCHES; i++)
+    {
+        VkCommandPoolCreateInfo pool_info = {
+            .sType=VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .flags=VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+            .queueFamilyIndex=engine->family
+        };
+
+        if(!dm_vulkan_decode_vr(vkCreateCommandPool(gpu.device, &pool_info, DM_VULKAN_ALLOCATOR, &engine->batches[i].pool)))
+        {
+            LOG_ERROR("vkCreateCommandPool failed");
+            return false;
+        }
+
+        engine->batches[i].cmd = dm_vulkan_allocate_one_time_cmd(gpu.device, engine->batches[i].pool);
+        if(engine->batches[i].cmd == VK_NULL_HANDLE) return false;
+    }
+
+    engine->semaphore = dm_vulkan_create_timeline_semaphore(gpu, 0);
+
+    return engine->semaphore != VK_NULL_HANDLE;
+}
+
+void dm_vulkan_destroy_upload_engine(VkDevice device, dm_vulkan_upload_engine *engine)
+{
+    for(u32 i=0; i<DM_VULKAN_UPLOAD_BATCHES; i++)
+    {
+        vkDestroyCommandPool(device, engine->batches[i].pool, DM_VULKAN_ALLOCATOR);
+    }
+
+    vkDestroySemaphore(device, engine->semaphore, DM_VULKAN_ALLOCATOR);
+}
+
+bool dm_vulkan_upload_owned(dm_vulkan_renderer *renderer)
+{
+    return renderer->upload.family != renderer->gpu.gfx_index;
+}
+
+// returns the open batch, starting one if needed
+VkCommandBuffer dm_vulkan_upload_begin(dm_vulkan_renderer *renderer)
+{
+    dm_vulkan_upload_engine *engine = &renderer->upload;
+    dm_vulkan_upload_batch  *batch  = &engine->batches[engine->batch_index];
+
+    if(engine->recording) return batch->cmd;
+
+    // the batch that last used this slot has to be done before its pool is reset
+    VkSemaphoreWaitInfo wait_info = {
+        .sType=VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount=1,
+        .pSemaphores=&engine->semaphore,
+        .pValues=&batch->value
+    };
+    vkWaitSemaphores(renderer->gpu.device, &wait_info, UINT64_MAX);
+
+    engine->recording = true;
+
+    return dm_vulkan_one_time_cmd(renderer->gpu.device, batch->pool, batch->cmd);
+}
+
+// submits the open batch, nothing waits on the cpu
+void dm_vulkan_upload_flush(dm_vulkan_renderer *renderer)
+{
+    dm_vulkan_upload_engine *engine = &renderer->upload;
+    if(!engine->recording) return;
+
+    dm_vulkan_upload_batch *batch = &engine->batches[engine->batch_index];
+    batch->value = ++engine->value;
+
+    vkEndCommandBuffer(batch->cmd);
+
+    // the last submitted frame, the current one waits on this batch instead
+    VkSemaphoreSubmitInfo wait_info = {
+        .sType=VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .semaphore=renderer->timeline_semaphore,
+        .stageMask=VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .value=renderer->frame_active ? renderer->timeline_value - 1 : renderer->timeline_value
+    };
+
+    VkSemaphoreSubmitInfo signal_info = {
+        .sType=VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .semaphore=engine->semaphore,
+        .stageMask=VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .value=batch->value
+    };
+
+    VkCommandBufferSubmitInfo cmd_info = {
+        .sType=VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+        .commandBuffer=batch->cmd
+    };
+
+    VkSubmitInfo2 submit = {
+        .sType=VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+        .waitSemaphoreInfoCount=engine->wait_frames ? 1 : 0,
+        .pWaitSemaphoreInfos=&wait_info,
+        .commandBufferInfoCount=1,
+        .pCommandBufferInfos=&cmd_info,
+        .signalSemaphoreInfoCount=1,
+        .pSignalSemaphoreInfos=&signal_info
+    };
+    vkQueueSubmit2(engine->queue, 1, &submit, NULL);
+
+    engine->batch_index = (engine->batch_index + 1) % DM_VULKAN_UPLOAD_BATCHES;
+    engine->recording   = false;
+    engine->wait_frames = false;
+}
+
+// blocks until the batch signalling value is done, submitting it first if it is still open
+void dm_vulkan_upload_wait(dm_vulkan_renderer *renderer, u64 value)
+{
+    dm_vulkan_upload_engine *engine = &renderer->upload;
+
+    if(value > engine->value) dm_vulkan_upload_flush(renderer);
+
+    VkSemaphoreWaitInfo wait_info = {
+        .sType=VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount=1,
+        .pSemaphores=&engine->semaphore,
+        .pValues=&value
+    };
+    vkWaitSemaphores(renderer->gpu.device, &wait_info, UINT64_MAX);
+}
+
+// cmd has to run after the batches releasing the pending resources, either because its submission
+// waits on the upload timeline or because they are already done
+void dm_vulkan_upload_acquire(dm_vulkan_renderer *renderer, VkCommandBuffer cmd)
+{
+    dm_vulkan_upload_engine *engine = &renderer->upload;
+    if(!engine->buffer_acquire_count && !engine->image_acquire_count) return;
+
+    VkDependencyInfo dep_info = {
+        .sType=VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .bufferMemoryBarrierCount=engine->buffer_acquire_count,
+        .pBufferMemoryBarriers=engine->buffer_acquires,
+        .imageMemoryBarrierCount=engine->image_acquire_count,
+        .pImageMemoryBarriers=engine->image_acquires
+    };
+    vkCmdPipelineBarrier2(cmd, &dep_info);
+
+    engine->buffer_acquire_count = 0;
+    engine->image_acquire_count  = 0;
+}
+
+// blocking, for work on the graphics queue outside of the frame that may use uploaded resources
+void dm_vulkan_upload_finish(dm_vulkan_renderer *renderer, VkCommandBuffer cmd)
+{
+    dm_vulkan_upload_flush(renderer);
+    dm_vulkan_upload_wait(renderer, renderer->upload.value);
+    dm_vulkan_upload_acquire(renderer, cmd);
+}
+
+// destroyed resources can't be left in the acquire lists
+void dm_vulkan_upload_forget(dm_vulkan_renderer *renderer, VkBuffer buffer, VkImage image)
+{
+    dm_vulkan_upload_engine *engine = &renderer->upload;
+
+    for(u32 i=0; i<engine->buffer_acquire_count; i++)
+    {
+        if(!buffer || engine->buffer_acquires[i].buffer != buffer) continue;
+        engine->buffer_acquires[i--] = engine->buffer_acquires[--engine->buffer_acquire_count];
+    }
+
+    for(u32 i=0; i<engine->image_acquire_count; i++)
+    {
+        if(!image || engine->image_acquires[i].image != image) continue;
+        engine->image_acquires[i--] = engine->image_acquires[--engine->image_acquire_count];
+    }
+}
+
+// uploads inside a render pass can't be acquired by the frame so they stay blocking on the graphics queue
+VkCommandBuffer dm_vulkan_upload_cmd(dm_vulkan_renderer *renderer, bool blocking)
+{
+    dm_vulkan_upload_engine *engine = &renderer->upload;
+
+    if(blocking)
+    {
+        VkCommandBuffer cmd = dm_vulkan_one_time_cmd(renderer->gpu.device, renderer->single_use_pool, renderer->single_use_cmd);
+        dm_vulkan_upload_finish(renderer, cmd);
+
+        return cmd;
+    }
+
+    if(engine->buffer_acquire_count == DM_VULKAN_UPLOAD_MAX_ACQUIRES || engine->image_acquire_count == DM_VULKAN_UPLOAD_MAX_ACQUIRES)
+    {
+        VkCommandBuffer cmd = dm_vulkan_one_time_cmd(renderer->gpu.device, renderer->single_use_pool, renderer->single_use_cmd);
+        dm_vulkan_upload_finish(renderer, cmd);
+        dm_vulkan_submit_one_time_cmd(renderer->gpu.gfx_queue, cmd);
+    }
+
+    return dm_vulkan_upload_begin(renderer);
+}
+
+// barriers come in as if everything ran on one queue and are split into a release and an acquire if needed
+void dm_vulkan_upload_release(dm_vulkan_renderer *renderer, VkCommandBuffer cmd, VkBufferMemoryBarrier2 *buffer_barrier, VkImageMemoryBarrier2 *image_barrier, bool blocking)
+{
+    dm_vulkan_upload_engine *engine = &renderer->upload;
+
+    if(!blocking && dm_vulkan_upload_owned(renderer))
+    {
+        if(buffer_barrier)
+        {
+            buffer_barrier->srcQueueFamilyIndex = engine->family;
+            buffer_barrier->dstQueueFamilyIndex = renderer->gpu.gfx_index;
+
+            VkBufferMemoryBarrier2 *acquire = &engine->buffer_acquires[engine->buffer_acquire_count++];
+            *acquire = *buffer_barrier;
+            acquire->srcStageMask  = VK_PIPELINE_STAGE_2_NONE;
+            acquire->srcAccessMask = VK_ACCESS_2_NONE;
+
+            buffer_barrier->dstStageMask  = VK_PIPELINE_STAGE_2_NONE;
+            buffer_barrier->dstAccessMask = VK_ACCESS_2_NONE;
+        }
+
+        if(image_barrier)
+        {
+            image_barrier->srcQueueFamilyIndex = engine->family;
+            image_barrier->dstQueueFamilyIndex = renderer->gpu.gfx_index;
+
+            VkImageMemoryBarrier2 *acquire = &engine->image_acquires[engine->image_acquire_count++];
+            *acquire = *image_barrier;
+            acquire->srcStageMask  = VK_PIPELINE_STAGE_2_NONE;
+            acquire->srcAccessMask = VK_ACCESS_2_NONE;
+
+            image_barrier->dstStageMask  = VK_PIPELINE_STAGE_2_NONE;
+            image_barrier->dstAccessMask = VK_ACCESS_2_NONE;
+        }
+    }
+
+    VkDependencyInfo dep_info = {
+        .sType=VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .bufferMemoryBarrierCount=buffer_barrier ? 1 : 0,
+        .pBufferMemoryBarriers=buffer_barrier,
+        .imageMemoryBarrierCount=image_barrier ? 1 : 0,
+        .pImageMemoryBarriers=image_barrier
+    };
+    vkCmdPipelineBarrier2(cmd, &dep_info);
+
+    if(blocking)
+    {
+        dm_vulkan_submit_one_time_cmd(renderer->gpu.gfx_queue, cmd);
+        return;
+    }
+
+    // the frame's submission waits on this batch so it can acquire right away
+    if(renderer->frame_active) dm_vulkan_upload_acquire(renderer, renderer->frame_data[renderer->frame_index].gfx_cmd);
+}
+
+// expects the data to already be in the host buffer
+void dm_vulkan_upload_buffer(dm_vulkan_renderer *renderer, dm_vulkan_buffer *buffer, size_t size)
+{
+    bool blocking = renderer->rendering_active;
+
+    VkCommandBuffer cmd = dm_vulkan_upload_cmd(renderer, blocking);
+
+    VkBufferCopy2 region_info = {
+        .sType=VK_STRUCTURE_TYPE_BUFFER_COPY_2,
+        .size=size
+    };
+
+    VkCopyBufferInfo2 copy_info = {
+        .sType=VK_STRUCTURE_TYPE_COPY_BUFFER_INFO_2,
+        .srcBuffer=buffer->host,
+        .dstBuffer=buffer->device,
+        .regionCount=1,
+        .pRegions=&region_info
+    };
+
+    vkCmdCopyBuffer2(cmd, &copy_info);
+
+    VkBufferMemoryBarrier2 barrier = {
+        .sType=VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+        .srcStageMask=VK_PIPELINE_STAGE_2_COPY_BIT,
+        .srcAccessMask=VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask=VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .dstAccessMask=VK_ACCESS_2_MEMORY_READ_BIT,
+        .srcQueueFamilyIndex=VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex=VK_QUEUE_FAMILY_IGNORED,
+        .buffer=buffer->device,
+        .size=VK_WHOLE_SIZE
+    };
+
+    if(!blocking) buffer->upload_value = renderer->upload.value + 1;
+
+    dm_vulkan_upload_release(renderer, cmd, &barrier, NULL, blocking);
+}
+
+// expects the data to already be in the staging buffer, the old contents are discarded
+void dm_vulkan_upload_image(dm_vulkan_renderer *renderer, dm_vulkan_image *image, u16 width, u16 height, bool overwrite)
+{
+    bool blocking = renderer->rendering_active;
+
+    VkCommandBuffer cmd = dm_vulkan_upload_cmd(renderer, blocking);
+
+    // transition image to transfer dst
+    VkImageMemoryBarrier2 dst_barrier = {
+        .sType=VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .srcStageMask=VK_PIPELINE_STAGE_2_NONE,
+        .srcAccessMask=VK_ACCESS_2_NONE,
+        .dstStageMask=VK_PIPELINE_STAGE_2_COPY_BIT,
+        .dstAccessMask=VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .oldLayout=VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout=VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex=VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex=VK_QUEUE_FAMILY_IGNORED,
+        .image=image->image,
+        .subresourceRange.aspectMask=VK_IMAGE_ASPECT_COLOR_BIT,
+        .subresourceRange.layerCount=1,
+        .subresourceRange.levelCount=1
+    };
+    VkDependencyInfo dst_dep = {
+        .sType=VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .imageMemoryBarrierCount=1,
+        .pImageMemoryBarriers=&dst_barrier
+    };
+    vkCmdPipelineBarrier2(cmd, &dst_dep);
+
+    // copy from buffer to texture
+    VkBufferImageCopy image_copy = {
+        .imageSubresource.aspectMask=VK_IMAGE_ASPECT_COLOR_BIT,
+        .imageSubresource.layerCount=1,
+        .imageExtent.width=width,
+        .imageExtent.height=height,
+        .imageExtent.depth=1
+    };
+
+    vkCmdCopyBufferToImage(cmd, image->staging.host, image->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &image_copy);
+
+    // transition to read/sample
+    VkImageMemoryBarrier2 post_barrier = {
+        .sType=VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .srcStageMask=VK_PIPELINE_STAGE_2_COPY_BIT,
+        .srcAccessMask=VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask=VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT,
+        .dstAccessMask=VK_ACCESS_2_SHADER_READ_BIT,
+        .oldLayout=VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .newLayout=VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .srcQueueFamilyIndex=VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex=VK_QUEUE_FAMILY_IGNORED,
+        .image=image->image,
+        .subresourceRange.aspectMask=VK_IMAGE_ASPECT_COLOR_BIT,
+        .subresourceRange.layerCount=1,
+        .subresourceRange.levelCount=1
+    };
+
+    if(!blocking)
+    {
+        image->staging.upload_value = renderer->upload.value + 1;
+        if(overwrite) renderer->upload.wait_frames = true;
+    }
+
+    dm_vulkan_upload_release(renderer, cmd, NULL, &post_barrier, blocking);
+}
+
+
+dm_vulkan_resource_descriptor_heap dm_vulkan_create_resource_heap(VkDevice device, VmaAllocator allocator, VkPhysicalDeviceDescriptorHeapPropertiesEXT heap_props, dm_renderer_limits limits, dm_arena *arena)
+{
+    dm_vulkan_resource_descriptor_heap heap = { 0 };
+
+    size_t max_buffers = (size_t)limits.buffers * DM_FRAMES_IN_FLIGHT;
+    size_t max_images  = limits.textures;
+
+    u32 *free_buffers = dm_arena_alloc(arena, sizeof(u32) * max_buffers, NULL);
+    u32 *free_images  = dm_arena_alloc(arena, sizeof(u32) * max_images, NULL);
+    if(!free_buffers || !free_images) return heap;
+
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VmaAllocation allocation = VK_NULL_HANDLE;
+    void *start = NULL;
+
+    size_t size = 0;
+    size_t buffer_size, image_offset, image_size;
+
+    buffer_size = DM_ALIGN(heap_props.bufferDescriptorSize, heap_props.bufferDescriptorAlignment);
+    image_offset = DM_ALIGN((buffer_size * max_buffers), heap_props.imageDescriptorSize);
+    image_size = DM_ALIGN(heap_props.imageDescriptorSize, heap_props.imageDescriptorAlignment);
+    LOG_DEBUG("Buffer descriptor size: %zu", buffer_size);
+    LOG_DEBUG("Buffer descriptor heap alignment: %zu", heap_props.bufferDescriptorAlignment);
+    LOG_DEBUG("Image descriptor size: %zu", image_size);
+    LOG_DEBUG("Image descriptor heap alignment: %zu", heap_props.imageDescriptorAlignment);
+    LOG_DEBUG("Image offset: %zu", image_offset);
+    LOG_DEBUG("Heap max push data size: %zu", heap_props.maxPushDataSize);
+
+    size += image_offset;
+    size += max_images * image_size;
+    size += heap_props.minResourceHeapReservedRange;
+    size = DM_ALIGN(size, heap_props.resourceHeapAlignment);
+
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_DESCRIPTOR_HEAP_BIT_EXT;
+    usage |= VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+    usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+    if(!dm_vulkan_create_buffer(allocator, usage, VMA_ALLOCATION_CREATE_MAPPED_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, &buffer, &allocation, size)) return heap;
+
+    if(!dm_vulkan_decode_vr(vmaMapMemory(allocator, allocation, &start)))
+    {
+        LOG_ERROR("vmaMapMemory failed");
+        return heap;
+    }
+
+    //
+    heap.buffer       = buffer;
+    heap.allocation   = allocation;
+    heap.start        = start;
+    heap.size         = size;
+    heap.buffer_size  = buffer_size;
+    heap.image_size   = image_size;
+    heap.image_offset = image_offset;
+    heap.max_buffers  = max_buffers;
+    heap.max_images   = max_images;
+    heap.free_buffers = free_buffers;
+    heap.free_images  = free_images;
+
+    return heap;
+}
+
+dm_vulkan_sampler_descriptor_heap dm_vulkan_create_sampler_descriptor_heap(VkDevice device, VmaAllocator allocator, VkPhysicalDeviceDescriptorHeapPropertiesEXT heap_props, dm_renderer_limits limits, dm_arena *arena)
+{
+    dm_vulkan_sampler_descriptor_heap heap = { 0 };
+
+    u32 *free_samplers = dm_arena_alloc(arena, sizeof(u32) * limits.samplers, NULL);
+    if(!free_samplers) return heap;
+
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VmaAllocation allocation = VK_NULL_HANDLE;
+    void *start = NULL;
+
+    size_t size = 0;
+    size_t sampler_size;
+
+    sampler_size = DM_ALIGN(heap_props.samplerDescriptorSize, heap_props.samplerDescriptorAlignment);
+
+    size += sampler_size * limits.samplers;
+    size += heap_props.minSamplerHeapReservedRange;
+    size = DM_ALIGN(size, heap_props.samplerHeapAlignment);
+    LOG_DEBUG("Sampler descriptor size: %u", sampler_size);
+    LOG_DEBUG("Sampler descriptor heap alignment: %u", heap_props.samplerHeapAlignment);
+
+    assert(size);
+
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_DESCRIPTOR_HEAP_BIT_EXT;
+    usage |= VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+    usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+    if(!dm_vulkan_create_buffer(allocator, usage, VMA_ALLOCATION_CREATE_MAPPED_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, &buffer, &allocation, size)) return heap;
+
+    if(!dm_vulkan_decode_vr(vmaMapMemory(allocator, allocation, &start)))
+    {
+        LOG_ERROR("vmaMapMemory failed");
+        return heap;
+    }
+
+    //
+    heap.buffer       = buffer;
+    heap.allocation   = allocation;
+    heap.start        = start;
+    heap.size          = size;
+    heap.sampler_size  = sampler_size;
+    heap.max_samplers  = limits.samplers;
+    heap.free_samplers = free_samplers;
+
+    return heap;
+}
+
+bool dm_vulkan_create_resource_pools(dm_vulkan_renderer *renderer, dm_renderer_limits limits)
+{
+    if(!dm_pool_create(&renderer->images, sizeof(dm_vulkan_image), limits.textures))                { LOG_ERROR("Could not create image pool"); return false; }
+    if(!dm_pool_create(&renderer->buffers, sizeof(dm_vulkan_buffer), limits.buffers))               { LOG_ERROR("Could not create buffer pool"); return false; }
+    if(!dm_pool_create(&renderer->samplers, sizeof(dm_vulkan_sampler), limits.samplers))            { LOG_ERROR("Could not create sampler pool"); return false; }
+    if(!dm_pool_create(&renderer->pipes, sizeof(dm_vulkan_pipeline), DM_MAX_PIPELINES))             { LOG_ERROR("Could not create pipeline pool"); return false; }
+    if(!dm_pool_create(&renderer->rts, sizeof(dm_vulkan_render_target), limits.textures))           { LOG_ERROR("Could not create render target pool"); return false; }
+    if(!dm_arena_create_ex(&renderer->destroy_queue, DM_VULKAN_DEFERRED_DESTROY_STRIDE * DM_DEFAULT_MAX_RESOURCES, DM_ARENA_DEFAULT_RESERVE, 0, DM_MEM_TAG_RENDERER)) { LOG_ERROR("Could not create destroy queue"); return false; }
+
+    return true;
+}
+
+void dm_vulkan_destroy_deferred(dm_vulkan_renderer *renderer, dm_vulkan_deferred_destroy *entry)
+{
+    dm_vulkan_resource_descriptor_heap *resource_heap = &renderer->resource_heap;
+    dm_vulkan_sampler_descriptor_heap  *sampler_heap  = &renderer->sampler_heap;
+
+    if(entry->pipeline) vkDestroyPipeline(renderer->gpu.device, entry->pipeline, DM_VULKAN_ALLOCATOR);
+    for(u8 i=0; i<DM_RASTER_SHADER_STAGE_MAX; i++)
+    {
+        if(entry->shaders[i]) vkDestroyShaderEXT(renderer->gpu.device, entry->shaders[i], DM_VULKAN_ALLOCATOR);
+    }
+    for(u8 i=0; i<2; i++)
+    {
+        if(entry->buffers[i]) vmaDestroyBuffer(renderer->allocator, entry->buffers[i], entry->buffer_allocs[i]);
+    }
+    if(entry->image) vmaDestroyImage(renderer->allocator, entry->image, entry->image_alloc);
+
+    if(entry->buffer_heap_slot != DM_VULKAN_INVALID_HEAP_INDEX)  resource_heap->free_buffers[resource_heap->free_buffer_count++] = entry->buffer_heap_slot;
+    if(entry->image_heap_slot != DM_VULKAN_INVALID_HEAP_INDEX)   resource_heap->free_images[resource_heap->free_image_count++]   = entry->image_heap_slot;
+    if(entry->sampler_heap_slot != DM_VULKAN_INVALID_HEAP_INDEX) sampler_heap->free_samplers[sampler_heap->free_sampler_count++] = entry->sampler_heap_slot;
+}
+
+void dm_vulkan_defer_destroy(dm_vulkan_renderer *renderer, dm_vulkan_deferred_destroy entry)
+{
+    // whatever frame is being (or was last) recorded may still reference the object.
+    // between frames the next one has to finish too, it is the first to wait on uploads recorded now
+    entry.timeline_value = renderer->frame_active ? renderer->timeline_value : renderer->timeline_value + 1;
+
+    dm_vulkan_deferred_destroy *slot = dm_arena_alloc(&renderer->destroy_queue, DM_VULKAN_DEFERRED_DESTROY_STRIDE, NULL);
+    if(!slot)
+    {
+        LOG_WARN("Destroy queue is full, waiting for device idle");
+        vkDeviceWaitIdle(renderer->gpu.device);
+        dm_vulkan_destroy_deferred(renderer, &entry);
+        return;
+    }
+
+    *slot = entry;
+    renderer->destroy_count++;
+}
+
+// destroys everything the gpu is done with and compacts the rest to the front of the queue
+void dm_vulkan_flush_destroy_queue(dm_vulkan_renderer *renderer, u64 completed_value)
+{
+    u8 *start = renderer->destroy_queue.start;
+    u32 kept  = 0;
+
+    for(u32 i=0; i<renderer->destroy_count; i++)
+    {
+        dm_vulkan_deferred_destroy *entry = (dm_vulkan_deferred_destroy*)(start + i * DM_VULKAN_DEFERRED_DESTROY_STRIDE);
+
+        if(entry->timeline_value <= completed_value)
+        {
+            dm_vulkan_destroy_deferred(renderer, entry);
+            continue;
+        }
+
+        if(kept != i) memcpy(start + kept * DM_VULKAN_DEFERRED_DESTROY_STRIDE, entry, sizeof(dm_vulkan_deferred_destroy));
+        kept++;
+    }
+
+    renderer->destroy_count = kept;
+    dm_arena_reset_to_marker(&renderer->destroy_queue, kept * DM_VULKAN_DEFERRED_DESTROY_STRIDE);
+}
+
+dm_vulkan_buffer* dm_vulkan_get_buffer(dm_vulkan_renderer *renderer, dm_resource handle)
+{
+    dm_vulkan_buffer *buffer = NULL;
+    if(handle.type == DM_RESOURCE_TYPE_BUFFER) buffer = dm_pool_get(&renderer->buffers, handle.index, handle.generation);
+    if(!buffer) LOG_ERROR("Invalid or stale buffer handle");
+
+    return buffer;
+}
+
+dm_vulkan_image* dm_vulkan_get_image(dm_vulkan_renderer *renderer, dm_resource handle)
+{
+    dm_vulkan_image *image = NULL;
+    if(handle.type == DM_RESOURCE_TYPE_TEXTURE) image = dm_pool_get(&renderer->images, handle.index, handle.generation);
+    if(!image) LOG_ERROR("Invalid or stale texture handle");
+
+    return image;
+}
+
+dm_vulkan_sampler* dm_vulkan_get_sampler(dm_vulkan_renderer *renderer, dm_resource handle)
+{
+    dm_vulkan_sampler *sampler = NULL;
+    if(handle.type == DM_RESOURCE_TYPE_SAMPLER) sampler = dm_pool_get(&renderer->samplers, handle.index, handle.generation);
+    if(!sampler) LOG_ERROR("Invalid or stale sampler handle");
+
+    return sampler;
+}
+
+dm_vulkan_render_target* dm_vulkan_get_render_target(dm_vulkan_renderer *renderer, dm_resource handle)
+{
+    dm_vulkan_render_target *target = NULL;
+    if(handle.type == DM_RESOURCE_TYPE_RENDER_TARGET) target = dm_pool_get(&renderer->rts, handle.index, handle.generation);
+    if(!target) LOG_ERROR("Invalid or stale render target handle");
+
+    return target;
+}
+
+// dynamic buffers have a copy per frame in flight, everything else just the one
+u32 dm_vulkan_buffer_copy_count(dm_vulkan_buffer *buffer)
+{
+    return buffer->usage == DM_BUFFER_USAGE_DYNAMIC ? DM_FRAMES_IN_FLIGHT : 1;
+}
+
+// the copy the frame being recorded uses
+u32 dm_vulkan_buffer_copy(dm_vulkan_renderer *renderer, dm_vulkan_buffer *buffer)
+{
+    return buffer->usage == DM_BUFFER_USAGE_DYNAMIC ? renderer->frame_index : 0;
+}
+
+// blocks until the gpu is done with every submitted frame
+void dm_vulkan_wait_submitted_frames(dm_vulkan_renderer *renderer)
+{
+    u64 wait_value = renderer->frame_active ? renderer->timeline_value - 1 : renderer->timeline_value;
+    VkSemaphoreWaitInfo wait_info = {
+        .sType=VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount=1,
+        .pSemaphores=&renderer->timeline_semaphore,
+        .pValues=&wait_value
+    };
+    vkWaitSemaphores(renderer->gpu.device, &wait_info, UINT64_MAX);
+}
+
+// where a buffer, texture or sampler sits in its descriptor heap, which is what shaders index with
+bool dm_vulkan_get_heap_index(dm_vulkan_renderer *renderer, dm_resource resource, u32 *index)
+{
+    dm_vulkan_buffer  *buffer;
+    dm_vulkan_image   *image;
+    dm_vulkan_sampler *sampler;
+
+    switch(resource.type)
+    {
+        case DM_RESOURCE_TYPE_BUFFER:
+            buffer = dm_vulkan_get_buffer(renderer, resource);
+            if(!buffer) return false;
+            *index = buffer->heap_indices[dm_vulkan_buffer_copy(renderer, buffer)];
+            return true;
+        case DM_RESOURCE_TYPE_TEXTURE:
+            image = dm_vulkan_get_image(renderer, resource);
+            if(!image) return false;
+            *index = image->heap_index;
+            return true;
+        case DM_RESOURCE_TYPE_SAMPLER:
+            sampler = dm_vulkan_get_sampler(renderer, resource);
+            if(!sampler) return false;
+            *index = sampler->heap_index;
+            return true;
+        default:
+            LOG_ERROR("Unknown/unsupported resource type");
+            return false;
+    }
+}
+
+dm_vulkan_pipeline* dm_vulkan_get_pipeline(dm_vulkan_renderer *renderer, dm_pipeline handle)
+{
+    dm_vulkan_pipeline *pipeline = NULL;
+    if(handle.type != DM_PIPELINE_TYPE_INVALID) pipeline = dm_pool_get(&renderer->pipes, handle.index, handle.generation);
+    if(!pipeline) LOG_ERROR("Invalid or stale pipeline handle");
+
+    return pipeline;
+}
+
+// takes over the result of a finished async build
+void dm_vulkan_poll_pipeline(dm_vulkan_pipeline *pipeline)
+{
+    dm_vulkan_pipeline_build *build = pipeline->build;
+    if(!build || !dm_job_is_done(&build->counter)) return;
+
+    pipeline->pipeline       = build->result.pipeline;
+    pipeline->blend          = build->result.blend;
+    pipeline->blend_equation = build->result.blend_equation;
+    memcpy(pipeline->shaders, build->result.shaders, sizeof(pipeline->shaders));
+
+    pipeline->status = build->success ? DM_PIPELINE_STATUS_READY : DM_PIPELINE_STATUS_FAILED;
+    pipeline->build  = NULL;
+
+    free(build);
+}
+
+void dm_vulkan_wait_pipeline(dm_context *context, dm_vulkan_pipeline *pipeline)
+{
+    if(pipeline->build) dm_job_wait(context, &pipeline->build->counter);
+    dm_vulkan_poll_pipeline(pipeline);
+}
+
+// the pipeline to actually bind for handle, which is its fallback while it is still building.
+// NULL if neither is ready
+dm_vulkan_pipeline* dm_vulkan_resolve_pipeline(dm_vulkan_renderer *renderer, dm_pipeline *handle)
+{
+    dm_vulkan_pipeline *pipeline = dm_vulkan_get_pipeline(renderer, *handle);
+    if(!pipeline) return NULL;
+
+    dm_vulkan_poll_pipeline(pipeline);
+    if(pipeline->status == DM_PIPELINE_STATUS_READY) return pipeline;
+
+    *handle = pipeline->fallback;
+    if(handle->type == DM_PIPELINE_TYPE_INVALID) return NULL;
+
+    pipeline = dm_vulkan_get_pipeline(renderer, *handle);
+    if(!pipeline) return NULL;
+
+    dm_vulkan_poll_pipeline(pipeline);
+    return pipeline->status == DM_PIPELINE_STATUS_READY ? pipeline : NULL;
+}
+
+/***************
+ * DIRTY RANGES
+ ***************/
+// buffer updates wait in the staging ring until the next point that can record copies, begin_rendering,
+// a dispatch or end_frame. the ranges of a buffer are kept sorted and non-overlapping with newer data
+// winning, so each dirty buffer becomes a single copy with one region per range
+dm_vulkan_dirty_buffer* dm_vulkan_get_dirty_buffer(dm_vulkan_renderer *renderer, dm_resource handle, bool add)
+{
+    for(u32 i=0; i<renderer->dirty_buffer_count; i++)
+    {
+        dm_vulkan_dirty_buffer *dirty = &renderer->dirty_buffers[i];
+        if(dirty->handle.index == handle.index && dirty->handle.generation == handle.generation) return dirty;
+    }
+
+    if(!add) return NULL;
+
+    dm_vulkan_dirty_buffer *dirty = &renderer->dirty_buffers[renderer->dirty_buffer_count++];
+    dirty->handle      = handle;
+    dirty->range_count = 0;
+
+    return dirty;
+}
+
+void dm_vulkan_forget_dirty_buffer(dm_vulkan_renderer *renderer, dm_resource handle)
+{
+    dm_vulkan_dirty_buffer *dirty = dm_vulkan_get_dirty_buffer(renderer, handle, false);
+    if(!dirty) return;
+
+    *dirty = renderer->dirty_buffers[--renderer->dirty_buffer_count];
+}
+
+// cuts [dst, dst + size) out of the ranges, which can split one range in two
+void dm_vulkan_dirty_remove(dm_vulkan_dirty_buffer *dirty, VkDeviceSize dst, VkDeviceSize size)
+{
+    VkDeviceSize end = dst + size;
+
+    dm_vulkan_dirty_range kept[DM_VULKAN_MAX_DIRTY_RANGES + 1];
+    u32 count = 0;
+
+    for(u32 i=0; i<dirty->range_count; i++)
+    {
+        dm_vulkan_dirty_range range = dirty->ranges[i];
+        VkDeviceSize range_end = range.dst + range.size;
+
+        if(range_end <= dst || range.dst >= end)
+        {
+            kept[count++] = range;
+            continue;
+        }
+
+        if(range.dst < dst)  kept[count++] = (dm_vulkan_dirty_range){ .dst=range.dst, .src=range.src, .size=dst - range.dst };
+        if(range_end > end) kept[count++] = (dm_vulkan_dirty_range){ .dst=end, .src=range.src + (end - range.dst), .size=range_end - end };
+    }
+
+    memcpy(dirty->ranges, kept, count * sizeof(dm_vulkan_dirty_range));
+    dirty->range_count = count;
+}
+
+// expects at least two free ranges, one for the insert and one for a split
+void dm_vulkan_dirty_insert(dm_vulkan_dirty_buffer *dirty, VkDeviceSize dst, VkDeviceSize src, VkDeviceSize size)
+{
+    dm_vulkan_dirty_remove(dirty, dst, size);
+
+    u32 i = 0;
+    while(i < dirty->range_count && dirty->ranges[i].dst < dst) i++;
+
+    memmove(dirty->ranges + i + 1, dirty->ranges + i, (dirty->range_count - i) * sizeof(dm_vulkan_dirty_range));
+    dirty->ranges[i] = (dm_vulkan_dirty_range){ .dst=dst, .src=src, .size=size };
+    dirty->range_count++;
+
+    // neighbours merge when they continue each other in both the buffer and the ring
+    if(i + 1 < dirty->range_count)
+    {
+        dm_vulkan_dirty_range *next = &dirty->ranges[i + 1];
+        if(dst + size == next->dst && src + size == next->src)
+        {
+            dirty->ranges[i].size += next->size;
+            memmove(next, next + 1, (dirty->range_count - i - 2) * sizeof(dm_vulkan_dirty_range));
+            dirty->range_count--;
+        }
+    }
+
+    if(i > 0)
+    {
+        dm_vulkan_dirty_range *prev = &dirty->ranges[i - 1];
+        dm_vulkan_dirty_range *range = &dirty->ranges[i];
+        if(prev->dst + prev->size == range->dst && prev->src + prev->size == range->src)
+        {
+            prev->size += range->size;
+            memmove(range, range + 1, (dirty->range_count - i - 1) * sizeof(dm_vulkan_dirty_range));
+            dirty->range_count--;
+        }
+    }
+}
+
+// writes that can't wait for the next flush still have to win over the pending ones,
+// so the overlapping bytes are patched into the ring as well
+void dm_vulkan_dirty_patch(dm_vulkan_renderer *renderer, dm_vulkan_dirty_buffer *dirty, const u8 *data, VkDeviceSize dst, VkDeviceSize size)
+{
+    VkDeviceSize end = dst + size;
+
+    for(u32 i=0; i<dirty->range_count; i++)
+    {
+        dm_vulkan_dirty_range range = dirty->ranges[i];
+
+        VkDeviceSize start = range.dst > dst ? range.dst : dst;
+        VkDeviceSize stop  = range.dst + range.size < end ? range.dst + range.size : end;
+        if(start >= stop) continue;
+
+        memcpy(renderer->staging_ring.mapped + range.src + (start - range.dst), data + (start - dst), stop - start);
+        vmaFlushAllocation(renderer->allocator, renderer->staging_ring.allocation, range.src + (start - range.dst), stop - start);
+    }
+}
+
+// has to be recorded outside of a render pass
+void dm_vulkan_flush_dirty_buffers(dm_vulkan_renderer *renderer, VkCommandBuffer cmd)
+{
+    if(!renderer->dirty_buffer_count) return;
+
+    // earlier commands on the queue may still be reading the buffers, or writing them from a shader or copy
+    VkMemoryBarrier2 write_barrier = {
+        .sType=VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask=VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .srcAccessMask=VK_ACCESS_2_MEMORY_WRITE_BIT,
+        .dstStageMask=VK_PIPELINE_STAGE_2_COPY_BIT,
+        .dstAccessMask=VK_ACCESS_2_TRANSFER_WRITE_BIT
+    };
+    VkDependencyInfo write_dep_info = {
+        .sType=VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount=1,
+        .pMemoryBarriers=&write_barrier
+    };
+    vkCmdPipelineBarrier2(cmd, &write_dep_info);
+
+    for(u32 i=0; i<renderer->dirty_buffer_count; i++)
+    {
+        dm_vulkan_dirty_buffer *dirty = &renderer->dirty_buffers[i];
+
+        dm_vulkan_buffer *buffer = dm_vulkan_get_buffer(renderer, dirty->handle);
+        if(!buffer || !dirty->range_count) continue;
+
+        VkBufferCopy2 regions[DM_VULKAN_MAX_DIRTY_RANGES];
+        for(u32 j=0; j<dirty->range_count; j++)
+        {
+            regions[j] = (VkBufferCopy2){
+                .sType=VK_STRUCTURE_TYPE_BUFFER_COPY_2,
+                .srcOffset=dirty->ranges[j].src,
+                .dstOffset=dirty->ranges[j].dst,
+                .size=dirty->ranges[j].size
+            };
+        }
+
+        VkCopyBufferInfo2 copy_info = {
+            .sType=VK_STRUCTURE_TYPE_COPY_BUFFER_INFO_2,
+            .srcBuffer=renderer->staging_ring.buffer,
+            .dstBuffer=buffer->device,
+            .regionCount=dirty->range_count,
+            .pRegions=regions
+        };
+
+        vkCmdCopyBuffer2(cmd, &copy_info);
+    }
+
+    VkMemoryBarrier2 read_barrier = {
+        .sType=VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask=VK_PIPELINE_STAGE_2_COPY_BIT,
+        .srcAccessMask=VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask=VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .dstAccessMask=VK_ACCESS_2_MEMORY_READ_BIT
+    };
+    VkDependencyInfo read_dep_info = {
+        .sType=VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount=1,
+        .pMemoryBarriers=&read_barrier
+    };
+    vkCmdPipelineBarrier2(cmd, &read_dep_info);
+
+    renderer->dirty_buffer_count = 0;
+}
+
+/*****************
+ * PIPELINE TABLE
+ *****************/
+u64 dm_vulkan_hash_string(const char *string, size_t max, u64 hash)
+{
+    u32 length = strnlen(string, max);
+
+    hash = dm_hash_fnv1a_ex(&length, sizeof(length), hash);
+    return dm_hash_fnv1a_ex(string, length, hash);
+}
+
+// defines are hashed in name order, the order they were listed in doesn't make a new variant
+u64 dm_vulkan_hash_shader_defines(const dm_shader_define *defines, u32 define_count, u64 hash)
+{
+    const dm_shader_define *sorted[DM_MAX_SHADER_DEFINES];
+    u32 count = define_count < DM_MAX_SHADER_DEFINES ? define_count : DM_MAX_SHADER_DEFINES;
+
+    for(u32 i=0; i<count; i++)
+    {
+        const dm_shader_define *define = &defines[i];
+
+        u32 j = i;
+        for(; j>0 && strncmp(sorted[j-1]->name, define->name, sizeof(define->name)) > 0; j--) sorted[j] = sorted[j-1];
+        sorted[j] = define;
+    }
+
+    for(u32 i=0; i<count; i++)
+    {
+        hash = dm_vulkan_hash_string(sorted[i]->name, sizeof(sorted[i]->name), hash);
+        hash = dm_vulkan_hash_string(sorted[i]->value, sizeof(sorted[i]->value), hash);
+    }
+
+    return hash;
+}
+
+// identifies one compiled permutation of a shader source
+u64 dm_vulkan_shader_variant_key(const char *path, const char *entry, u32 kind, const dm_shader_define *defines, u32 define_count)
+{
+    u64 hash = dm_vulkan_hash_string(path, DM_VULKAN_SHADER_STRING_MAX, DM_HASH_FNV1A_SEED);
+    hash = dm_vulkan_hash_string(entry, DM_VULKAN_SHADER_STRING_MAX, hash);
+    hash = dm_hash_fnv1a_ex(&kind, sizeof(kind), hash);
+    hash = dm_vulkan_hash_shader_defines(defines, define_count, hash);
+
+    return hash ? hash : 1;
+}
+
+// only what ends up in the pipeline, so padding and unused blend state don't split identical pipelines
+u64 dm_vulkan_hash_raster_desc(dm_vulkan_renderer *renderer, const dm_raster_pipe_desc *desc)
+{
+    u32 type = DM_PIPELINE_TYPE_RASTER;
+    u64 hash = dm_hash_fnv1a(&type, sizeof(type));
+
+    for(u32 i=0; i<DM_RASTER_SHADER_STAGE_MAX; i++)
+    {
+        const dm_raster_shader *shader = &desc->shaders[i];
+
+        shaderc_shader_kind kind = i == DM_RASTER_SHADER_STAGE_VERTEX ? shaderc_vertex_shader : shaderc_fragment_shader;
+
+        u64 variant = dm_vulkan_shader_variant_key(shader->path, shader->entry[0] ? shader->entry : "main", kind, shader->defines, shader->define_count);
+        hash = dm_hash_fnv1a_ex(&variant, sizeof(variant), hash);
+    }
+
+    u32 blend[7] = { desc->blend };
+    if(desc->blend)
+    {
+        blend[1] = desc->color_blend_op;
+        blend[2] = desc->alpha_blend_op;
+        blend[3] = desc->color_src_factor;
+        blend[4] = desc->color_dst_factor;
+        blend[5] = desc->alpha_src_factor;
+        blend[6] = desc->alpha_dst_factor;
+    }
+    hash = dm_hash_fnv1a_ex(blend, sizeof(blend), hash);
+
+    VkFormat formats[] = { renderer->swapchain.format, renderer->swapchain.depth_format };
+    hash = dm_hash_fnv1a_ex(formats, sizeof(formats), hash);
+
+    return hash ? hash : 1;
+}
+
+// constants are hashed in id order, the order they were listed in doesn't change the pipeline
+u64 dm_vulkan_hash_compute_desc(const dm_compute_pipe_desc *desc)
+{
+    u32 type = DM_PIPELINE_TYPE_COMPUTE;
+    u64 hash = dm_hash_fnv1a(&type, sizeof(type));
+
+    u64 variant = dm_vulkan_shader_variant_key(desc->path, desc->entry[0] ? desc->entry : "main", shaderc_compute_shader, desc->defines, desc->define_count);
+    hash = dm_hash_fnv1a_ex(&variant, sizeof(variant), hash);
+
+    dm_spec_constant constants[DM_MAX_SPEC_CONSTANTS];
+    u32 count = desc->constant_count < DM_MAX_SPEC_CONSTANTS ? desc->constant_count : DM_MAX_SPEC_CONSTANTS;
+
+    for(u32 i=0; i<count; i++)
+    {
+        dm_spec_constant constant = desc->constants[i];
+
+        u32 j = i;
+        for(; j>0 && constants[j-1].id > constant.id; j--) constants[j] = constants[j-1];
+        constants[j] = constant;
+    }
+    hash = dm_hash_fnv1a_ex(constants, count * sizeof(dm_spec_constant), hash);
+
+    return hash ? hash : 1;
+}
+
+u32 dm_vulkan_pipeline_table_probe(dm_vulkan_pipeline_table *table, u64 hash)
+{
+    u32 mask = table->capacity - 1;
+    u32 i = (u32)hash & mask;
+
+    while(table->hashes[i] && table->hashes[i] != hash) i = (i + 1) & mask;
+
+    return i;
+}
+
+bool dm_vulkan_pipeline_table_find(dm_vulkan_pipeline_table *table, u64 hash, dm_pipeline *handle)
+{
+    if(!table->count) return false;
+
+    u32 i = dm_vulkan_pipeline_table_probe(table, hash);
+    if(!table->hashes[i]) return false;
+
+    *handle = table->handles[i];
+    return true;
+}
+
+bool dm_vulkan_pipeline_table_grow(dm_vulkan_pipeline_table *table)
+{
+    dm_vulkan_pipeline_table grown = {
+        .capacity=table->capacity ? table->capacity * 2 : DM_VULKAN_PIPELINE_TABLE_MIN_CAPACITY
+    };
+
+    grown.hashes  = calloc(grown.capacity, sizeof(u64));
+    grown.handles = calloc(grown.capacity, sizeof(dm_pipeline));
+    if(!grown.hashes || !grown.handles)
+    {
+        free(grown.hashes);
+        free(grown.handles);
+        return false;
+    }
+
+    for(u32 i=0; i<table->capacity; i++)
+    {
+        if(!table->hashes[i]) continue;
+
+        u32 j = dm_vulkan_pipeline_table_probe(&grown, table->hashes[i]);
+        grown.hashes[j]  = table->hashes[i];
+        grown.handles[j] = table->handles[i];
+        grown.count++;
+    }
+
+    free(table->hashes);
+    free(table->handles);
+    *table = grown;
+
+    return true;
+}
+
+// replaces whatever is stored under hash
+bool dm_vulkan_pipeline_table_insert(dm_vulkan_pipeline_table *table, u64 hash, dm_pipeline handle)
+{
+    if((table->count + 1) * 4 > table->capacity * 3 && !dm_vulkan_pipeline_table_grow(table)) return false;
+
+    u32 i = dm_vulkan_pipeline_table_probe(table, hash);
+    if(!table->hashes[i]) table->count++;
+
+    table->hashes[i]  = hash;
+    table->handles[i] = handle;
+
+    return true;
+}
+
+void dm_vulkan_pipeline_table_remove(dm_vulkan_pipeline_table *table, u64 hash)
+{
+    if(!table->count) return;
+
+    u32 mask = table->capacity - 1;
+    u32 i = dm_vulkan_pipeline_table_probe(table, hash);
+    if(!table->hashes[i]) return;
+
+    table->hashes[i] = 0;
+    table->count--;
+
+    // shift back entries that probed past the hole so lookups still reach them
+    for(u32 j = (i + 1) & mask; table->hashes[j]; j = (j + 1) & mask)
+    {
+        u32 home = (u32)table->hashes[j] & mask;
+
+        bool movable = i <= j ? (home <= i || home > j) : (home <= i && home > j);
+        if(!movable) continue;
+
+        table->hashes[i]  = table->hashes[j];
+        table->handles[i] = table->handles[j];
+        table->hashes[j]  = 0;
+        i = j;
+    }
+}
+
+void dm_vulkan_pipeline_table_destroy(dm_vulkan_pipeline_table *table)
+{
+    free(table->hashes);
+    free(table->handles);
+    *table = (dm_vulkan_pipeline_table){ 0 };
+}
+
+// an existing pipeline for hash, with its reference taken
+dm_vulkan_pipeline* dm_vulkan_acquire_pipeline(dm_vulkan_renderer *renderer, u64 hash, dm_pipeline *handle)
+{
+    dm_pipeline existing;
+    if(!dm_vulkan_pipeline_table_find(&renderer->pipeline_table, hash, &existing)) return NULL;
+
+    dm_vulkan_pipeline *pipeline = dm_pool_get(&renderer->pipes, existing.index, existing.generation);
+    if(!pipeline) return NULL;
+
+    // a failed build gets another try under a new handle
+    dm_vulkan_poll_pipeline(pipeline);
+    if(pipeline->status == DM_PIPELINE_STATUS_FAILED) return NULL;
+
+    pipeline->ref_count++;
+    *handle = existing;
+
+    return pipeline;
+}
+
+// synchronous creates want something usable right away, so a shared pipeline still building is waited on
+bool dm_vulkan_acquire_ready_pipeline(dm_context *context, u64 hash, dm_pipeline *handle)
+{
+    dm_vulkan_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
+
+    dm_vulkan_pipeline *existing = dm_vulkan_acquire_pipeline(renderer, hash, handle);
+    if(!existing) return false;
+
+    dm_vulkan_wait_pipeline(context, existing);
+    if(existing->status == DM_PIPELINE_STATUS_READY) return true;
+
+    dm_renderer_destroy_pipeline(context, *handle);
+    return false;
+}
+
+// for pipelines that never made it into a frame
+void dm_vulkan_release_pipeline_objects(dm_vulkan_renderer *renderer, dm_vulkan_pipeline *pipeline)
+{
+    vkDestroyPipeline(renderer->gpu.device, pipeline->pipeline, DM_VULKAN_ALLOCATOR);
+    for(u32 i=0; i<DM_RASTER_SHADER_STAGE_MAX; i++)
+    {
+        vkDestroyShaderEXT(renderer->gpu.device, pipeline->shaders[i], DM_VULKAN_ALLOCATOR);
+    }
+}
+
+bool dm_vulkan_add_pipeline(dm_vulkan_renderer *renderer, dm_vulkan_pipeline pipeline, dm_pipeline_type type, dm_pipeline *handle)
+{
+    u32 index, generation;
+    dm_vulkan_pipeline *slot = dm_pool_alloc(&renderer->pipes, &index, &generation);
+    if(!slot) return false;
+
+    *slot = pipeline;
+    slot->ref_count = 1;
+
+    handle->type       = type;
+    handle->index      = index;
+    handle->generation = generation;
+
+    // sharing is an optimization, a full table just means duplicates
+    if(slot->hash) dm_vulkan_pipeline_table_insert(&renderer->pipeline_table, slot->hash, *handle);
+
+    return true;
+}
+
+/*****************
+ * PIPELINE CACHE
+ *****************/
+// driver cache blobs are only valid for the exact device and driver they came from,
+// so they are stored behind a header with both and dropped on mismatch instead of trusting every driver to check
+#define DM_VULKAN_PIPELINE_CACHE_MAGIC    0x43505044 // "DPPC"
+#define DM_VULKAN_PIPELINE_CACHE_VERSION  1
+#define DM_VULKAN_PIPELINE_CACHE_PATH     DM_CACHE_DIRECTORY "/pipeline_cache.bin"
+#define DM_VULKAN_PIPELINE_BINARY_MAGIC   0x42505044 // "DPPB"
+#define DM_VULKAN_PIPELINE_BINARY_VERSION 1
+#define DM_VULKAN_PIPELINE_MAX_BINARIES   8
+
+typedef struct dm_vulkan_device_id_t
+{
+    u32 vendor_id, device_id, driver_version;
+    u8  uuid[VK_UUID_SIZE];
+} dm_vulkan_device_id;
+
+typedef struct dm_vulkan_pipeline_cache_header_t
+{
+    u32 magic, version;
+    dm_vulkan_device_id device;
+    u32 data_size;
+    u64 data_hash;
+} dm_vulkan_pipeline_cache_header;
+
+// file layout is the header, then binary_count entries each followed by their data
+typedef struct dm_vulkan_pipeline_binary_header_t
+{
+    u32 magic, version;
+    dm_vulkan_device_id device;
+    u32 binary_count;
+} dm_vulkan_pipeline_binary_header;
+
+typedef struct dm_vulkan_pipeline_binary_entry_t
+{
+    u64 data_size;
+    u32 key_size, padding;
+    u8  key[VK_MAX_PIPELINE_BINARY_KEY_SIZE_KHR];
+} dm_vulkan_pipeline_binary_entry;
+
+dm_vulkan_device_id dm_vulkan_get_device_id(dm_vulkan_gpu gpu)
+{
+    dm_vulkan_device_id id = {
+        .vendor_id=gpu.properties.vendorID,
+        .device_id=gpu.properties.deviceID,
+        .driver_version=gpu.properties.driverVersion
+    };
+    memcpy(id.uuid, gpu.properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+    return id;
+}
+
+// the cache file goes through the io engine while the instance and device are created.
+// the request and its buffer live in the first frame arena, which nothing touches before the first frame,
+// so they stay valid even when init bails out with the read still in flight
+bool dm_vulkan_read_pipeline_cache_begin(dm_context *context, dm_io_request **request, dm_io_ticket *ticket)
+{
+    size_t size;
+    if(!dm_file_exists(DM_VULKAN_PIPELINE_CACHE_PATH) || !dm_file_get_size(DM_VULKAN_PIPELINE_CACHE_PATH, &size)) return false;
+    if(size < sizeof(dm_vulkan_pipeline_cache_header)) return false;
+
+    dm_arena *arena = &context->frame_arenas[0];
+
+    *request = dm_arena_alloc(arena, sizeof(dm_io_request), NULL);
+    void *buffer = dm_arena_alloc(arena, size, NULL);
+    if(!*request || !buffer) return false;
+
+    **request = (dm_io_request){
+        .path=DM_VULKAN_PIPELINE_CACHE_PATH,
+        .buffer=buffer,
+        .size=size
+    };
+
+    return dm_io_submit(context, *request, 1, ticket);
+}
+
+// file is empty when there was nothing to read or the read failed
+VkPipelineCache dm_vulkan_create_pipeline_cache(dm_vulkan_gpu gpu, dm_mapped_file file)
+{
+    VkPipelineCache cache = VK_NULL_HANDLE;
+
+    VkPipelineCacheCreateInfo info = {
+        .sType=VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO
+    };
+
+    if(file.data)
+    {
+        const dm_vulkan_pipeline_cache_header *header = file.data;
+        const u8 *data = (const u8*)file.data + sizeof(dm_vulkan_pipeline_cache_header);
+        dm_vulkan_device_id id = dm_vulkan_get_device_id(gpu);
+
+        bool valid = file.size >= sizeof(dm_vulkan_pipeline_cache_header) &&
+                     header->magic == DM_VULKAN_PIPELINE_CACHE_MAGIC &&
+                     header->version == DM_VULKAN_PIPELINE_CACHE_VERSION &&
+                     memcmp(&header->device, &id, sizeof(id)) == 0 &&
+                     header->data_size == file.size - sizeof(dm_vulkan_pipeline_cache_header) &&
+                     dm_hash_fnv1a(data, header->data_size) == header->data_hash;
+
+        if(valid)
+        {
+            info.initialDataSize = header->data_size;
+            info.pInitialData    = data;
+            LOG_INFO("Loaded pipeline cache (%u bytes)", header->data_size);
+        }
+        else
+        {
+            LOG_INFO("Pipeline cache is stale or from another device, starting empty");
+        }
+    }
+
+    VkResult vr = vkCreatePipelineCache(gpu.device, &info, DM_VULKAN_ALLOCATOR, &cache);
+
+    // drivers can still reject the data, an empty cache beats none
+    if(vr != VK_SUCCESS && info.initialDataSize)
+    {
+        info.initialDataSize = 0;
+        info.pInitialData    = NULL;
+        vr = vkCreatePipelineCache(gpu.device, &info, DM_VULKAN_ALLOCATOR, &cache);
+    }
+
+    if(!dm_vulkan_decode_vr(vr))
+    {
+        LOG_ERROR("vkCreatePipelineCache failed");
+        return VK_NULL_HANDLE;
+    }
+
+    return cache;
+}
+
+void dm_vulkan_save_pipeline_cache(dm_vulkan_gpu gpu, VkPipelineCache cache)
+{
+    size_t size = 0;
+    if(!dm_vulkan_decode_vr(vkGetPipelineCacheData(gpu.device, cache, &size, NULL)) || !size) return;
+
+    u8 *data = malloc(sizeof(dm_vulkan_pipeline_cache_header) + size);
+    if(!data) return;
+
+    u8 *cache_data = data + sizeof(dm_vulkan_pipeline_cache_header);
+    if(vkGetPipelineCacheData(gpu.device, cache, &size, cache_data) == VK_SUCCESS)
+    {
+        dm_vulkan_pipeline_cache_header header = {
+            .magic=DM_VULKAN_PIPELINE_CACHE_MAGIC,
+            .version=DM_VULKAN_PIPELINE_CACHE_VERSION,
+            .device=dm_vulkan_get_device_id(gpu),
+            .data_size=size,
+            .data_hash=dm_hash_fnv1a(cache_data, size)
+        };
+        memcpy(data, &header, sizeof(header));
+
+        if(dm_write_bytes(DM_VULKAN_PIPELINE_CACHE_PATH, data, sizeof(header) + size)) LOG_INFO("Saved pipeline cache (%zu bytes)", size);
+    }
+
+    free(data);
+}
+
+/******************
+ * PIPELINE BINARY
+ ******************/
+// with VK_KHR_pipeline_binary the compiled pipeline itself is stored, keyed by the driver's key for its create info.
+// a hit skips driver compilation entirely, a miss captures the new pipeline's binaries and writes them out
+bool dm_vulkan_use_pipeline_binaries(dm_vulkan_gpu gpu)
+{
+    // drivers that would rather use their own cache know better
+    return gpu.extensions.pipeline_binary && !gpu.binary_props.pipelineBinaryPrefersInternalCache;
+}
+
+void dm_vulkan_pipeline_binary_path(const VkPipelineBinaryKeyKHR *key, char *path, size_t size)
+{
+    u64 hash = dm_hash_fnv1a(key->key, key->keySize);
+
+    snprintf(path, size, "%s/%016llx.pbin", DM_CACHE_DIRECTORY, (unsigned long long)hash);
+}
+
+// the binaries a pipeline with this key was created from before, 0 on a miss
+u32 dm_vulkan_load_pipeline_binaries(dm_vulkan_gpu gpu, const VkPipelineBinaryKeyKHR *pipeline_key, VkPipelineBinaryKHR *binaries)
+{
+    char path[512];
+    dm_vulkan_pipeline_binary_path(pipeline_key, path, sizeof(path));
+    if(!dm_file_exists(path)) return 0;
+
+    dm_mapped_file file;
+    if(!dm_file_map(path, &file)) return 0;
+
+    const u8 *base = file.data;
+    const dm_vulkan_pipeline_binary_header *header = file.data;
+    dm_vulkan_device_id id = dm_vulkan_get_device_id(gpu);
+
+    VkPipelineBinaryKeyKHR  keys[DM_VULKAN_PIPELINE_MAX_BINARIES];
+    VkPipelineBinaryDataKHR data[DM_VULKAN_PIPELINE_MAX_BINARIES];
+
+    bool valid = file.size >= sizeof(dm_vulkan_pipeline_binary_header) &&
+                 header->magic == DM_VULKAN_PIPELINE_BINARY_MAGIC &&
+                 header->version == DM_VULKAN_PIPELINE_BINARY_VERSION &&
+                 memcmp(&header->device, &id, sizeof(id)) == 0 &&
+                 header->binary_count && header->binary_count <= DM_VULKAN_PIPELINE_MAX_BINARIES;
+
+    size_t offset = sizeof(dm_vulkan_pipeline_binary_header);
+    for(u32 i=0; valid && i<header->binary_count; i++)
+    {
+        const dm_vulkan_pipeline_binary_entry *entry = (const dm_vulkan_pipeline_binary_entry*)(base + offset);
+
+        valid = offset + sizeof(dm_vulkan_pipeline_binary_entry) <= file.size &&
+                entry->key_size <= VK_MAX_PIPELINE_BINARY_KEY_SIZE_KHR &&
+                entry->data_size <= file.size - offset - sizeof(dm_vulkan_pipeline_binary_entry);
+        if(!valid) break;
+
+        keys[i] = (VkPipelineBinaryKeyKHR){
+            .sType=VK_STRUCTURE_TYPE_PIPELINE_BINARY_KEY_KHR,
+            .keySize=entry->key_size
+        };
+        memcpy(keys[i].key, entry->key, entry->key_size);
+
+        data[i] = (VkPipelineBinaryDataKHR){
+            .dataSize=entry->data_size,
+            .pData=(void*)(entry + 1)
+        };
+
+        offset = DM_ALIGN(offset + sizeof(dm_vulkan_pipeline_binary_entry) + entry->data_size, (size_t)8);
+    }
+
+    u32 count = 0;
+    if(valid)
+    {
+        VkPipelineBinaryKeysAndDataKHR keys_and_data = {
+            .binaryCount=header->binary_count,
+            .pPipelineBinaryKeys=keys,
+            .pPipelineBinaryData=data
+        };
+        VkPipelineBinaryCreateInfoKHR info = {
+            .sType=VK_STRUCTURE_TYPE_PIPELINE_BINARY_CREATE_INFO_KHR,
+            .pKeysAndDataInfo=&keys_and_data
+        };
+        VkPipelineBinaryHandlesInfoKHR handles = {
+            .sType=VK_STRUCTURE_TYPE_PIPELINE_BINARY_HANDLES_INFO_KHR,
+            .pipelineBinaryCount=header->binary_count,
+            .pPipelineBinaries=binaries
+        };
+
+        for(u32 i=0; i<header->binary_count; i++) binaries[i] = VK_NULL_HANDLE;
+
+        if(vkCreatePipelineBinariesKHR(gpu.device, &info, DM_VULKAN_ALLOCATOR, &handles) == VK_SUCCESS)
+        {
+            count = header->binary_count;
+        }
+        else
+        {
+            for(u32 i=0; i<header->binary_count; i++) vkDestroyPipelineBinaryKHR(gpu.device, binaries[i], DM_VULKAN_ALLOCATOR);
+        }
+    }
+
+    if(!count) LOG_INFO("Pipeline binaries %s are stale", path);
+
+    dm_file_unmap(&file);
+
+    return count;
+}
+
+// pipeline must have been created with VK_PIPELINE_CREATE_2_CAPTURE_DATA_BIT_KHR
+void dm_vulkan_store_pipeline_binaries(dm_vulkan_gpu gpu, VkPipeline pipeline, const VkPipelineBinaryKeyKHR *pipeline_key)
+{
+    VkPipelineBinaryKHR binaries[DM_VULKAN_PIPELINE_MAX_BINARIES] = { 0 };
+
+    VkPipelineBinaryCreateInfoKHR info = {
+        .sType=VK_STRUCTURE_TYPE_PIPELINE_BINARY_CREATE_INFO_KHR,
+        .pipeline=pipeline
+    };
+    VkPipelineBinaryHandlesInfoKHR handles = {
+        .sType=VK_STRUCTURE_TYPE_PIPELINE_BINARY_HANDLES_INFO_KHR
+    };
+
+    // first call gets the count
+    VkResult vr = vkCreatePipelineBinariesKHR(gpu.device, &info, DM_VULKAN_ALLOCATOR, &handles);
+    if(vr == VK_SUCCESS && handles.pipelineBinaryCount && handles.pipelineBinaryCount <= DM_VULKAN_PIPELINE_MAX_BINARIES)
+    {
+        handles.pPipelineBinaries = binaries;
+        vr = vkCreatePipelineBinariesKHR(gpu.device, &info, DM_VULKAN_ALLOCATOR, &handles);
+    }
+    else if(vr == VK_SUCCESS)
+    {
+        vr = VK_ERROR_UNKNOWN;
+    }
+
+    // the binaries hold their own copy
+    VkReleaseCapturedPipelineDataInfoKHR release_info = {
+        .sType=VK_STRUCTURE_TYPE_RELEASE_CAPTURED_PIPELINE_DATA_INFO_KHR,
+        .pipeline=pipeline
+    };
+    vkReleaseCapturedPipelineDataKHR(gpu.device, &release_info, DM_VULKAN_ALLOCATOR);
+
+    if(vr != VK_SUCCESS)
+    {
+        LOG_WARN("Could not capture pipeline binaries");
+        for(u32 i=0; i<DM_VULKAN_PIPELINE_MAX_BINARIES; i++) vkDestroyPipelineBinaryKHR(gpu.device, binaries[i], DM_VULKAN_ALLOCATOR);
+        return;
+    }
+
+    u32 count = handles.pipelineBinaryCount;
+
+    // sizes first so everything goes out in one write
+    VkPipelineBinaryKeyKHR keys[DM_VULKAN_PIPELINE_MAX_BINARIES];
+    size_t sizes[DM_VULKAN_PIPELINE_MAX_BINARIES];
+    size_t size = sizeof(dm_vulkan_pipeline_binary_header);
+    bool result = true;
+
+    for(u32 i=0; result && i<count; i++)
+    {
+        VkPipelineBinaryDataInfoKHR data_info = {
+            .sType=VK_STRUCTURE_TYPE_PIPELINE_BINARY_DATA_INFO_KHR,
+            .pipelineBinary=binaries[i]
+        };
+        keys[i] = (VkPipelineBinaryKeyKHR){ .sType=VK_STRUCTURE_TYPE_PIPELINE_BINARY_KEY_KHR };
+
+        result = vkGetPipelineBinaryDataKHR(gpu.device, &data_info, &keys[i], &sizes[i], NULL) == VK_SUCCESS;
+        size = DM_ALIGN(size + sizeof(dm_vulkan_pipeline_binary_entry) + sizes[i], (size_t)8);
+    }
+
+    u8 *data = result ? calloc(1, size) : NULL;
+    if(data)
+    {
+        dm_vulkan_pipeline_binary_header header = {
+            .magic=DM_VULKAN_PIPELINE_BINARY_MAGIC,
+            .version=DM_VULKAN_PIPELINE_BINARY_VERSION,
+            .device=dm_vulkan_get_device_id(gpu),
+            .binary_count=count
+        };
+        memcpy(data, &header, sizeof(header));
+
+        size_t offset = sizeof(header);
+        for(u32 i=0; result && i<count; i++)
+        {
+            VkPipelineBinaryDataInfoKHR data_info = {
+                .sType=VK_STRUCTURE_TYPE_PIPELINE_BINARY_DATA_INFO_KHR,
+                .pipelineBinary=binaries[i]
+            };
+
+            dm_vulkan_pipeline_binary_entry *entry = (dm_vulkan_pipeline_binary_entry*)(data + offset);
+            entry->data_size = sizes[i];
+            entry->key_size  = keys[i].keySize;
+            memcpy(entry->key, keys[i].key, keys[i].keySize);
+
+            result = vkGetPipelineBinaryDataKHR(gpu.device, &data_info, &keys[i], &sizes[i], entry + 1) == VK_SUCCESS;
+            offset = DM_ALIGN(offset + sizeof(dm_vulkan_pipeline_binary_entry) + sizes[i], (size_t)8);
+        }
+
+        char path[512];
+        dm_vulkan_pipeline_binary_path(pipeline_key, path, sizeof(path));
+        if(result) dm_write_bytes(path, data, size);
+
+        free(data);
+    }
+
+    for(u32 i=0; i<count; i++) vkDestroyPipelineBinaryKHR(gpu.device, binaries[i], DM_VULKAN_ALLOCATOR);
+}
+
+// create_info is a VkGraphicsPipelineCreateInfo or VkComputePipelineCreateInfo with flags2 somewhere in its pNext chain.
+// goes through pipeline binaries when the driver wants them, the pipeline cache otherwise
+bool dm_vulkan_create_pipeline(dm_vulkan_renderer *renderer, void *create_info, VkPipelineCreateFlags2CreateInfo *flags2, VkPipeline *pipeline)
+{
+    dm_vulkan_gpu gpu = renderer->gpu;
+    VkBaseOutStructure *base = create_info;
+    bool compute = base->sType == VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+
+    VkPipelineCache cache = renderer->pipeline_cache;
+    VkPipelineBinaryKeyKHR key = { .sType=VK_STRUCTURE_TYPE_PIPELINE_BINARY_KEY_KHR };
+    VkPipelineBinaryKHR binaries[DM_VULKAN_PIPELINE_MAX_BINARIES];
+    VkPipelineBinaryInfoKHR binary_info = { .sType=VK_STRUCTURE_TYPE_PIPELINE_BINARY_INFO_KHR, .pPipelineBinaries=binaries };
+    bool capture = false;
+
+    if(dm_vulkan_use_pipeline_binaries(gpu))
+    {
+        VkPipelineCreateInfoKHR key_info = {
+            .sType=VK_STRUCTURE_TYPE_PIPELINE_CREATE_INFO_KHR,
+            .pNext=create_info
+        };
+
+        if(vkGetPipelineKeyKHR(gpu.device, &key_info, &key) == VK_SUCCESS)
+        {
+            // binaries and the pipeline cache can't be used together
+            cache = VK_NULL_HANDLE;
+
+            binary_info.binaryCount = dm_vulkan_load_pipeline_binaries(gpu, &key, binaries);
+            if(binary_info.binaryCount)
+            {
+                binary_info.pNext = base->pNext;
+                base->pNext = (VkBaseOutStructure*)&binary_info;
+            }
+            else
+            {
+                capture = true;
+                flags2->flags |= VK_PIPELINE_CREATE_2_CAPTURE_DATA_BIT_KHR;
+            }
+        }
+    }
+
+    VkResult vr;
+    if(compute) vr = vkCreateComputePipelines(gpu.device, cache, 1, create_info, DM_VULKAN_ALLOCATOR, pipeline);
+    else        vr = vkCreateGraphicsPipelines(gpu.device, cache, 1, create_info, DM_VULKAN_ALLOCATOR, pipeline);
+
+    // leave the caller's create info the way it was
+    flags2->flags &= ~VK_PIPELINE_CREATE_2_CAPTURE_DATA_BIT_KHR;
+    if(binary_info.binaryCount)
+    {
+        base->pNext = (VkBaseOutStructure*)binary_info.pNext;
+        for(u32 i=0; i<binary_info.binaryCount; i++) vkDestroyPipelineBinaryKHR(gpu.device, binaries[i], DM_VULKAN_ALLOCATOR);
+
+        // stale after a driver update, build from spir-v and capture fresh binaries over the old .pbin
+        if(vr != VK_SUCCESS)
+        {
+            LOG_WARN("Pipeline binaries were rejected, compiling the pipeline instead");
+
+            capture = true;
+            flags2->flags |= VK_PIPELINE_CREATE_2_CAPTURE_DATA_BIT_KHR;
+
+            if(compute) vr = vkCreateComputePipelines(gpu.device, VK_NULL_HANDLE, 1, create_info, DM_VULKAN_ALLOCATOR, pipeline);
+            else        vr = vkCreateGraphicsPipelines(gpu.device, VK_NULL_HANDLE, 1, create_info, DM_VULKAN_ALLOCATOR, pipeline);
+
+            flags2->flags &= ~VK_PIPELINE_CREATE_2_CAPTURE_DATA_BIT_KHR;
+        }
+    }
+
+    if(!dm_vulkan_decode_vr(vr)) return false;
+
+    if(capture) dm_vulkan_store_pipeline_binaries(gpu, *pipeline, &key);
+
+    return true;
+}
+
+/**********
+ * SHADERS
+ **********/
+// shaders are either glsl compiled at runtime or spir-v baked offline by dm_shaderc,
+// builds with DM_OFFLINE_SHADERS_ONLY leave the runtime compiler out entirely
+#define DM_VULKAN_SPIRV_MAGIC 0x07230203
+
+// owned copy, release with dm_vulkan_spirv_free
+// must stay alive until the job counter it was submitted with is done
+typedef struct dm_vulkan_shader_request_t
+{
+    dm_context*             context;
+    const char*             path;
+    const char*             entry;
+    shaderc_shader_kind     kind;
+    const dm_shader_define* defines;
+    u32                     define_count;
+
+    dm_vulkan_spirv spirv;
+} dm_vulkan_shader_request;
+
+bool dm_vulkan_spirv_copy(const void *code, size_t size, dm_vulkan_spirv *spirv)
+{
+    spirv->code = malloc(size);
+    if(!spirv->code) return false;
+
+    memcpy(spirv->code, code, size);
+    spirv->size = size;
+
+    return true;
+}
+
+void dm_vulkan_spirv_free(dm_vulkan_spirv *spirv)
+{
+    free(spirv->code);
+    *spirv = (dm_vulkan_spirv){ 0 };
+}
+
+bool dm_vulkan_load_spirv(dm_context *context, const char *path, dm_vulkan_spirv *spirv)
+{
+    LOG_INFO("Loading shader from file %s", path);
+
+    dm_mapped_file file;
+    if(!dm_asset_map(context, path, &file)) return false;
+
+    bool result = false;
+    if(file.size < sizeof(u32) || file.size % sizeof(u32) || *(const u32*)file.data != DM_VULKAN_SPIRV_MAGIC)
+    {
+        LOG_ERROR("Not a SPIR-V file: %s", path);
+    }
+    else
+    {
+        result = dm_vulkan_spirv_copy(file.data, file.size, spirv);
+    }
+
+    dm_file_unmap(&file);
+
+    return result;
+}
+
+// prefers a baked path.spv over path.glsl. a baked file is a single variant though, so shaders with defines
+// go to the glsl when there is one. a loose .spv older than its .glsl is stale and loses to it too
+void dm_vulkan_get_shader_path(dm_context *context, const char *base, bool has_defines, char *path, size_t size)
+{
+#ifndef DM_OFFLINE_SHADERS_ONLY
+    if(has_defines)
+    {
+        snprintf(path, size, "%s.glsl", base);
+        if(dm_archive_find(&context->archive, path) || dm_file_exists(path)) return;
+    }
+#endif
+
+    snprintf(path, size, "%s.spv", base);
+    if(dm_archive_find(&context->archive, path)) return;
+
+    u64 spirv_mtime, glsl_mtime;
+    if(dm_file_get_mtime(path, &spirv_mtime))
+    {
+        char glsl_path[512];
+        snprintf(glsl_path, sizeof(glsl_path), "%s.glsl", base);
+        if(!dm_file_get_mtime(glsl_path, &glsl_mtime) || glsl_mtime <= spirv_mtime) return;
+
+#ifdef DM_OFFLINE_SHADERS_ONLY
+        LOG_WARN("%s is older than %s, rebake it", path, glsl_path);
+        return;
+#else
+        LOG_WARN("%s is older than %s, compiling the glsl instead", path, glsl_path);
+#endif
+    }
+
+    snprintf(path, size, "%s.glsl", base);
+}
+
+/******************
+ * SHADER VARIANTS
+ ******************/
+// every permutation a pipeline has asked for stays here until shutdown, so stages shared between pipelines
+// (one vertex shader under many fragment variants) are compiled once. variants nobody asks for are never built
+u32 dm_vulkan_shader_variants_probe(dm_vulkan_shader_variants *variants, u64 key)
+{
+    u32 mask = variants->capacity - 1;
+    u32 i = (u32)key & mask;
+
+    while(variants->keys[i] && variants->keys[i] != key) i = (i + 1) & mask;
+
+    return i;
+}
+
+bool dm_vulkan_shader_variants_grow(dm_vulkan_shader_variants *variants)
+{
+    dm_vulkan_shader_variants grown = {
+        .capacity=variants->capacity ? variants->capacity * 2 : DM_VULKAN_PIPELINE_TABLE_MIN_CAPACITY
+    };
+
+    grown.keys  = calloc(grown.capacity, sizeof(u64));
+    grown.spirv = calloc(grown.capacity, sizeof(dm_vulkan_spirv));
+    if(!grown.keys || !grown.spirv)
+    {
+        free(grown.keys);
+        free(grown.spirv);
+        return false;
+    }
+
+    for(u32 i=0; i<variants->capacity; i++)
+    {
+        if(!variants->keys[i]) continue;
+
+        u32 j = dm_vulkan_shader_variants_probe(&grown, variants->keys[i]);
+        grown.keys[j]  = variants->keys[i];
+        grown.spirv[j] = variants->spirv[i];
+        grown.count++;
+    }
+
+    free(variants->keys);
+    free(variants->spirv);
+    *variants = grown;
+
+    return true;
+}
+
+// copies the variant out, the caller owns the copy
+bool dm_vulkan_find_shader_variant(dm_vulkan_renderer *renderer, u64 key, dm_vulkan_spirv *spirv)
+{
+    dm_vulkan_shader_variants *variants = &renderer->shader_variants;
+    bool result = false;
+
+    dm_mutex_lock(&renderer->shader_variant_lock);
+    if(variants->count)
+    {
+        u32 i = dm_vulkan_shader_variants_probe(variants, key);
+        if(variants->keys[i]) result = dm_vulkan_spirv_copy(variants->spirv[i].code, variants->spirv[i].size, spirv);
+    }
+    dm_mutex_unlock(&renderer->shader_variant_lock);
+
+    return result;
+}
+
+// two jobs can race to build the same variant, the first one in wins
+void dm_vulkan_store_shader_variant(dm_vulkan_renderer *renderer, u64 key, const dm_vulkan_spirv *spirv)
+{
+    dm_vulkan_shader_variants *variants = &renderer->shader_variants;
+
+    dm_mutex_lock(&renderer->shader_variant_lock);
+    if((variants->count + 1) * 4 <= variants->capacity * 3 || dm_vulkan_shader_variants_grow(variants))
+    {
+        u32 i = dm_vulkan_shader_variants_probe(variants, key);
+        if(!variants->keys[i] && dm_vulkan_spirv_copy(spirv->code, spirv->size, &variants->spirv[i]))
+        {
+            variants->keys[i] = key;
+            variants->count++;
+        }
+    }
+    dm_mutex_unlock(&renderer->shader_variant_lock);
+}
+
+void dm_vulkan_destroy_shader_variants(dm_vulkan_renderer *renderer)
+{
+    dm_vulkan_shader_variants *variants = &renderer->shader_variants;
+
+    for(u32 i=0; i<variants->capacity; i++)
+    {
+        if(variants->keys[i]) dm_vulkan_spirv_free(&variants->spirv[i]);
+    }
+
+    free(variants->keys);
+    free(variants->spirv);
+    *variants = (dm_vulkan_shader_variants){ 0 };
+
+    dm_mutex_destroy(&renderer->shader_variant_lock);
+}
+
+#ifndef DM_OFFLINE_SHADERS_ONLY
+/****************
+ * SHADER CACHE
+ ****************/
+// compiled spir-v is kept in DM_CACHE_DIRECTORY under a key hashed from the source, entry point, kind, defines and compile options.
+// every file a shader includes is recorded with its content hash and checked on load, so editing any of them invalidates the entry
+#define DM_VULKAN_SHADER_CACHE_MAGIC   0x43505344 // "DSPC"
+#define DM_VULKAN_SHADER_CACHE_VERSION 1
+#define DM_VULKAN_SHADER_MAX_INCLUDES  32
+#define DM_VULKAN_SHADER_PATH_SIZE     256
+
+typedef struct dm_vulkan_shader_options_t
+{
+    u32 target_env, env_version, spirv_version;
+    u32 optimization_level, debug_info;
+} dm_vulkan_shader_options;
+
+// debug builds keep shaders debuggable, release builds optimize like dm_shaderc does
+static const dm_vulkan_shader_options dm_vulkan_default_shader_options = {
+    .target_env=shaderc_target_env_vulkan,
+    .env_version=shaderc_env_version_vulkan_1_4,
+    .spirv_version=shaderc_spirv_version_1_6,
+#ifdef DM_DEBUG
+    .optimization_level=shaderc_optimization_level_zero,
+    .debug_info=true
+#else
+    .optimization_level=shaderc_optimization_level_performance,
+    .debug_info=false
+#endif
+};
+
+typedef struct dm_vulkan_shader_include_t
+{
+    u64  hash;
+    char path[DM_VULKAN_SHADER_PATH_SIZE];
+} dm_vulkan_shader_include;
+
+// file layout is the header, include_count includes, then the spir-v
+typedef struct dm_vulkan_shader_cache_header_t
+{
+    u32 magic, version;
+    u64 key, spirv_hash;
+    u32 spirv_size, include_count;
+} dm_vulkan_shader_cache_header;
+
+typedef struct dm_vulkan_shader_compile_t
+{
+    dm_context* context;
+
+    dm_vulkan_shader_include includes[DM_VULKAN_SHADER_MAX_INCLUDES];
+    u32                      include_count;
+    bool                     include_overflow;
+} dm_vulkan_shader_compile;
+
+typedef struct dm_vulkan_shader_include_result_t
+{
+    shaderc_include_result result;
+    dm_mapped_file         file;
+    char                   path[DM_VULKAN_SHADER_PATH_SIZE];
+} dm_vulkan_shader_include_result;
+
+static shaderc_include_result dm_vulkan_shader_include_oom = { .content="out of memory", .content_length=13 };
+
+// relative includes resolve against the source's directory, so the same text in two places can compile
+// differently. files only in the mounted archive have no canonical form and keep their archive path
+void dm_vulkan_shader_canonical_path(const char *path, char *canonical, size_t size)
+{
+#ifdef _WIN32
+    if(_fullpath(canonical, path, size)) return;
+#else
+    char resolved[PATH_MAX];
+    if(realpath(path, resolved) && strlen(resolved) < size)
+    {
+        strcpy(canonical, resolved);
+        return;
+    }
+#endif
+    snprintf(canonical, size, "%s", path);
+}
+
+u64 dm_vulkan_shader_cache_key(const char *path, const void *source, size_t size, const char *entry, shaderc_shader_kind kind, const dm_shader_define *defines, u32 define_count, const dm_vulkan_shader_options *options)
+{
+    u32 kind_value = kind;
+
+    char canonical[512];
+    dm_vulkan_shader_canonical_path(path, canonical, sizeof(canonical));
+
+    u64 hash = dm_hash_fnv1a(source, size);
+    hash = dm_hash_fnv1a_ex(canonical, strlen(canonical), hash);
+    hash = dm_hash_fnv1a_ex(entry, strlen(entry), hash);
+    hash = dm_hash_fnv1a_ex(&kind_value, sizeof(kind_value), hash);
+    hash = dm_vulkan_hash_shader_defines(defines, define_count, hash);
+
+    return dm_hash_fnv1a_ex(options, sizeof(dm_vulkan_shader_options), hash);
+}
+
+void dm_vulkan_shader_cache_path(u64 key, char *path, size_t size)
+{
+    snprintf(path, size, "%s/%016llx.spv", DM_CACHE_DIRECTORY, (unsigned long long)key);
+}
+
+// "..." includes are relative to the including file, <...> ones to the working directory
+shaderc_include_result* dm_vulkan_shader_include_resolve(void *user_data, const char *requested_source, int type, const char *requesting_source, size_t include_depth)
+{
+    dm_vulkan_shader_compile *compile = user_data;
+
+    dm_vulkan_shader_include_result *include = calloc(1, sizeof(dm_vulkan_shader_include_result));
+    if(!include) return &dm_vulkan_shader_include_oom;
+    include->result.user_data = include;
+
+    int directory_length = 0;
+    if(type == shaderc_include_type_relative)
+    {
+        const char *slash = strrchr(requesting_source, '/');
+        const char *backslash = strrchr(requesting_source, '\\');
+        if(backslash > slash) slash = backslash;
+        if(slash) directory_length = slash - requesting_source + 1;
+    }
+
+    int length = snprintf(include->path, sizeof(include->path), "%.*s%s", directory_length, requesting_source, requested_source);
+    if(length < 0 || length >= (int)sizeof(include->path))
+    {
+        include->result.content = "include path is too long";
+        include->result.content_length = strlen(include->result.content);
+        return &include->result;
     }
 
-    //
-    heap.buffer       = buffer;
-    heap.allocation   = allocation;
-    heap.start        = start;
-    heap.size         = size;
-    heap.buffer_size  = buffer_size;
-    heap.image_size   = image_size;
-    heap.image_offset = image_offset;
+    // runs inside shaderc with a compiler (and maybe its lock) held, helping with jobs here could
+    // start another compile on this thread
+    if(!dm_asset_map_ex(compile->context, include->path, true, &include->file))
+    {
+        include->result.content = "could not open include";
+        include->result.content_length = strlen(include->result.content);
+        return &include->result;
+    }
 
-    return heap;
+    include->result.source_name        = include->path;
+    include->result.source_name_length = length;
+    include->result.content            = include->file.data ? include->file.data : "";
+    include->result.content_length     = include->file.size;
+
+    // include guards make the same file show up more than once
+    for(u32 i=0; i<compile->include_count; i++)
+    {
+        if(!strcmp(compile->includes[i].path, include->path)) return &include->result;
+    }
+
+    if(compile->include_count == DM_VULKAN_SHADER_MAX_INCLUDES)
+    {
+        compile->include_overflow = true;
+        return &include->result;
+    }
+
+    dm_vulkan_shader_include *record = &compile->includes[compile->include_count++];
+    record->hash = dm_hash_fnv1a(include->file.data, include->file.size);
+    memcpy(record->path, include->path, sizeof(record->path));
+
+    return &include->result;
 }
 
-dm_vulkan_sampler_descriptor_heap dm_vulkan_create_sampler_descriptor_heap(VkDevice device, VmaAllocator allocator, VkPhysicalDeviceDescriptorHeapPropertiesEXT heap_props)
+void dm_vulkan_shader_include_release(void *user_data, shaderc_include_result *result)
 {
-    dm_vulkan_sampler_descriptor_heap heap = { 0 };
+    if(result == &dm_vulkan_shader_include_oom) return;
 
-    VkBuffer buffer = VK_NULL_HANDLE;
-    VmaAllocation allocation = VK_NULL_HANDLE;
-    void *start = NULL;
+    dm_vulkan_shader_include_result *include = result->user_data;
+    dm_file_unmap(&include->file);
+    free(include);
+}
 
-    size_t size = 0;
-    size_t sampler_size;
+bool dm_vulkan_shader_cache_validate(dm_context *context, dm_mapped_file file, u64 key)
+{
+    const u8 *base = file.data;
+    const dm_vulkan_shader_cache_header *header = file.data;
 
-    sampler_size = DM_ALIGN(heap_props.samplerDescriptorSize, heap_props.samplerDescriptorAlignment);
+    if(file.size < sizeof(dm_vulkan_shader_cache_header)) return false;
+    if(header->magic != DM_VULKAN_SHADER_CACHE_MAGIC || header->version != DM_VULKAN_SHADER_CACHE_VERSION || header->key != key) return false;
+    if(header->include_count > DM_VULKAN_SHADER_MAX_INCLUDES) return false;
 
-    size += sampler_size * DM_MAX_SAMPLERS;
-    size += heap_props.minSamplerHeapReservedRange;
-    size = DM_ALIGN(size, heap_props.samplerHeapAlignment);
-    LOG_DEBUG("Sampler descriptor size: %u", sampler_size);
-    LOG_DEBUG("Sampler descriptor heap alignment: %u", heap_props.samplerHeapAlignment);
+    size_t spirv_offset = sizeof(dm_vulkan_shader_cache_header) + header->include_count * sizeof(dm_vulkan_shader_include);
+    if(!header->spirv_size || header->spirv_size % 4 || spirv_offset + header->spirv_size != file.size) return false;
 
-    assert(size);
+    const u32 *spirv = (const u32*)(base + spirv_offset);
+    if(spirv[0] != DM_VULKAN_SPIRV_MAGIC || dm_hash_fnv1a(spirv, header->spirv_size) != header->spirv_hash) return false;
 
-    VkBufferUsageFlags usage = VK_BUFFER_USAGE_DESCRIPTOR_HEAP_BIT_EXT;
-    usage |= VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
-    usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    const dm_vulkan_shader_include *includes = (const dm_vulkan_shader_include*)(base + sizeof(dm_vulkan_shader_cache_header));
+    for(u32 i=0; i<header->include_count; i++)
+    {
+        dm_vulkan_shader_include include = includes[i];
+        include.path[DM_VULKAN_SHADER_PATH_SIZE - 1] = 0;
 
-    if(!dm_vulkan_create_buffer(allocator, usage, VMA_ALLOCATION_CREATE_MAPPED_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, &buffer, &allocation, size)) return heap;
+        if(!dm_archive_find(&context->archive, include.path) && !dm_file_exists(include.path)) return false;
 
-    if(!dm_vulkan_decode_vr(vmaMapMemory(allocator, allocation, &start)))
+        dm_mapped_file include_file;
+        if(!dm_asset_map(context, include.path, &include_file)) return false;
+
+        bool match = dm_hash_fnv1a(include_file.data, include_file.size) == include.hash;
+        dm_file_unmap(&include_file);
+
+        if(!match) return false;
+    }
+
+    return true;
+}
+
+bool dm_vulkan_shader_cache_load(dm_context *context, u64 key, dm_vulkan_spirv *spirv)
+{
+    char path[512];
+    dm_vulkan_shader_cache_path(key, path, sizeof(path));
+    if(!dm_file_exists(path)) return false;
+
+    dm_mapped_file file;
+    if(!dm_file_map(path, &file)) return false;
+
+    bool result = false;
+    if(dm_vulkan_shader_cache_validate(context, file, key))
     {
-        LOG_ERROR("vmaMapMemory failed");
-        return heap;
+        const dm_vulkan_shader_cache_header *header = file.data;
+        size_t spirv_offset = file.size - header->spirv_size;
+
+        result = dm_vulkan_spirv_copy((const u8*)file.data + spirv_offset, header->spirv_size, spirv);
+    }
+    else
+    {
+        LOG_INFO("Shader cache entry %s is stale", path);
     }
 
-    //
-    heap.buffer       = buffer;
-    heap.allocation   = allocation;
-    heap.start        = start;
-    heap.size         = size;
-    heap.sampler_size = sampler_size;
+    dm_file_unmap(&file);
 
-    return heap;
+    return result;
+}
+
+void dm_vulkan_shader_cache_store(u64 key, const dm_vulkan_shader_compile *compile, const void *spirv, size_t spirv_size)
+{
+    // can't tell if the entry is stale later, so don't write it
+    if(compile->include_overflow) return;
+
+    size_t includes_size = compile->include_count * sizeof(dm_vulkan_shader_include);
+    size_t size = sizeof(dm_vulkan_shader_cache_header) + includes_size + spirv_size;
+
+    u8 *data = malloc(size);
+    if(!data) return;
+
+    dm_vulkan_shader_cache_header header = {
+        .magic=DM_VULKAN_SHADER_CACHE_MAGIC,
+        .version=DM_VULKAN_SHADER_CACHE_VERSION,
+        .key=key,
+        .spirv_hash=dm_hash_fnv1a(spirv, spirv_size),
+        .spirv_size=spirv_size,
+        .include_count=compile->include_count
+    };
+
+    memcpy(data, &header, sizeof(header));
+    memcpy(data + sizeof(header), compile->includes, includes_size);
+    memcpy(data + sizeof(header) + includes_size, spirv, spirv_size);
+
+    char path[512];
+    dm_vulkan_shader_cache_path(key, path, sizeof(path));
+    if(!dm_write_bytes(path, data, size)) LOG_WARN("Could not write shader cache entry %s", path);
+
+    free(data);
+}
+
+/******************
+ * SHADER COMPILER
+ ******************/
+bool dm_vulkan_create_shader_compilers(dm_context *context, dm_vulkan_renderer *renderer)
+{
+    const dm_vulkan_shader_options *options = &dm_vulkan_default_shader_options;
+
+    dm_mutex_init(&renderer->shader_compiler_lock);
+
+    for(u32 i=0; i<context->jobs.worker_count + 1; i++)
+    {
+        dm_vulkan_shader_compiler *compiler = &renderer->shader_compilers[i];
+
+        compiler->compiler = shaderc_compiler_initialize();
+        compiler->options  = shaderc_compile_options_initialize();
+        if(!compiler->compiler || !compiler->options)
+        {
+            if(compiler->options) shaderc_compile_options_release(compiler->options);
+            if(compiler->compiler) shaderc_compiler_release(compiler->compiler);
+            return false;
+        }
+        renderer->shader_compiler_count++;
+
+        shaderc_compile_options_set_target_env(compiler->options, options->target_env, options->env_version);
+        shaderc_compile_options_set_target_spirv(compiler->options, options->spirv_version);
+        shaderc_compile_options_set_optimization_level(compiler->options, options->optimization_level);
+        if(options->debug_info) shaderc_compile_options_set_generate_debug_info(compiler->options);
+    }
+
+    return true;
+}
+
+// safe to call from any thread, workers compile in parallel with their own compiler
+bool dm_vulkan_compile_spirv(dm_context *context, const char *path, const char *entry, shaderc_shader_kind kind, const dm_shader_define *defines, u32 define_count, dm_vulkan_spirv *spirv)
+{
+    dm_vulkan_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
+    const dm_vulkan_shader_options *options = &dm_vulkan_default_shader_options;
+
+    dm_mapped_file file;
+    if(!dm_asset_map(context, path, &file)) return false;
+
+    u64 key = dm_vulkan_shader_cache_key(path, file.data, file.size, entry, kind, defines, define_count, options);
+
+    if(dm_vulkan_shader_cache_load(context, key, spirv))
+    {
+        LOG_INFO("Loaded shader for file %s with entry %s from cache", path, entry);
+        dm_file_unmap(&file);
+        return true;
+    }
+
+    LOG_INFO("Compiling shader from file %s with entry %s", path, entry);
+
+    dm_vulkan_shader_compile compile = { .context=context };
+
+    u32 thread_index = dm_job_get_thread_index();
+    dm_vulkan_shader_compiler *compiler = &renderer->shader_compilers[thread_index];
+    if(!thread_index) dm_mutex_lock(&renderer->shader_compiler_lock);
+
+    // macros can't be taken back out of an options object, so variants compile with a copy
+    shaderc_compile_options_t compile_options = define_count ? shaderc_compile_options_clone(compiler->options) : compiler->options;
+    if(!compile_options)
+    {
+        if(!thread_index) dm_mutex_unlock(&renderer->shader_compiler_lock);
+        dm_file_unmap(&file);
+        LOG_ERROR("Could not clone shader compile options");
+        return false;
+    }
+
+    for(u32 i=0; i<define_count; i++)
+    {
+        const dm_shader_define *define = &defines[i];
+        shaderc_compile_options_add_macro_definition(compile_options, define->name, strnlen(define->name, sizeof(define->name)), define->value, strnlen(define->value, sizeof(define->value)));
+    }
+
+    shaderc_compile_options_set_include_callbacks(compile_options, dm_vulkan_shader_include_resolve, dm_vulkan_shader_include_release, &compile);
+    shaderc_compilation_result_t result = shaderc_compile_into_spv(compiler->compiler, file.data, file.size, kind, path, entry, compile_options);
+
+    if(compile_options != compiler->options) shaderc_compile_options_release(compile_options);
+    if(!thread_index) dm_mutex_unlock(&renderer->shader_compiler_lock);
+    dm_file_unmap(&file);
+    if(shaderc_result_get_compilation_status(result) != shaderc_compilation_status_success)
+    {
+        LOG_ERROR("Could not compile shader \'%s\'", path);
+        LOG_ERROR("%s", shaderc_result_get_error_message(result));
+        shaderc_result_release(result);
+        return false;
+    }
+
+    const void *code = shaderc_result_get_bytes(result);
+    size_t code_size = shaderc_result_get_length(result);
+    assert(code_size % 4 == 0);
+
+    dm_vulkan_shader_cache_store(key, &compile, code, code_size);
+    bool success = dm_vulkan_spirv_copy(code, code_size, spirv);
+
+    shaderc_result_release(result);
+
+    return success;
+}
+#endif
+
+// .spv files are loaded as is, anything else is compiled as glsl. either way the result is kept as a variant
+bool dm_vulkan_get_spirv(dm_context *context, const char *path, const char *entry, shaderc_shader_kind kind, const dm_shader_define *defines, u32 define_count, dm_vulkan_spirv *spirv)
+{
+    dm_vulkan_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
+
+    if(define_count > DM_MAX_SHADER_DEFINES)
+    {
+        LOG_ERROR("Shader %s has %u defines, max is %u", path, define_count, DM_MAX_SHADER_DEFINES);
+        return false;
+    }
+
+    u64 key = dm_vulkan_shader_variant_key(path, entry, kind, defines, define_count);
+    if(dm_vulkan_find_shader_variant(renderer, key, spirv)) return true;
+
+    bool result = false;
+
+    size_t length = strlen(path);
+    if(length > 4 && !strcmp(path + length - 4, ".spv"))
+    {
+        if(define_count) LOG_WARN("Defines are ignored for baked shader %s", path);
+        result = dm_vulkan_load_spirv(context, path, spirv);
+    }
+    else
+    {
+#ifdef DM_OFFLINE_SHADERS_ONLY
+        LOG_ERROR("Built without a runtime shader compiler, bake %s with dm_shaderc", path);
+#else
+        result = dm_vulkan_compile_spirv(context, path, entry, kind, defines, define_count, spirv);
+#endif
+    }
+
+    if(result) dm_vulkan_store_shader_variant(renderer, key, spirv);
+
+    return result;
+}
+
+void dm_vulkan_shader_compile_job(void *data)
+{
+    dm_vulkan_shader_request *request = data;
+
+    if(!dm_vulkan_get_spirv(request->context, request->path, request->entry, request->kind, request->defines, request->define_count, &request->spirv)) request->spirv = (dm_vulkan_spirv){ 0 };
+}
+
+// compiles on a job worker, request->spirv is valid once the counter is done.
+// no code means the compile failed
+void dm_vulkan_submit_shader_compile(dm_context *context, dm_vulkan_shader_request *request, dm_job_counter *counter)
+{
+    request->context = context;
+    request->spirv   = (dm_vulkan_spirv){ 0 };
+
+    dm_job_submit(context, dm_vulkan_shader_compile_job, request, counter);
 }
 
 //
@@ -1113,8 +3740,15 @@ bool dm_renderer_init(dm_context* context)
     dm_vulkan_sampler_descriptor_heap  sampler_heap = { 0 };
 
     VkCommandPool single_use_pool    = VK_NULL_HANDLE;
+    VkCommandBuffer single_use_cmd   = VK_NULL_HANDLE;
+    dm_vulkan_staging_ring staging_ring = { 0 };
     VkSemaphore   timeline_semaphore = VK_NULL_HANDLE;
     u64           timeline_value     = DM_FRAMES_IN_FLIGHT - 1;
+
+    dm_arena_marker  cache_marker = dm_arena_get_marker(&context->frame_arenas[0]);
+    dm_io_request   *cache_request;
+    dm_io_ticket     cache_ticket;
+    bool             cache_reading = dm_vulkan_read_pipeline_cache_begin(context, &cache_request, &cache_ticket);
     
     //
     if(volkInitialize() != VK_SUCCESS) return false;
@@ -1133,6 +3767,7 @@ bool dm_renderer_init(dm_context* context)
 
     vkGetDeviceQueue(gpu.device, gpu.gfx_index, 0, &gpu.gfx_queue);
     vkGetDeviceQueue(gpu.device, gpu.compute_index, 0, &gpu.compute_queue);
+    vkGetDeviceQueue(gpu.device, gpu.transfer_index, 0, &gpu.transfer_queue);
 
     allocator = create_vma_allocator(instance, gpu.physical, gpu.device);
     if(allocator == VK_NULL_HANDLE) return false; 
@@ -1152,19 +3787,27 @@ bool dm_renderer_init(dm_context* context)
 
     single_use_pool = dm_vulkan_create_single_use_pool(gpu);
     if(single_use_pool == VK_NULL_HANDLE) { LOG_ERROR("Could not create single use pool."); return false; }
+    single_use_cmd = dm_vulkan_allocate_one_time_cmd(gpu.device, single_use_pool);
+    if(single_use_cmd == VK_NULL_HANDLE) { LOG_ERROR("Could not allocate single use command buffer."); return false; }
+
+    staging_ring = dm_vulkan_create_staging_ring(allocator);
+    if(!staging_ring.mapped) { LOG_ERROR("Could not create staging ring."); return false; }
 
     // timeline semaphore
     timeline_semaphore = dm_vulkan_create_timeline_semaphore(gpu, timeline_value);
     if(timeline_semaphore == VK_NULL_HANDLE) { LOG_ERROR("Could not create timeline semaphore."); return false; }
 
     // resource and smapler heaps
-    resource_heap = dm_vulkan_create_resource_heap(gpu.device, allocator, gpu.heap_props);
+    resource_heap = dm_vulkan_create_resource_heap(gpu.device, allocator, gpu.heap_props, context->renderer.limits, &context->arena);
     if(resource_heap.buffer == VK_NULL_HANDLE) { LOG_ERROR("Could not create resource descriptor heap"); return false; }
-    sampler_heap = dm_vulkan_create_sampler_descriptor_heap(gpu.device, allocator, gpu.heap_props);
+    sampler_heap = dm_vulkan_create_sampler_descriptor_heap(gpu.device, allocator, gpu.heap_props, context->renderer.limits, &context->arena);
     if(sampler_heap.buffer == VK_NULL_HANDLE) { LOG_ERROR("Could not create sampler descriptor heap"); return false; }
 
     // assign
     dm_vulkan_renderer* renderer = dm_arena_alloc(&context->arena, sizeof(dm_vulkan_renderer), &context->renderer.offset);
+    if(!renderer) return false;
+
+    if(!dm_vulkan_create_resource_pools(renderer, context->renderer.limits)) return false;
 
     renderer->instance = instance;
     renderer->allocator = allocator;
@@ -1176,11 +3819,33 @@ bool dm_renderer_init(dm_context* context)
         renderer->frame_data[i] = frame_data[i];
     }
     renderer->single_use_pool = single_use_pool;
+    renderer->single_use_cmd = single_use_cmd;
+    renderer->staging_ring = staging_ring;
     renderer->timeline_semaphore = timeline_semaphore;
     renderer->timeline_value = timeline_value;
     renderer->resource_heap = resource_heap;
     renderer->sampler_heap = sampler_heap;
 
+    if(!dm_vulkan_create_upload_engine(gpu, &renderer->upload)) { LOG_ERROR("Could not create upload engine."); return false; }
+
+    // without it nothing is cached between runs, everything still works
+    dm_directory_create(DM_CACHE_DIRECTORY);
+
+    dm_mutex_init(&renderer->shader_variant_lock);
+
+#ifndef DM_OFFLINE_SHADERS_ONLY
+    if(!dm_vulkan_create_shader_compilers(context, renderer)) { LOG_ERROR("Could not create shader compilers"); return false; }
+#endif
+
+    // pipelines are just created without one if this fails
+    dm_mapped_file cache_file = { 0 };
+    if(cache_reading && dm_io_wait(context, cache_ticket))
+    {
+        cache_file = (dm_mapped_file){ .data=cache_request->buffer, .size=cache_request->size, .source=DM_MAPPED_FILE_SOURCE_BORROWED };
+    }
+    renderer->pipeline_cache = dm_vulkan_create_pipeline_cache(gpu, cache_file);
+    dm_arena_reset_to_marker(&context->frame_arenas[0], cache_marker);
+
     return true;
 }
 
@@ -1191,45 +3856,90 @@ void dm_renderer_shutdown(dm_context* context)
     dm_vulkan_gpu gpu = renderer->gpu;
     dm_vulkan_surface surface = renderer->surface;
 
+    // async builds use the device, the pipeline cache and the shader compilers
+    for(u32 i=0; i<renderer->pipes.count; i++)
+    {
+        dm_vulkan_pipeline *pipeline = dm_pool_get_slot(&renderer->pipes, i);
+        if(pipeline) dm_vulkan_wait_pipeline(context, pipeline);
+    }
+
     vkDeviceWaitIdle(gpu.device);
 
     // resources
-    for(u32 i=0; i<renderer->pipe_count; i++)
+    dm_vulkan_flush_destroy_queue(renderer, UINT64_MAX);
+
+    if(renderer->pipeline_cache)
     {
-        vkDestroyPipeline(gpu.device, renderer->pipes[i].pipeline, NULL);
+        dm_vulkan_save_pipeline_cache(gpu, renderer->pipeline_cache);
+        vkDestroyPipelineCache(gpu.device, renderer->pipeline_cache, DM_VULKAN_ALLOCATOR);
+    }
+
+    for(u32 i=0; i<renderer->pipes.count; i++)
+    {
+        dm_vulkan_pipeline *pipeline = dm_pool_get_slot(&renderer->pipes, i);
+        if(!pipeline) continue;
+
+        dm_vulkan_release_pipeline_objects(renderer, pipeline);
     }
 
-    for(u32 i=0; i<renderer->buffer_count; i++)
+    for(u32 i=0; i<renderer->buffers.count; i++)
     {
-        vmaDestroyBuffer(renderer->allocator, renderer->buffers[i].host, renderer->buffers[i].host_alloc);
-        vmaDestroyBuffer(renderer->allocator, renderer->buffers[i].device, renderer->buffers[i].device_alloc);
+        dm_vulkan_buffer *buffer = dm_pool_get_slot(&renderer->buffers, i);
+        if(!buffer) continue;
+
+        vmaDestroyBuffer(renderer->allocator, buffer->host, buffer->host_alloc);
+        vmaDestroyBuffer(renderer->allocator, buffer->device, buffer->device_alloc);
     }
 
-    for(u32 i=0; i<renderer->image_count; i++)
+    for(u32 i=0; i<renderer->images.count; i++)
     {
-        vmaDestroyImage(renderer->allocator, renderer->images[i].image, renderer->images[i].allocation);
+        dm_vulkan_image *image = dm_pool_get_slot(&renderer->images, i);
+        if(!image) continue;
+
+        vmaDestroyImage(renderer->allocator, image->image, image->allocation);
+        vmaDestroyBuffer(renderer->allocator, image->staging.host, image->staging.host_alloc);
     }
 
+    dm_pool_destroy(&renderer->images);
+    dm_pool_destroy(&renderer->buffers);
+    dm_pool_destroy(&renderer->samplers);
+    dm_pool_destroy(&renderer->pipes);
+    dm_vulkan_pipeline_table_destroy(&renderer->pipeline_table);
+    dm_vulkan_destroy_shader_variants(renderer);
+    dm_pool_destroy(&renderer->rts);
+    dm_arena_detroy(&renderer->destroy_queue);
+
     vmaUnmapMemory(renderer->allocator, renderer->resource_heap.allocation);
     vmaUnmapMemory(renderer->allocator, renderer->sampler_heap.allocation);
     vmaDestroyBuffer(renderer->allocator, renderer->resource_heap.buffer, renderer->resource_heap.allocation);
     vmaDestroyBuffer(renderer->allocator, renderer->sampler_heap.buffer, renderer->sampler_heap.allocation);
+    vmaDestroyBuffer(renderer->allocator, renderer->staging_ring.buffer, renderer->staging_ring.allocation);
 
-    vkDestroyCommandPool(gpu.device, renderer->single_use_pool, NULL);
+    vkDestroyCommandPool(gpu.device, renderer->single_use_pool, DM_VULKAN_ALLOCATOR);
+    dm_vulkan_destroy_upload_engine(gpu.device, &renderer->upload);
     for(u32 i=0; i<DM_FRAMES_IN_FLIGHT; i++)
     {
-        vkDestroyCommandPool(gpu.device, renderer->frame_data[i].gfx_pool, NULL);
-        vkDestroySemaphore(gpu.device, renderer->frame_data[i].semaphore, NULL);
+        vkDestroyCommandPool(gpu.device, renderer->frame_data[i].gfx_pool, DM_VULKAN_ALLOCATOR);
+        vkDestroySemaphore(gpu.device, renderer->frame_data[i].semaphore, DM_VULKAN_ALLOCATOR);
     }
 
     dm_vulkan_destroy_swapchain(&renderer->swapchain, gpu, renderer->allocator);
 
-    vkDestroySemaphore(gpu.device, renderer->timeline_semaphore, NULL);
+    vkDestroySemaphore(gpu.device, renderer->timeline_semaphore, DM_VULKAN_ALLOCATOR);
+
+#ifndef DM_OFFLINE_SHADERS_ONLY
+    for(u32 i=0; i<renderer->shader_compiler_count; i++)
+    {
+        shaderc_compile_options_release(renderer->shader_compilers[i].options);
+        shaderc_compiler_release(renderer->shader_compilers[i].compiler);
+    }
+    dm_mutex_destroy(&renderer->shader_compiler_lock);
+#endif
 
     vkDestroySurfaceKHR(renderer->instance, surface.surface, NULL);
     vmaDestroyAllocator(renderer->allocator);
-    vkDestroyDevice(gpu.device, NULL);
-    vkDestroyInstance(renderer->instance, NULL);
+    vkDestroyDevice(gpu.device, DM_VULKAN_ALLOCATOR);
+    vkDestroyInstance(renderer->instance, DM_VULKAN_ALLOCATOR);
 
     volkFinalize();
 }
@@ -1275,6 +3985,32 @@ size_t dm_renderer_get_internal_size()
     return sizeof(dm_vulkan_renderer);
 }
 
+// bind resource and sampler heaps
+void dm_vulkan_bind_heaps(dm_vulkan_renderer *renderer, VkCommandBuffer cmd)
+{
+    dm_vulkan_resource_descriptor_heap resource_heap = renderer->resource_heap;
+    dm_vulkan_sampler_descriptor_heap  sampler_heap  = renderer->sampler_heap;
+
+    VkBindHeapInfoEXT resource_info = {
+        .sType=VK_STRUCTURE_TYPE_BIND_HEAP_INFO_EXT,
+        .heapRange.size=resource_heap.size,
+        .heapRange.address=dm_vulkan_get_buffer_address(renderer->gpu.device, resource_heap.buffer),
+        .reservedRangeOffset=resource_heap.size - renderer->gpu.heap_props.minResourceHeapReservedRange,
+        .reservedRangeSize=renderer->gpu.heap_props.minResourceHeapReservedRange
+    };
+
+    VkBindHeapInfoEXT sampler_info = {
+        .sType=VK_STRUCTURE_TYPE_BIND_HEAP_INFO_EXT,
+        .heapRange.size=sampler_heap.size,
+        .heapRange.address=dm_vulkan_get_buffer_address(renderer->gpu.device, sampler_heap.buffer),
+        .reservedRangeOffset=sampler_heap.size - renderer->gpu.heap_props.minSamplerHeapReservedRange,
+        .reservedRangeSize=renderer->gpu.heap_props.minSamplerHeapReservedRange
+    };
+
+    vkCmdBindResourceHeapEXT(cmd, &resource_info);
+    vkCmdBindSamplerHeapEXT(cmd, &sampler_info);
+}
+
 bool dm_renderer_begin_frame(dm_context* context)
 {
     dm_vulkan_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
@@ -1283,6 +4019,10 @@ bool dm_renderer_begin_frame(dm_context* context)
     dm_vulkan_swapchain swapchain = renderer->swapchain;
     dm_vulkan_frame_data frame_data = renderer->frame_data[renderer->frame_index];
 
+    // uploads recorded since the last frame start copying while this one is recorded,
+    // before the timeline moves on so overwrites only wait for frames already submitted
+    dm_vulkan_upload_flush(renderer);
+
     u64 wait_value = ++renderer->timeline_value;
     wait_value -= DM_FRAMES_IN_FLIGHT;
     VkSemaphoreWaitInfo wait_info = {
@@ -1293,8 +4033,19 @@ bool dm_renderer_begin_frame(dm_context* context)
     };
     vkWaitSemaphores(gpu.device, &wait_info, UINT64_MAX);
 
+    if(renderer->destroy_count)
+    {
+        u64 completed_value = 0;
+        vkGetSemaphoreCounterValue(gpu.device, renderer->timeline_semaphore, &completed_value);
+        dm_vulkan_flush_destroy_queue(renderer, completed_value);
+    }
+
     vkResetCommandPool(gpu.device, frame_data.gfx_pool, 0);
 
+    // the wait above means the gpu is done reading this frame's staging slice
+    renderer->staging_ring.offset = (VkDeviceSize)renderer->frame_index * DM_VULKAN_STAGING_FRAME_SIZE;
+    renderer->staging_ring.end    = renderer->staging_ring.offset + DM_VULKAN_STAGING_FRAME_SIZE;
+
     VkResult vr = vkAcquireNextImageKHR(gpu.device, swapchain.swapchain, UINT64_MAX, frame_data.semaphore, VK_NULL_HANDLE, &swapchain.index);
 
     if(vr == VK_ERROR_OUT_OF_DATE_KHR)
@@ -1320,31 +4071,12 @@ bool dm_renderer_begin_frame(dm_context* context)
     };
     vkBeginCommandBuffer(frame_data.gfx_cmd, &cmd_begin);
 
-    // bind resource and sampler heaps
-    dm_vulkan_resource_descriptor_heap resource_heap = renderer->resource_heap;
-    dm_vulkan_sampler_descriptor_heap  sampler_heap  = renderer->sampler_heap;
-
-    VkBindHeapInfoEXT resource_info = {
-        .sType=VK_STRUCTURE_TYPE_BIND_HEAP_INFO_EXT,
-        .heapRange.size=resource_heap.size,
-        .heapRange.address=dm_vulkan_get_buffer_address(renderer->gpu.device, resource_heap.buffer),
-        .reservedRangeOffset=resource_heap.size - renderer->gpu.heap_props.minResourceHeapReservedRange,
-        .reservedRangeSize=renderer->gpu.heap_props.minResourceHeapReservedRange
-    };
-
-    VkBindHeapInfoEXT sampler_info = {
-        .sType=VK_STRUCTURE_TYPE_BIND_HEAP_INFO_EXT,
-        .heapRange.size=sampler_heap.size,
-        .heapRange.address=dm_vulkan_get_buffer_address(renderer->gpu.device, sampler_heap.buffer),
-        .reservedRangeOffset=sampler_heap.size - renderer->gpu.heap_props.minSamplerHeapReservedRange,
-        .reservedRangeSize=renderer->gpu.heap_props.minSamplerHeapReservedRange
-    };
-
-    vkCmdBindResourceHeapEXT(frame_data.gfx_cmd, &resource_info);
-    vkCmdBindSamplerHeapEXT(frame_data.gfx_cmd, &sampler_info);
+    dm_vulkan_bind_heaps(renderer, frame_data.gfx_cmd);
+    dm_vulkan_upload_acquire(renderer, frame_data.gfx_cmd);
 
     //
     renderer->swapchain = swapchain;
+    renderer->frame_active = true;
     
     return true;
 }
@@ -1357,6 +4089,9 @@ bool dm_renderer_end_frame(dm_context* context)
     dm_vulkan_frame_data frame_data = renderer->frame_data[renderer->frame_index];
     dm_vulkan_swapchain_image image = renderer->swapchain.images[renderer->swapchain.index];
 
+    // updates since the last pass still have to land for the next frame
+    dm_vulkan_flush_dirty_buffers(renderer, frame_data.gfx_cmd);
+
     VkImageMemoryBarrier2 present_barrier = {
         .sType=VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
         .srcStageMask=VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
@@ -1370,8 +4105,18 @@ bool dm_renderer_end_frame(dm_context* context)
         .subresourceRange.layerCount=1,
         .subresourceRange.levelCount=1
     };
+    // readback buffers are read on the host once the frame is done
+    VkMemoryBarrier2 host_barrier = {
+        .sType=VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask=VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .srcAccessMask=VK_ACCESS_2_MEMORY_WRITE_BIT,
+        .dstStageMask=VK_PIPELINE_STAGE_2_HOST_BIT,
+        .dstAccessMask=VK_ACCESS_2_HOST_READ_BIT
+    };
     VkDependencyInfo present_dep_info = {
         .sType=VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount=1,
+        .pMemoryBarriers=&host_barrier,
         .imageMemoryBarrierCount=1,
         .pImageMemoryBarriers=&present_barrier
     };
@@ -1379,10 +4124,21 @@ bool dm_renderer_end_frame(dm_context* context)
 
     vkEndCommandBuffer(frame_data.gfx_cmd);
 
-    VkSemaphoreSubmitInfo semaphore_wait_info = {
-        .sType=VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
-        .semaphore=frame_data.semaphore,
-        .stageMask=VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT
+    // everything acquired this frame was released by a batch up to here
+    dm_vulkan_upload_flush(renderer);
+
+    VkSemaphoreSubmitInfo semaphore_wait_infos[] = {
+        {
+            .sType=VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+            .semaphore=frame_data.semaphore,
+            .stageMask=VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT
+        },
+        {
+            .sType=VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+            .semaphore=renderer->upload.semaphore,
+            .stageMask=VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+            .value=renderer->upload.value
+        },
     };
 
     VkSemaphoreSubmitInfo signal_semaphores[] = {
@@ -1408,8 +4164,8 @@ bool dm_renderer_end_frame(dm_context* context)
         .sType=VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
         .commandBufferInfoCount=1,
         .pCommandBufferInfos=&gfx_cmd_submit,
-        .waitSemaphoreInfoCount=1,
-        .pWaitSemaphoreInfos=&semaphore_wait_info,
+        .waitSemaphoreInfoCount=2,
+        .pWaitSemaphoreInfos=semaphore_wait_infos,
         .signalSemaphoreInfoCount=2,
         .pSignalSemaphoreInfos=signal_semaphores
     };
@@ -1426,71 +4182,18 @@ bool dm_renderer_end_frame(dm_context* context)
 
     vkQueuePresentKHR(gpu.gfx_queue, &present_info);
 
-    //
-    renderer->frame_index++;
-    renderer->frame_index %= DM_FRAMES_IN_FLIGHT;
-    context->renderer.current_frame = renderer->frame_index;
-
-    renderer->active_pipeline.type = DM_PIPELINE_TYPE_INVALID;
-
-    return true;
-}
-
-// resources
-VkShaderModule dm_vulkan_create_shader_module(dm_vulkan_gpu gpu, const char *path, const char *entry, shaderc_shader_kind kind)
-{
-    LOG_INFO("Creating shader module from file %s with entry %s", path, entry);
-    VkShaderModule module = VK_NULL_HANDLE;
-
-    size_t file_size;
-    void *file_data = dm_read_bytes(path, &file_size);
-    if(!file_data) 
-    {
-        LOG_ERROR("Could not read file: %s", path);
-        return VK_NULL_HANDLE;
-    }
-
-    shaderc_compiler_t compiler       = shaderc_compiler_initialize();
-    shaderc_compile_options_t options = shaderc_compile_options_initialize();
-    shaderc_compilation_result_t result;
-
-    shaderc_compile_options_set_target_env(options, shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_4);
-    shaderc_compile_options_set_target_spirv(options, shaderc_spirv_version_1_6);
-    shaderc_compile_options_set_optimization_level(options, shaderc_optimization_level_zero);
-    shaderc_compile_options_set_generate_debug_info(options);
-
-    result = shaderc_compile_into_spv(compiler, file_data, file_size, kind, path, entry, options);
-    if(shaderc_result_get_compilation_status(result) != shaderc_compilation_status_success)
-    {
-        LOG_ERROR("Could not compile shader \'%s\'", path);
-        LOG_ERROR("%s", shaderc_result_get_error_message(result));
-        return VK_NULL_HANDLE;
-    }
-    free(file_data);
-
-    assert(shaderc_result_get_length(result) % 4 == 0);
-
-    VkShaderModuleCreateInfo info = {
-        .sType=VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-        .codeSize=shaderc_result_get_length(result),
-        .pCode=(u32*)shaderc_result_get_bytes(result)
-    };
-
-    LOG_DEBUG("Shader size: %u bytes", info.codeSize);
-
-    if(!dm_vulkan_decode_vr(vkCreateShaderModule(gpu.device, &info, NULL, &module)))
-    {
-        LOG_ERROR("vkCreateShaderModule failed");
-        return VK_NULL_HANDLE;
-    }
+    //
+    renderer->frame_index++;
+    renderer->frame_index %= DM_FRAMES_IN_FLIGHT;
+    context->renderer.current_frame = renderer->frame_index;
 
-    shaderc_result_release(result);
-    shaderc_compile_options_release(options);
-    shaderc_compiler_release(compiler);
+    renderer->active_pipeline.type = DM_PIPELINE_TYPE_INVALID;
+    renderer->frame_active = false;
 
-    return module;
+    return true;
 }
 
+// resources
 VkBlendOp dm_convert_blend_op(dm_blend_op op)
 {
     switch(op)
@@ -1527,44 +4230,95 @@ VkBlendFactor dm_convert_blend_factor(dm_blend_factor factor)
     }
 }
 
-bool dm_renderer_create_raster_pipeline(dm_context* context, dm_raster_pipe_desc desc, dm_pipeline *handle)
+VkCullModeFlags dm_convert_cull_mode(dm_cull_mode mode)
 {
-    dm_vulkan_renderer* renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
-
-    dm_vulkan_pipeline pipe = { 0 };
-
-    dm_raster_shader vertex_shader = desc.shaders[DM_RASTER_SHADER_STAGE_VERTEX];
-    dm_raster_shader fragment_shader = desc.shaders[DM_RASTER_SHADER_STAGE_FRAGMENT];
-
-    char vertex_path[512];
-    sprintf(vertex_path, "%s.glsl", vertex_shader.path);
-    char fragment_path[512];
-    sprintf(fragment_path, "%s.glsl", fragment_shader.path);
+    switch(mode)
+    {
+        default:
+            LOG_WARN("Unknown/unsupported cull mode");
+            LOG_WARN("Returning VK_CULL_MODE_BACK_BIT");
+        case DM_CULL_MODE_BACK:
+            return VK_CULL_MODE_BACK_BIT;
+        case DM_CULL_MODE_NONE:
+            return VK_CULL_MODE_NONE;
+        case DM_CULL_MODE_FRONT:
+            return VK_CULL_MODE_FRONT_BIT;
+    }
+}
 
-    VkShaderModule vertex_module = dm_vulkan_create_shader_module(renderer->gpu, vertex_path, "main", shaderc_vertex_shader);
-    if(vertex_module == VK_NULL_HANDLE)
+VkPrimitiveTopology dm_convert_primitive_topology(dm_primitive_topology topology)
+{
+    switch(topology)
     {
-        LOG_ERROR("Could not create vertex shader module");
-        return false;
+        default:
+            LOG_WARN("Unknown/unsupported primitive topology");
+            LOG_WARN("Returning VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST");
+        case DM_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST:
+            return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        case DM_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP:
+            return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+        case DM_PRIMITIVE_TOPOLOGY_LINE_LIST:
+            return VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+        case DM_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+            return VK_PRIMITIVE_TOPOLOGY_LINE_STRIP;
+        case DM_PRIMITIVE_TOPOLOGY_POINT_LIST:
+            return VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
     }
-    VkShaderModule fragment_module = dm_vulkan_create_shader_module(renderer->gpu, fragment_path, "main", shaderc_fragment_shader);
-    if(fragment_module == VK_NULL_HANDLE)
+}
+
+VkColorBlendEquationEXT dm_convert_blend_equation(bool blend, dm_blend_op color_op, dm_blend_factor color_src, dm_blend_factor color_dst, dm_blend_op alpha_op, dm_blend_factor alpha_src, dm_blend_factor alpha_dst)
+{
+    // what a pipeline with blending off leaves in its attachment
+    if(!blend)
     {
-        LOG_ERROR("Could not create fragment shader module");
-        return false;
+        return (VkColorBlendEquationEXT){
+            .colorBlendOp=VK_BLEND_OP_ADD,
+            .srcColorBlendFactor=VK_BLEND_FACTOR_ONE,
+            .dstColorBlendFactor=VK_BLEND_FACTOR_ZERO,
+            .alphaBlendOp=VK_BLEND_OP_ADD,
+            .srcAlphaBlendFactor=VK_BLEND_FACTOR_ONE,
+            .dstAlphaBlendFactor=VK_BLEND_FACTOR_ZERO
+        };
     }
 
+    return (VkColorBlendEquationEXT){
+        .colorBlendOp=dm_convert_blend_op(color_op),
+        .srcColorBlendFactor=dm_convert_blend_factor(color_src),
+        .dstColorBlendFactor=dm_convert_blend_factor(color_dst),
+        .alphaBlendOp=dm_convert_blend_op(alpha_op),
+        .srcAlphaBlendFactor=dm_convert_blend_factor(alpha_src),
+        .dstAlphaBlendFactor=dm_convert_blend_factor(alpha_dst)
+    };
+}
+
+// shader modules are chained straight into the stage infos (VK_KHR_maintenance5)
+bool dm_vulkan_create_raster_pipeline(dm_vulkan_renderer *renderer, dm_raster_pipe_desc desc, const dm_vulkan_spirv *spirv, VkPipeline *pipeline)
+{
+    const char *vertex_entry   = desc.shaders[DM_RASTER_SHADER_STAGE_VERTEX].entry[0] ? desc.shaders[DM_RASTER_SHADER_STAGE_VERTEX].entry : "main";
+    const char *fragment_entry = desc.shaders[DM_RASTER_SHADER_STAGE_FRAGMENT].entry[0] ? desc.shaders[DM_RASTER_SHADER_STAGE_FRAGMENT].entry : "main";
+
+    VkShaderModuleCreateInfo vertex_module_info = {
+        .sType=VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .codeSize=spirv[DM_RASTER_SHADER_STAGE_VERTEX].size,
+        .pCode=spirv[DM_RASTER_SHADER_STAGE_VERTEX].code
+    };
+    VkShaderModuleCreateInfo fragment_module_info = {
+        .sType=VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .codeSize=spirv[DM_RASTER_SHADER_STAGE_FRAGMENT].size,
+        .pCode=spirv[DM_RASTER_SHADER_STAGE_FRAGMENT].code
+    };
+
     VkPipelineShaderStageCreateInfo vertex_info = {
         .sType=VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-        .module=vertex_module,
+        .pNext=&vertex_module_info,
         .stage=VK_SHADER_STAGE_VERTEX_BIT,
-        .pName="main"
+        .pName=vertex_entry
     };
     VkPipelineShaderStageCreateInfo fragment_info = {
         .sType=VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-        .module=fragment_module,
+        .pNext=&fragment_module_info,
         .stage=VK_SHADER_STAGE_FRAGMENT_BIT,
-        .pName="main"
+        .pName=fragment_entry
     };
     VkPipelineShaderStageCreateInfo shader_info[] = {
         vertex_info,
@@ -1627,13 +4381,21 @@ bool dm_renderer_create_raster_pipeline(dm_context* context, dm_raster_pipe_desc
         .pAttachments=&color_attachment_info
     };
 
+    // the fixed values above for these are only what the driver compiles against,
+    // dm_vulkan_reset_raster_state sets the real ones on every bind
     VkDynamicState dynamic_state[] = {
         VK_DYNAMIC_STATE_VIEWPORT,
-        VK_DYNAMIC_STATE_SCISSOR
+        VK_DYNAMIC_STATE_SCISSOR,
+        VK_DYNAMIC_STATE_CULL_MODE,
+        VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY,
+        VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE,
+        VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE,
+        VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT,
+        VK_DYNAMIC_STATE_COLOR_BLEND_EQUATION_EXT
     };
     VkPipelineDynamicStateCreateInfo dynamic_state_info = {
         .sType=VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
-        .dynamicStateCount=2,
+        .dynamicStateCount=renderer->gpu.extensions.extended_dynamic_state3 ? 8 : 6,
         .pDynamicStates=dynamic_state
     };
 
@@ -1665,20 +4427,184 @@ bool dm_renderer_create_raster_pipeline(dm_context* context, dm_raster_pipe_desc
         .pNext=&render_info,
     };
 
-    if(!dm_vulkan_decode_vr(vkCreateGraphicsPipelines(renderer->gpu.device, NULL, 1, &pipeline_info, NULL, &pipe.pipeline)))
+    if(!dm_vulkan_create_pipeline(renderer, &pipeline_info, &flags2, pipeline))
     {
         LOG_ERROR("vkCreateGraphicsPipelines failed");
         return false;
     }
 
-    //
-    vkDestroyShaderModule(renderer->gpu.device, vertex_module, NULL);
-    vkDestroyShaderModule(renderer->gpu.device, fragment_module, NULL);
+    return true;
+}
 
-    //
-    renderer->pipes[renderer->pipe_count] = pipe;
-    handle->index = renderer->pipe_count++;
-    handle->type = DM_PIPELINE_TYPE_RASTER;
+/****************
+ * SHADER OBJECT
+ ****************/
+// with VK_EXT_shader_object raster pipelines are just linked vertex and fragment shaders,
+// everything a VkPipeline would bake in is set dynamically when they are bound
+bool dm_vulkan_create_raster_shaders(dm_vulkan_renderer *renderer, dm_raster_pipe_desc desc, const dm_vulkan_spirv *spirv, dm_vulkan_pipeline *pipeline)
+{
+    const char *vertex_entry   = desc.shaders[DM_RASTER_SHADER_STAGE_VERTEX].entry[0] ? desc.shaders[DM_RASTER_SHADER_STAGE_VERTEX].entry : "main";
+    const char *fragment_entry = desc.shaders[DM_RASTER_SHADER_STAGE_FRAGMENT].entry[0] ? desc.shaders[DM_RASTER_SHADER_STAGE_FRAGMENT].entry : "main";
+
+    VkShaderCreateInfoEXT infos[DM_RASTER_SHADER_STAGE_MAX] = {
+        [DM_RASTER_SHADER_STAGE_VERTEX] = {
+            .sType=VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT,
+            .flags=VK_SHADER_CREATE_LINK_STAGE_BIT_EXT | VK_SHADER_CREATE_DESCRIPTOR_HEAP_BIT_EXT,
+            .stage=VK_SHADER_STAGE_VERTEX_BIT,
+            .nextStage=VK_SHADER_STAGE_FRAGMENT_BIT,
+            .codeType=VK_SHADER_CODE_TYPE_SPIRV_EXT,
+            .codeSize=spirv[DM_RASTER_SHADER_STAGE_VERTEX].size,
+            .pCode=spirv[DM_RASTER_SHADER_STAGE_VERTEX].code,
+            .pName=vertex_entry
+        },
+        [DM_RASTER_SHADER_STAGE_FRAGMENT] = {
+            .sType=VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT,
+            .flags=VK_SHADER_CREATE_LINK_STAGE_BIT_EXT | VK_SHADER_CREATE_DESCRIPTOR_HEAP_BIT_EXT,
+            .stage=VK_SHADER_STAGE_FRAGMENT_BIT,
+            .codeType=VK_SHADER_CODE_TYPE_SPIRV_EXT,
+            .codeSize=spirv[DM_RASTER_SHADER_STAGE_FRAGMENT].size,
+            .pCode=spirv[DM_RASTER_SHADER_STAGE_FRAGMENT].code,
+            .pName=fragment_entry
+        }
+    };
+
+    if(!dm_vulkan_decode_vr(vkCreateShadersEXT(renderer->gpu.device, DM_RASTER_SHADER_STAGE_MAX, infos, DM_VULKAN_ALLOCATOR, pipeline->shaders)))
+    {
+        LOG_ERROR("vkCreateShadersEXT failed");
+
+        // some may have been created before the failing one
+        for(u32 i=0; i<DM_RASTER_SHADER_STAGE_MAX; i++)
+        {
+            vkDestroyShaderEXT(renderer->gpu.device, pipeline->shaders[i], DM_VULKAN_ALLOCATOR);
+            pipeline->shaders[i] = VK_NULL_HANDLE;
+        }
+        return false;
+    }
+
+    return true;
+}
+
+bool dm_vulkan_has_dynamic_blend(dm_vulkan_renderer *renderer)
+{
+    return renderer->gpu.extensions.shader_object || renderer->gpu.extensions.extended_dynamic_state3;
+}
+
+// what dm_render_command_set_* can change, back to the defaults in dm_vulkan_create_raster_pipeline
+void dm_vulkan_reset_raster_state(dm_vulkan_renderer *renderer, VkCommandBuffer cmd, dm_vulkan_pipeline *pipeline)
+{
+    vkCmdSetPrimitiveTopology(cmd, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    vkCmdSetCullMode(cmd, VK_CULL_MODE_BACK_BIT);
+    vkCmdSetDepthTestEnable(cmd, VK_TRUE);
+    vkCmdSetDepthWriteEnable(cmd, VK_TRUE);
+
+    if(!dm_vulkan_has_dynamic_blend(renderer)) return;
+
+    vkCmdSetColorBlendEnableEXT(cmd, 0, 1, &pipeline->blend);
+    vkCmdSetColorBlendEquationEXT(cmd, 0, 1, &pipeline->blend_equation);
+}
+
+// matches the fixed state in dm_vulkan_create_raster_pipeline
+void dm_vulkan_bind_raster_shaders(dm_vulkan_renderer *renderer, VkCommandBuffer cmd, dm_vulkan_pipeline *pipeline)
+{
+    VkShaderStageFlagBits stages[DM_RASTER_SHADER_STAGE_MAX] = { VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_FRAGMENT_BIT };
+    vkCmdBindShadersEXT(cmd, DM_RASTER_SHADER_STAGE_MAX, stages, pipeline->shaders);
+
+    vkCmdSetVertexInputEXT(cmd, 0, NULL, 0, NULL);
+    vkCmdSetPrimitiveRestartEnable(cmd, VK_FALSE);
+
+    vkCmdSetRasterizerDiscardEnable(cmd, VK_FALSE);
+    vkCmdSetPolygonModeEXT(cmd, VK_POLYGON_MODE_FILL);
+    vkCmdSetFrontFace(cmd, VK_FRONT_FACE_COUNTER_CLOCKWISE);
+    vkCmdSetDepthBiasEnable(cmd, VK_FALSE);
+
+    VkSampleMask sample_mask = ~0u;
+    vkCmdSetRasterizationSamplesEXT(cmd, VK_SAMPLE_COUNT_1_BIT);
+    vkCmdSetSampleMaskEXT(cmd, VK_SAMPLE_COUNT_1_BIT, &sample_mask);
+    vkCmdSetAlphaToCoverageEnableEXT(cmd, VK_FALSE);
+
+    vkCmdSetDepthCompareOp(cmd, VK_COMPARE_OP_LESS_OR_EQUAL);
+    vkCmdSetDepthBoundsTestEnable(cmd, VK_FALSE);
+    vkCmdSetStencilTestEnable(cmd, VK_FALSE);
+
+    VkColorComponentFlags write_mask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    vkCmdSetColorWriteMaskEXT(cmd, 0, 1, &write_mask);
+
+    dm_vulkan_reset_raster_state(renderer, cmd, pipeline);
+}
+
+// safe to call from the job workers
+bool dm_vulkan_build_raster_pipeline(dm_context* context, dm_raster_pipe_desc desc, dm_vulkan_pipeline *pipeline)
+{
+    dm_vulkan_renderer* renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
+
+    dm_raster_shader vertex_shader = desc.shaders[DM_RASTER_SHADER_STAGE_VERTEX];
+    dm_raster_shader fragment_shader = desc.shaders[DM_RASTER_SHADER_STAGE_FRAGMENT];
+
+    char vertex_path[512];
+    dm_vulkan_get_shader_path(context, vertex_shader.path, vertex_shader.define_count, vertex_path, sizeof(vertex_path));
+    char fragment_path[512];
+    dm_vulkan_get_shader_path(context, fragment_shader.path, fragment_shader.define_count, fragment_path, sizeof(fragment_path));
+
+    // both stages compile at the same time
+    dm_vulkan_shader_request vertex_request = {
+        .path=vertex_path,
+        .entry=vertex_shader.entry[0] ? vertex_shader.entry : "main",
+        .kind=shaderc_vertex_shader,
+        .defines=vertex_shader.defines,
+        .define_count=vertex_shader.define_count
+    };
+    dm_vulkan_shader_request fragment_request = {
+        .path=fragment_path,
+        .entry=fragment_shader.entry[0] ? fragment_shader.entry : "main",
+        .kind=shaderc_fragment_shader,
+        .defines=fragment_shader.defines,
+        .define_count=fragment_shader.define_count
+    };
+    dm_job_counter counter = { 0 };
+
+    dm_vulkan_submit_shader_compile(context, &vertex_request, &counter);
+    dm_vulkan_submit_shader_compile(context, &fragment_request, &counter);
+    dm_job_wait(context, &counter);
+
+    dm_vulkan_spirv spirv[DM_RASTER_SHADER_STAGE_MAX] = {
+        [DM_RASTER_SHADER_STAGE_VERTEX]=vertex_request.spirv,
+        [DM_RASTER_SHADER_STAGE_FRAGMENT]=fragment_request.spirv
+    };
+
+    bool result = spirv[DM_RASTER_SHADER_STAGE_VERTEX].code && spirv[DM_RASTER_SHADER_STAGE_FRAGMENT].code;
+    if(!spirv[DM_RASTER_SHADER_STAGE_VERTEX].code) LOG_ERROR("Could not compile vertex shader");
+    if(!spirv[DM_RASTER_SHADER_STAGE_FRAGMENT].code) LOG_ERROR("Could not compile fragment shader");
+
+    pipeline->blend          = desc.blend;
+    pipeline->blend_equation = dm_convert_blend_equation(desc.blend, desc.color_blend_op, desc.color_src_factor, desc.color_dst_factor, desc.alpha_blend_op, desc.alpha_src_factor, desc.alpha_dst_factor);
+
+    if(result && renderer->gpu.extensions.shader_object) result = dm_vulkan_create_raster_shaders(renderer, desc, spirv, pipeline);
+    else if(result)                                      result = dm_vulkan_create_raster_pipeline(renderer, desc, spirv, &pipeline->pipeline);
+
+    for(u32 i=0; i<DM_RASTER_SHADER_STAGE_MAX; i++)
+    {
+        dm_vulkan_spirv_free(&spirv[i]);
+    }
+
+    return result;
+}
+
+bool dm_renderer_create_raster_pipeline(dm_context* context, dm_raster_pipe_desc desc, dm_pipeline *handle)
+{
+    dm_vulkan_renderer* renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
+
+    u64 hash = dm_vulkan_hash_raster_desc(renderer, &desc);
+    if(dm_vulkan_acquire_ready_pipeline(context, hash, handle)) return true;
+
+    dm_vulkan_pipeline pipe = { .status=DM_PIPELINE_STATUS_READY, .hash=hash };
+
+    if(!dm_vulkan_build_raster_pipeline(context, desc, &pipe)) return false;
+
+    if(!dm_vulkan_add_pipeline(renderer, pipe, DM_PIPELINE_TYPE_RASTER, handle))
+    {
+        dm_vulkan_release_pipeline_objects(renderer, &pipe);
+        return false;
+    }
 
     return true;
 }
@@ -1728,9 +4654,14 @@ bool dm_renderer_create_render_target(dm_context* context, dm_render_target_desc
         .depth=desc.depth
     };
 
-    renderer->rts[renderer->rt_count] = target;
-    handle->index = renderer->rt_count++;
-    handle->type = DM_RESOURCE_TYPE_RENDER_TARGET;
+    u32 index, generation;
+    dm_vulkan_render_target *slot = dm_pool_alloc(&renderer->rts, &index, &generation);
+    if(!slot) return false;
+
+    *slot = target;
+    handle->type       = DM_RESOURCE_TYPE_RENDER_TARGET;
+    handle->index      = index;
+    handle->generation = generation;
 
     return true;
 }
@@ -1751,6 +4682,7 @@ bool dm_vulkan_create_descriptor_heap(VmaAllocator allocator, size_t size, VkBuf
     if(!dm_vulkan_decode_vr(vmaCreateBuffer(allocator, &buffer_info, &alloc_info, buffer, allocation, NULL)))
     {
         LOG_ERROR("vmaCreateBuffer failed");
+        dm_mem_record_failed(DM_MEM_TAG_GPU_HOST);
         return false;
     }
 
@@ -1763,45 +4695,6 @@ bool dm_vulkan_create_descriptor_heap(VmaAllocator allocator, size_t size, VkBuf
     return true;
 }
 
-VkCommandBuffer dm_vulkan_one_time_cmd(VkDevice device, VkCommandPool pool)
-{
-    VkCommandBuffer cmd = VK_NULL_HANDLE;
-
-    VkCommandBufferAllocateInfo cmd_alloc = {
-        .sType=VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .commandBufferCount=1,
-        .commandPool=pool,
-        .level=VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-    };
-    if(!dm_vulkan_decode_vr(vkAllocateCommandBuffers(device, &cmd_alloc, &cmd)))
-    {
-        LOG_ERROR("vkAllocateCommandBuffers failed");
-        return VK_NULL_HANDLE;
-    }
-
-    VkCommandBufferBeginInfo begin_info = {
-        .sType=VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        .flags=VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
-    };
-    vkBeginCommandBuffer(cmd, &begin_info);
-
-    return cmd;
-}
-
-void dm_vulkan_submit_one_time_cmd(VkDevice device, VkQueue queue, VkCommandPool pool, VkCommandBuffer cmd)
-{
-    VkSubmitInfo submit_info = {
-        .sType=VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .commandBufferCount=1,
-        .pCommandBuffers=&cmd
-    };
-
-    vkEndCommandBuffer(cmd);
-    vkQueueSubmit(queue, 1, &submit_info, NULL);
-    vkQueueWaitIdle(queue);
-    vkFreeCommandBuffers(device, pool, 1, &cmd);
-}
-
 bool dm_vulkan_copy_to_buffer(VmaAllocator allocator, dm_vulkan_buffer buffer, void *data, size_t size)
 {
     void* buffer_ptr = NULL;
@@ -1823,15 +4716,12 @@ bool dm_renderer_create_buffer(dm_context* context, dm_buffer_desc desc, dm_reso
 {
     dm_vulkan_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
 
-    if(renderer->buffer_count >= DM_MAX_BUFFERS)
+    dm_vulkan_buffer buffer = { .type=desc.type, .usage=desc.usage };
+    for(u32 i=0; i<DM_FRAMES_IN_FLIGHT; i++)
     {
-        LOG_ERROR("Trying to create too many bufers");
-        LOG_ERROR("Increase compile time limit");
-        return false;
+        buffer.heap_indices[i] = DM_VULKAN_INVALID_HEAP_INDEX;
     }
 
-    dm_vulkan_buffer buffer = { .type=desc.type };
-
     VkBufferUsageFlags host_usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
     VmaAllocationCreateFlags host_flags = 
         VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
@@ -1861,151 +4751,186 @@ bool dm_renderer_create_buffer(dm_context* context, dm_buffer_desc desc, dm_reso
             return false;
     }
 
-    if(!dm_vulkan_create_buffer(renderer->allocator, host_usage, host_flags, host_mem_usage, &buffer.host, &buffer.host_alloc, desc.size)) return false;
-    if(!dm_vulkan_create_buffer(renderer->allocator, device_usage, device_flags, device_mem_usage, &buffer.device, &buffer.device_alloc, desc.size)) return false;
+    switch(desc.usage)
+    {
+        // device local, initial data goes through a host buffer that is freed once uploaded.
+        // stream buffers are the ones expected to be updated every frame through the staging ring
+        case DM_BUFFER_USAGE_STATIC:
+        case DM_BUFFER_USAGE_STREAM:
+            break;
+
+        // written by the cpu every frame, one copy per frame in flight so a submitted frame's copy is never touched.
+        // vma takes host visible device local memory when there is some (rebar, uma) and system memory otherwise
+        case DM_BUFFER_USAGE_DYNAMIC:
+            device_flags = 
+                VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+                VMA_ALLOCATION_CREATE_MAPPED_BIT;
+            device_mem_usage = VMA_MEMORY_USAGE_AUTO;
+            break;
 
-    // copy over data if needed
-    if(desc.data)
+        // host cached, reading uncached memory back is slow
+        case DM_BUFFER_USAGE_READBACK:
+            device_flags = 
+                VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT |
+                VMA_ALLOCATION_CREATE_MAPPED_BIT;
+            device_mem_usage = VMA_MEMORY_USAGE_AUTO;
+            break;
+
+        default:
+            LOG_ERROR("Unknown/unsupported buffer usage");
+            return false;
+    }
+
+    const dm_archive_entry *asset = NULL;
+    if(desc.asset)
     {
-        if(!dm_vulkan_copy_to_buffer(renderer->allocator, buffer, desc.data, desc.size)) return false;
+        asset = dm_archive_find(&context->archive, desc.asset);
+        if(!asset)
+        {
+            LOG_ERROR("Asset is not in the mounted archive: %s", desc.asset);
+            return false;
+        }
 
-        VkCommandBuffer cmd = dm_vulkan_one_time_cmd(renderer->gpu.device, renderer->single_use_pool);
+        if(!desc.size) desc.size = asset->size;
+        if(desc.size < asset->size)
+        {
+            LOG_ERROR("Buffer is too small for asset: %s", desc.asset);
+            return false;
+        }
+    }
 
-        VkBufferCopy2 region_info = {
-            .sType=VK_STRUCTURE_TYPE_BUFFER_COPY_2,
-            .size=desc.size
-        };
+    buffer.size   = desc.size;
+    buffer.stride = desc.size;
+    if(desc.usage == DM_BUFFER_USAGE_DYNAMIC) buffer.stride = DM_ALIGN(desc.size, renderer->gpu.properties.limits.minStorageBufferOffsetAlignment);
 
-        VkCopyBufferInfo2 copy_info = {
-            .sType=VK_STRUCTURE_TYPE_COPY_BUFFER_INFO_2,
-            .srcBuffer=buffer.host,
-            .dstBuffer=buffer.device,
-            .regionCount=1,
-            .pRegions=&region_info
-        };
+    if(!dm_vulkan_create_buffer(renderer->allocator, device_usage, device_flags, device_mem_usage, &buffer.device, &buffer.device_alloc, buffer.stride * dm_vulkan_buffer_copy_count(&buffer))) return false;
 
-        vkCmdCopyBuffer2(cmd, &copy_info);
+    if(device_flags & VMA_ALLOCATION_CREATE_MAPPED_BIT)
+    {
+        VmaAllocationInfo info;
+        vmaGetAllocationInfo(renderer->allocator, buffer.device_alloc, &info);
 
-        dm_vulkan_submit_one_time_cmd(renderer->gpu.device, renderer->gpu.gfx_queue, renderer->single_use_pool, cmd);
+        buffer.mapped = info.pMappedData;
+    }
+    else if((desc.data || asset) && !dm_vulkan_create_buffer(renderer->allocator, host_usage, host_flags, host_mem_usage, &buffer.host, &buffer.host_alloc, desc.size))
+    {
+        vmaDestroyBuffer(renderer->allocator, buffer.device, buffer.device_alloc);
+        return false;
     }
 
-    buffer.size = desc.size;
+    VmaAllocation write_alloc = buffer.mapped ? buffer.device_alloc : buffer.host_alloc;
 
-    //
-    renderer->buffers[renderer->buffer_count] = buffer;
-    handle->type = DM_RESOURCE_TYPE_BUFFER;
-    handle->index  = renderer->buffer_count++;
+    // assets are decoded by the job workers straight into the persistently mapped staging memory
+    if(asset)
+    {
+        VmaAllocationInfo info;
+        vmaGetAllocationInfo(renderer->allocator, write_alloc, &info);
 
-    return true;
-}
+        dm_archive_read read;
+        if(!info.pMappedData || !dm_archive_read_begin(context, &context->archive, asset, info.pMappedData, &read) || !dm_archive_read_wait(context, &read))
+        {
+            LOG_ERROR("Could not decode asset: %s", desc.asset);
+            vmaDestroyBuffer(renderer->allocator, buffer.host, buffer.host_alloc);
+            vmaDestroyBuffer(renderer->allocator, buffer.device, buffer.device_alloc);
+            return false;
+        }
 
-u64 dm_renderer_get_buffer_address(dm_context *context, dm_resource handle)
-{
-    dm_vulkan_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
+        vmaFlushAllocation(renderer->allocator, write_alloc, 0, VK_WHOLE_SIZE);
+    }
 
-    dm_vulkan_buffer buffer = renderer->buffers[handle.index];
+    // nothing to copy when the cpu writes the device buffer itself, every frame's copy starts out the same
+    if(buffer.mapped && (desc.data || asset))
+    {
+        if(desc.data) memcpy(buffer.mapped, desc.data, desc.size);
+        for(u32 i=1; i<dm_vulkan_buffer_copy_count(&buffer); i++)
+        {
+            memcpy(buffer.mapped + i * buffer.stride, buffer.mapped, desc.size);
+        }
 
-    return dm_vulkan_get_buffer_address(renderer->gpu.device, buffer.device);
-}
+        vmaFlushAllocation(renderer->allocator, buffer.device_alloc, 0, VK_WHOLE_SIZE);
+    }
+    else if(desc.data || asset)
+    {
+        if(desc.data && !dm_vulkan_copy_to_buffer(renderer->allocator, buffer, desc.data, desc.size))
+        {
+            vmaDestroyBuffer(renderer->allocator, buffer.host, buffer.host_alloc);
+            vmaDestroyBuffer(renderer->allocator, buffer.device, buffer.device_alloc);
+            return false;
+        }
 
-bool dm_vulkan_create_image(VmaAllocator allocator, VkImageUsageFlags usage, VkFormat format, u16 width, u16 height, VkImage *image, VmaAllocation *allocation)
-{
-    VkImageCreateInfo image_info = {
-        .sType=VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-        .imageType=VK_IMAGE_TYPE_2D,
-        .format=format,
-        .extent.width=width,
-        .extent.height=height,
-        .extent.depth=1,
-        .mipLevels=1,
-        .arrayLayers=1,
-        .samples=VK_SAMPLE_COUNT_1_BIT,
-        .tiling=VK_IMAGE_TILING_OPTIMAL,
-        .usage=usage,
-        .initialLayout=VK_IMAGE_LAYOUT_UNDEFINED
-    };
-    VmaAllocationCreateInfo alloc_info = {
-        .usage=VMA_MEMORY_USAGE_AUTO,
-    };
+        dm_vulkan_upload_buffer(renderer, &buffer, desc.size);
 
-    if(dm_vulkan_decode_vr(vmaCreateImage(allocator, &image_info, &alloc_info, image, allocation, NULL))) return true;
+        // the host buffer only carried the initial data, it goes once the upload landed
+        dm_vulkan_deferred_destroy entry = DM_VULKAN_DEFERRED_DESTROY_INIT;
+        entry.buffers[0]       = buffer.host;
+        entry.buffer_allocs[0] = buffer.host_alloc;
+        dm_vulkan_defer_destroy(renderer, entry);
 
-    LOG_ERROR("vmaCreateImage failed");
-    return false;
-}
+        buffer.host       = VK_NULL_HANDLE;
+        buffer.host_alloc = NULL;
+    }
 
-void dm_vulkan_copy_buffer_to_image(dm_vulkan_gpu gpu, VkCommandPool pool, VkImage image, VkBuffer buffer, u16 width, u16 height)
-{
-    VkCommandBuffer cmd = dm_vulkan_one_time_cmd(gpu.device, pool);
+    //
+    u32 index, generation;
+    dm_vulkan_buffer *slot = dm_pool_alloc(&renderer->buffers, &index, &generation);
+    if(!slot)
+    {
+        vmaDestroyBuffer(renderer->allocator, buffer.host, buffer.host_alloc);
+        vmaDestroyBuffer(renderer->allocator, buffer.device, buffer.device_alloc);
+        return false;
+    }
 
-    // transition image to transfer dst
-    VkImageMemoryBarrier2 dst_barrier = {
-        .sType=VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-        .srcStageMask=VK_PIPELINE_STAGE_2_NONE,
-        .srcAccessMask=VK_ACCESS_2_NONE,
-        .dstStageMask=VK_PIPELINE_STAGE_2_COPY_BIT,
-        .dstAccessMask=VK_ACCESS_2_TRANSFER_WRITE_BIT,
-        .oldLayout=VK_IMAGE_LAYOUT_UNDEFINED,
-        .newLayout=VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        .image=image,
-        .subresourceRange.aspectMask=VK_IMAGE_ASPECT_COLOR_BIT,
-        .subresourceRange.layerCount=1,
-        .subresourceRange.levelCount=1
-    };
-    VkDependencyInfo dst_dep = {
-        .sType=VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
-        .imageMemoryBarrierCount=1,
-        .pImageMemoryBarriers=&dst_barrier
-    };
-    vkCmdPipelineBarrier2(cmd, &dst_dep);
+    *slot = buffer;
+    handle->type       = DM_RESOURCE_TYPE_BUFFER;
+    handle->index      = index;
+    handle->generation = generation;
 
-    // copy from buffer to texture
-    VkBufferImageCopy image_copy = {
-        .imageSubresource.aspectMask=VK_IMAGE_ASPECT_COLOR_BIT,
-        .imageSubresource.layerCount=1,
-        .imageExtent.width=width,
-        .imageExtent.height=height,
-        .imageExtent.depth=1
-    };
+    return true;
+}
+
+u64 dm_renderer_get_buffer_address(dm_context *context, dm_resource handle)
+{
+    dm_vulkan_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
 
-    vkCmdCopyBufferToImage(cmd, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &image_copy);
+    dm_vulkan_buffer *buffer = dm_vulkan_get_buffer(renderer, handle);
+    if(!buffer) return 0;
 
-    // transition to read/sample
-    VkImageMemoryBarrier2 post_barrier = {
-        .sType=VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-        .srcStageMask=VK_PIPELINE_STAGE_2_COPY_BIT,
-        .srcAccessMask=VK_ACCESS_2_TRANSFER_WRITE_BIT,
-        .dstStageMask=VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT,
-        .dstAccessMask=VK_ACCESS_2_SHADER_READ_BIT,
-        .oldLayout=VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        .newLayout=VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-        .image=image,
-        .subresourceRange.aspectMask=VK_IMAGE_ASPECT_COLOR_BIT,
-        .subresourceRange.layerCount=1,
-        .subresourceRange.levelCount=1
+    // dynamic buffers move to another copy every frame
+    return dm_vulkan_get_buffer_address(renderer->gpu.device, buffer->device) + dm_vulkan_buffer_copy(renderer, buffer) * buffer->stride;
+}
+
+bool dm_vulkan_create_image(VmaAllocator allocator, VkImageUsageFlags usage, VkFormat format, u16 width, u16 height, VkImage *image, VmaAllocation *allocation)
+{
+    VkImageCreateInfo image_info = {
+        .sType=VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType=VK_IMAGE_TYPE_2D,
+        .format=format,
+        .extent.width=width,
+        .extent.height=height,
+        .extent.depth=1,
+        .mipLevels=1,
+        .arrayLayers=1,
+        .samples=VK_SAMPLE_COUNT_1_BIT,
+        .tiling=VK_IMAGE_TILING_OPTIMAL,
+        .usage=usage,
+        .initialLayout=VK_IMAGE_LAYOUT_UNDEFINED
     };
-    VkDependencyInfo post_dep = {
-        .sType=VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
-        .imageMemoryBarrierCount=1,
-        .pImageMemoryBarriers=&post_barrier
+    VmaAllocationCreateInfo alloc_info = {
+        .usage=VMA_MEMORY_USAGE_AUTO,
     };
-    vkCmdPipelineBarrier2(cmd, &post_dep);
 
-    dm_vulkan_submit_one_time_cmd(gpu.device, gpu.gfx_queue, pool, cmd);
+    if(dm_vulkan_decode_vr(vmaCreateImage(allocator, &image_info, &alloc_info, image, allocation, NULL))) return true;
+
+    LOG_ERROR("vmaCreateImage failed");
+    dm_mem_record_failed(DM_MEM_TAG_GPU_DEVICE);
+    return false;
 }
 
 bool dm_renderer_create_texture(dm_context *context, dm_texture2d_desc desc, dm_resource *handle)
 {
     dm_vulkan_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
 
-    if(renderer->image_count >= DM_MAX_TEXTURES)
-    {
-        LOG_ERROR("Trying to create too many textures");
-        LOG_ERROR("Increase compile time limit");
-        return false;
-    }
-
-    dm_vulkan_image image = { 0 };
+    dm_vulkan_image image = { .heap_index=DM_VULKAN_INVALID_HEAP_INDEX };
 
     VkImageUsageFlags usage       = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
     VmaMemoryUsage    alloc_usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
@@ -2034,29 +4959,37 @@ bool dm_renderer_create_texture(dm_context *context, dm_texture2d_desc desc, dm_
 
     image.usage  = usage;
 
-    dm_vulkan_buffer staging_buffer = { .size=desc.size };
+    dm_vulkan_buffer *staging_buffer = &image.staging;
+    staging_buffer->size = desc.size;
 
     VkBufferUsageFlags buffer_usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
 
-    if(!dm_vulkan_create_buffer(renderer->allocator, buffer_usage, 0, VMA_MEMORY_USAGE_CPU_TO_GPU, &staging_buffer.host, &staging_buffer.host_alloc, desc.size)) return false;
-
-    renderer->buffers[renderer->buffer_count]= staging_buffer;
-    image.buffer_index = renderer->buffer_count++;
+    if(!dm_vulkan_create_buffer(renderer->allocator, buffer_usage, 0, VMA_MEMORY_USAGE_CPU_TO_GPU, &staging_buffer->host, &staging_buffer->host_alloc, desc.size)) return false;
 
     if(desc.data)
     {
-        if(!dm_vulkan_copy_to_buffer(renderer->allocator, staging_buffer, desc.data, desc.size)) return false;
+        if(!dm_vulkan_copy_to_buffer(renderer->allocator, *staging_buffer, desc.data, desc.size)) return false;
 
-        dm_vulkan_copy_buffer_to_image(renderer->gpu, renderer->single_use_pool, image.image, staging_buffer.host, desc.width, desc.height);
+        dm_vulkan_upload_image(renderer, &image, desc.width, desc.height, false);
     }
 
     image.width  = desc.width;
     image.height = desc.height;
 
     // 
-    renderer->images[renderer->image_count] = image;
-    handle->type = DM_RESOURCE_TYPE_TEXTURE;
-    handle->index  = renderer->image_count++;
+    u32 index, generation;
+    dm_vulkan_image *slot = dm_pool_alloc(&renderer->images, &index, &generation);
+    if(!slot)
+    {
+        vmaDestroyImage(renderer->allocator, image.image, image.allocation);
+        vmaDestroyBuffer(renderer->allocator, staging_buffer->host, staging_buffer->host_alloc);
+        return false;
+    }
+
+    *slot = image;
+    handle->type       = DM_RESOURCE_TYPE_TEXTURE;
+    handle->index      = index;
+    handle->generation = generation;
 
     return true;
 }
@@ -2065,13 +4998,6 @@ bool dm_renderer_create_sampler(dm_context *context, dm_sampler_desc desc, dm_re
 {
     dm_vulkan_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
 
-    if(renderer->sampler_count >= DM_MAX_SAMPLERS)
-    {
-        LOG_ERROR("Trying to create too many samplers");
-        LOG_ERROR("Increase compile time limit");
-        return false;
-    }
-
     VkSamplerCreateInfo info = {
         .sType        = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
         .magFilter    = VK_FILTER_LINEAR,
@@ -2083,13 +5009,29 @@ bool dm_renderer_create_sampler(dm_context *context, dm_sampler_desc desc, dm_re
         .maxLod       = VK_LOD_CLAMP_NONE,
     };
 
-    renderer->samplers[renderer->sampler_count].info = info;
-    handle->type = DM_RESOURCE_TYPE_SAMPLER;
-    handle->index = renderer->sampler_count++;
+    u32 index, generation;
+    dm_vulkan_sampler *sampler = dm_pool_alloc(&renderer->samplers, &index, &generation);
+    if(!sampler) return false;
+
+    sampler->info       = info;
+    sampler->heap_index = DM_VULKAN_INVALID_HEAP_INDEX;
+
+    handle->type       = DM_RESOURCE_TYPE_SAMPLER;
+    handle->index      = index;
+    handle->generation = generation;
 
     return true;
 }
 
+// reuses a released heap slot if there is one
+u32 dm_vulkan_acquire_heap_slot(u32 *free_slots, u32 *free_count, size_t *count, size_t max)
+{
+    if(*free_count) return free_slots[--(*free_count)];
+    if(*count >= max) return DM_VULKAN_INVALID_HEAP_INDEX;
+
+    return (*count)++;
+}
+
 bool dm_renderer_upload_resources_to_heap(dm_context *context, dm_resource *resources[], u32 count)
 {
     dm_vulkan_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
@@ -2097,109 +5039,278 @@ bool dm_renderer_upload_resources_to_heap(dm_context *context, dm_resource *reso
     dm_vulkan_resource_descriptor_heap *resource_heap = &renderer->resource_heap;
     dm_vulkan_sampler_descriptor_heap  *sampler_heap  = &renderer->sampler_heap;
 
-    VkResourceDescriptorInfoEXT resource_info[DM_MAX_RESOURCES * DM_FRAMES_IN_FLIGHT] = { 0 };
-    VkHostAddressRangeEXT       host_info[DM_MAX_RESOURCES * DM_FRAMES_IN_FLIGHT]     = { 0 };
-    VkDeviceAddressRangeKHR     addresses[DM_MAX_BUFFERS * DM_FRAMES_IN_FLIGHT]       = { 0 };
-    VkImageDescriptorInfoEXT    image_info[DM_MAX_TEXTURES * DM_FRAMES_IN_FLIGHT]     = { 0 };
-    VkImageViewCreateInfo       view_info[DM_MAX_TEXTURES * DM_FRAMES_IN_FLIGHT]      = { 0 };
+    // descriptor infos only live until the descriptors are written, so use frame scratch memory
+    dm_arena *scratch = &context->frame_arenas[context->renderer.current_frame];
+    dm_arena_marker marker = dm_arena_get_marker(scratch);
 
-    VkSamplerCreateInfo   sampler_infos[DM_MAX_SAMPLERS]      = { 0 };
-    VkHostAddressRangeEXT sampler_host_infos[DM_MAX_SAMPLERS] = { 0 };
+    // dynamic buffers write a descriptor per copy
+    VkResourceDescriptorInfoEXT *resource_info = dm_arena_alloc(scratch, sizeof(VkResourceDescriptorInfoEXT) * count * DM_FRAMES_IN_FLIGHT, NULL);
+    VkHostAddressRangeEXT       *host_info     = dm_arena_alloc(scratch, sizeof(VkHostAddressRangeEXT) * count * DM_FRAMES_IN_FLIGHT, NULL);
+    VkDeviceAddressRangeKHR     *addresses     = dm_arena_alloc(scratch, sizeof(VkDeviceAddressRangeKHR) * count * DM_FRAMES_IN_FLIGHT, NULL);
+    VkImageDescriptorInfoEXT    *image_info    = dm_arena_alloc(scratch, sizeof(VkImageDescriptorInfoEXT) * count, NULL);
+    VkImageViewCreateInfo       *view_info     = dm_arena_alloc(scratch, sizeof(VkImageViewCreateInfo) * count, NULL);
+
+    VkSamplerCreateInfo   *sampler_infos      = dm_arena_alloc(scratch, sizeof(VkSamplerCreateInfo) * count, NULL);
+    VkHostAddressRangeEXT *sampler_host_infos = dm_arena_alloc(scratch, sizeof(VkHostAddressRangeEXT) * count, NULL);
+
+    if(!resource_info || !host_info || !addresses || !image_info || !view_info || !sampler_infos || !sampler_host_infos)
+    {
+        LOG_ERROR("Could not allocate scratch memory for descriptor upload");
+        dm_arena_reset_to_marker(scratch, marker);
+        return false;
+    }
 
-    u32 buffer_count = 0;
-    u32 image_count  = 0;
+    u32 resource_count = 0;
+    u32 sampler_count  = 0;
+    u32 buffer_count   = 0;
+    u32 image_count    = 0;
     size_t image_index_offset = resource_heap->image_offset / gpu.heap_props.imageDescriptorSize;
-    size_t buffer_offset  = 0;
-    size_t image_offset   = resource_heap->image_offset;
-    size_t sampler_offset = 0;
 
-    for(u32 i=0; i<count; i++)
+    bool result = true;
+
+    for(u32 i=0; i<count && result; i++)
     {
         dm_resource *resource = resources[i];
 
-        dm_vulkan_buffer *buffer;
-        dm_vulkan_image  *image;
+        dm_vulkan_buffer  *buffer;
+        dm_vulkan_image   *image;
+        dm_vulkan_sampler *sampler;
+        u32 image_slot;
         
-        buffer_count = resource_heap->buffer_count;
-        image_count  = resource_heap->image_count;
-
-        u32 resource_count = resource_heap->count;
-        u32 sampler_count  = sampler_heap->count;
-
         switch(resource->type)
         {
             case DM_RESOURCE_TYPE_BUFFER:
-                buffer = &renderer->buffers[resource->index]; 
-
-                addresses[buffer_count].address = dm_vulkan_get_buffer_address(gpu.device, buffer->device);
-                addresses[buffer_count].size    = buffer->size;
-                
-                resource_info[resource_count].sType              = VK_STRUCTURE_TYPE_RESOURCE_DESCRIPTOR_INFO_EXT;
-                resource_info[resource_count].type               = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-                resource_info[resource_count].data.pAddressRange = &addresses[buffer_count];
-
-                host_info[resource_count].address = (u8*)resource_heap->start + buffer_offset;
-                host_info[resource_count].size    = resource_heap->buffer_size;
-
-                buffer->heap_index = resource_heap->buffer_count++;
-                buffer_offset += resource_heap->buffer_size;
-                resource_heap->count++;
+                buffer = dm_vulkan_get_buffer(renderer, *resource);
+                if(!buffer) { result = false; break; }
+
+                for(u32 j=0; j<dm_vulkan_buffer_copy_count(buffer); j++)
+                {
+                    if(buffer->heap_indices[j] == DM_VULKAN_INVALID_HEAP_INDEX) 
+                        buffer->heap_indices[j] = dm_vulkan_acquire_heap_slot(resource_heap->free_buffers, &resource_heap->free_buffer_count, &resource_heap->buffer_count, resource_heap->max_buffers);
+                    if(buffer->heap_indices[j] == DM_VULKAN_INVALID_HEAP_INDEX)
+                    {
+                        LOG_ERROR("Resource heap is out of buffer descriptors");
+                        result = false;
+                        break;
+                    }
+
+                    addresses[buffer_count] = (VkDeviceAddressRangeKHR){
+                        .address=dm_vulkan_get_buffer_address(gpu.device, buffer->device) + j * buffer->stride,
+                        .size=buffer->size
+                    };
+                    
+                    resource_info[resource_count] = (VkResourceDescriptorInfoEXT){
+                        .sType=VK_STRUCTURE_TYPE_RESOURCE_DESCRIPTOR_INFO_EXT,
+                        .type=VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                        .data.pAddressRange=&addresses[buffer_count]
+                    };
+
+                    host_info[resource_count] = (VkHostAddressRangeEXT){
+                        .address=(u8*)resource_heap->start + buffer->heap_indices[j] * resource_heap->buffer_size,
+                        .size=resource_heap->buffer_size
+                    };
+
+                    buffer_count++;
+                    resource_count++;
+                }
                 break;
 
             case DM_RESOURCE_TYPE_TEXTURE:
-                image = &renderer->images[resource->index];
-
-                view_info[image_count].sType    = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-                view_info[image_count].viewType = VK_IMAGE_VIEW_TYPE_2D;
-                view_info[image_count].image    = image->image;
-                view_info[image_count].format   = image->format;
-                view_info[image_count].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                view_info[image_count].subresourceRange.layerCount = 1;
-                view_info[image_count].subresourceRange.levelCount = 1;
-
-                image_info[image_count].sType  = VK_STRUCTURE_TYPE_IMAGE_DESCRIPTOR_INFO_EXT;
-                image_info[image_count].layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                image_info[image_count].pView  = &view_info[image_count];
+                image = dm_vulkan_get_image(renderer, *resource);
+                if(!image) { result = false; break; }
+
+                if(image->heap_index == DM_VULKAN_INVALID_HEAP_INDEX)
+                {
+                    image_slot = dm_vulkan_acquire_heap_slot(resource_heap->free_images, &resource_heap->free_image_count, &resource_heap->image_count, resource_heap->max_images);
+                    if(image_slot == DM_VULKAN_INVALID_HEAP_INDEX)
+                    {
+                        LOG_ERROR("Resource heap is out of image descriptors");
+                        result = false;
+                        break;
+                    }
+                }
+                else image_slot = image->heap_index - image_index_offset;
+
+                view_info[image_count] = (VkImageViewCreateInfo){
+                    .sType=VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+                    .viewType=VK_IMAGE_VIEW_TYPE_2D,
+                    .image=image->image,
+                    .format=image->format,
+                    .subresourceRange.aspectMask=VK_IMAGE_ASPECT_COLOR_BIT,
+                    .subresourceRange.layerCount=1,
+                    .subresourceRange.levelCount=1
+                };
+
+                image_info[image_count] = (VkImageDescriptorInfoEXT){
+                    .sType=VK_STRUCTURE_TYPE_IMAGE_DESCRIPTOR_INFO_EXT,
+                    .layout=VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    .pView=&view_info[image_count]
+                };
                 
-                resource_info[resource_count].sType = VK_STRUCTURE_TYPE_RESOURCE_DESCRIPTOR_INFO_EXT;
-                resource_info[resource_count].type  = image->type;
-                resource_info[resource_count].data.pImage = &image_info[image_count];
-
-                host_info[resource_count].address = (u8*)resource_heap->start + image_offset;
-                host_info[resource_count].size    = resource_heap->image_size;
-
-                image_offset += resource_heap->image_size;
-
-                image->heap_index  = resource_heap->image_count++;
-                image->heap_index += image_index_offset;
+                resource_info[resource_count] = (VkResourceDescriptorInfoEXT){
+                    .sType=VK_STRUCTURE_TYPE_RESOURCE_DESCRIPTOR_INFO_EXT,
+                    .type=image->type,
+                    .data.pImage=&image_info[image_count]
+                };
+
+                host_info[resource_count] = (VkHostAddressRangeEXT){
+                    .address=(u8*)resource_heap->start + resource_heap->image_offset + image_slot * resource_heap->image_size,
+                    .size=resource_heap->image_size
+                };
+
+                image->heap_index   = image_slot + image_index_offset;
                 image->heap_address = host_info[resource_count].address;
-                resource_heap->count++;
+
+                image_count++;
+                resource_count++;
                 break;
 
             case DM_RESOURCE_TYPE_SAMPLER:
-                sampler_infos[sampler_count] = renderer->samplers[resource->index].info;
-
-                sampler_host_infos[sampler_count].address = (u8*)sampler_heap->start + sampler_offset;
-                sampler_host_infos[sampler_count].size    = sampler_heap->sampler_size;
-
-                renderer->samplers[resource->index].heap_index = sampler_heap->count++;
-
-                sampler_offset += sampler_heap->sampler_size;
+                sampler = dm_vulkan_get_sampler(renderer, *resource);
+                if(!sampler) { result = false; break; }
+
+                if(sampler->heap_index == DM_VULKAN_INVALID_HEAP_INDEX)
+                    sampler->heap_index = dm_vulkan_acquire_heap_slot(sampler_heap->free_samplers, &sampler_heap->free_sampler_count, &sampler_heap->count, sampler_heap->max_samplers);
+                if(sampler->heap_index == DM_VULKAN_INVALID_HEAP_INDEX)
+                {
+                    LOG_ERROR("Sampler heap is out of sampler descriptors");
+                    result = false;
+                    break;
+                }
+
+                sampler_infos[sampler_count] = sampler->info;
+
+                sampler_host_infos[sampler_count] = (VkHostAddressRangeEXT){
+                    .address=(u8*)sampler_heap->start + sampler->heap_index * sampler_heap->sampler_size,
+                    .size=sampler_heap->sampler_size
+                };
+
+                sampler_count++;
                 break;
 
             case DM_RESOURCE_TYPE_INVALID:
                 LOG_ERROR("Invalid resource");
-                return false;
+                result = false;
+                break;
 
             default:
                 LOG_ERROR("Unknown/unsupported resource type");
                 LOG_ERROR("Upload resource to heap failed");
-                return false;
+                result = false;
+                break;
         }
     }
 
-    if(!dm_vulkan_decode_vr(vkWriteResourceDescriptorsEXT(renderer->gpu.device, resource_heap->count, resource_info, host_info))) return false;
-    return dm_vulkan_decode_vr(vkWriteSamplerDescriptorsEXT(renderer->gpu.device, sampler_heap->count, sampler_infos, sampler_host_infos));
+    if(result && resource_count) result = dm_vulkan_decode_vr(vkWriteResourceDescriptorsEXT(renderer->gpu.device, resource_count, resource_info, host_info));
+    if(result && sampler_count)  result = dm_vulkan_decode_vr(vkWriteSamplerDescriptorsEXT(renderer->gpu.device, sampler_count, sampler_infos, sampler_host_infos));
+
+    dm_arena_reset_to_marker(scratch, marker);
+
+    return result;
+}
+
+void dm_renderer_destroy_pipeline(dm_context *context, dm_pipeline handle)
+{
+    dm_vulkan_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
+
+    dm_vulkan_pipeline *pipeline = dm_vulkan_get_pipeline(renderer, handle);
+    if(!pipeline) return;
+
+    if(--pipeline->ref_count) return;
+
+    // a failed pipeline may already have been replaced under the same hash
+    dm_pipeline stored;
+    if(pipeline->hash && dm_vulkan_pipeline_table_find(&renderer->pipeline_table, pipeline->hash, &stored) && stored.index == handle.index && stored.generation == handle.generation)
+        dm_vulkan_pipeline_table_remove(&renderer->pipeline_table, pipeline->hash);
+
+    // the build can't be cancelled, it still owns what it is creating
+    dm_vulkan_wait_pipeline(context, pipeline);
+
+    dm_vulkan_deferred_destroy entry = DM_VULKAN_DEFERRED_DESTROY_INIT;
+    entry.pipeline = pipeline->pipeline;
+    memcpy(entry.shaders, pipeline->shaders, sizeof(entry.shaders));
+    dm_vulkan_defer_destroy(renderer, entry);
+
+    if(renderer->active_pipeline.index == handle.index && renderer->active_pipeline.generation == handle.generation) 
+        renderer->active_pipeline.type = DM_PIPELINE_TYPE_INVALID;
+
+    dm_pool_free(&renderer->pipes, handle.index, handle.generation);
+}
+
+void dm_renderer_destroy_render_target(dm_context *context, dm_resource handle)
+{
+    dm_vulkan_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
+
+    if(!dm_vulkan_get_render_target(renderer, handle)) return;
+
+    dm_pool_free(&renderer->rts, handle.index, handle.generation);
+}
+
+void dm_renderer_destroy_buffer(dm_context *context, dm_resource handle)
+{
+    dm_vulkan_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
+
+    dm_vulkan_buffer *buffer = dm_vulkan_get_buffer(renderer, handle);
+    if(!buffer) return;
+
+    // frames only wait on uploads they could use, a pending one has to land first
+    dm_vulkan_upload_wait(renderer, buffer->upload_value);
+    dm_vulkan_upload_forget(renderer, buffer->device, VK_NULL_HANDLE);
+    dm_vulkan_forget_dirty_buffer(renderer, handle);
+
+    dm_vulkan_deferred_destroy entry = DM_VULKAN_DEFERRED_DESTROY_INIT;
+    entry.buffers[0]       = buffer->host;
+    entry.buffer_allocs[0] = buffer->host_alloc;
+    entry.buffers[1]       = buffer->device;
+    entry.buffer_allocs[1] = buffer->device_alloc;
+    entry.buffer_heap_slot = buffer->heap_indices[0];
+    dm_vulkan_defer_destroy(renderer, entry);
+
+    // the other copies of a dynamic buffer only hold a descriptor slot
+    for(u32 i=1; i<dm_vulkan_buffer_copy_count(buffer); i++)
+    {
+        dm_vulkan_deferred_destroy slot_entry = DM_VULKAN_DEFERRED_DESTROY_INIT;
+        slot_entry.buffer_heap_slot = buffer->heap_indices[i];
+        dm_vulkan_defer_destroy(renderer, slot_entry);
+    }
+
+    dm_pool_free(&renderer->buffers, handle.index, handle.generation);
+}
+
+void dm_renderer_destroy_texture(dm_context *context, dm_resource handle)
+{
+    dm_vulkan_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
+
+    dm_vulkan_image *image = dm_vulkan_get_image(renderer, handle);
+    if(!image) return;
+
+    dm_vulkan_upload_wait(renderer, image->staging.upload_value);
+    dm_vulkan_upload_forget(renderer, VK_NULL_HANDLE, image->image);
+
+    dm_vulkan_deferred_destroy entry = DM_VULKAN_DEFERRED_DESTROY_INIT;
+    entry.image            = image->image;
+    entry.image_alloc      = image->allocation;
+    entry.buffers[0]       = image->staging.host;
+    entry.buffer_allocs[0] = image->staging.host_alloc;
+    if(image->heap_index != DM_VULKAN_INVALID_HEAP_INDEX) 
+        entry.image_heap_slot = image->heap_index - renderer->resource_heap.image_offset / renderer->gpu.heap_props.imageDescriptorSize;
+    dm_vulkan_defer_destroy(renderer, entry);
+
+    dm_pool_free(&renderer->images, handle.index, handle.generation);
+}
+
+void dm_renderer_destroy_sampler(dm_context *context, dm_resource handle)
+{
+    dm_vulkan_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
+
+    dm_vulkan_sampler *sampler = dm_vulkan_get_sampler(renderer, handle);
+    if(!sampler) return;
+
+    dm_vulkan_deferred_destroy entry = DM_VULKAN_DEFERRED_DESTROY_INIT;
+    entry.sampler_heap_slot = sampler->heap_index;
+    dm_vulkan_defer_destroy(renderer, entry);
+
+    dm_pool_free(&renderer->samplers, handle.index, handle.generation);
 }
 
 // commands
@@ -2208,7 +5319,10 @@ void dm_render_command_begin_rendering(dm_context *context, dm_resource handle,
     dm_vulkan_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
     dm_vulkan_frame_data frame_data = renderer->frame_data[renderer->frame_index];
 
-    dm_vulkan_render_target target = renderer->rts[handle.index];
+    dm_vulkan_render_target *target = dm_vulkan_get_render_target(renderer, handle);
+    if(!target) return;
+
+    dm_vulkan_flush_dirty_buffers(renderer, frame_data.gfx_cmd);
 
     VkImage     color_image = renderer->swapchain.images[renderer->swapchain.index].image;
     VkImageView color_view  = renderer->swapchain.images[renderer->swapchain.index].view;
@@ -2260,8 +5374,8 @@ void dm_render_command_begin_rendering(dm_context *context, dm_resource handle,
         .sType=VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
         .imageLayout=VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
         .imageView=color_view,
-        .loadOp=target.color_load_op,
-        .storeOp=target.color_store_op,
+        .loadOp=target->color_load_op,
+        .storeOp=target->color_store_op,
         .clearValue.color.float32[0]=r,
         .clearValue.color.float32[1]=g,
         .clearValue.color.float32[2]=b,
@@ -2272,8 +5386,8 @@ void dm_render_command_begin_rendering(dm_context *context, dm_resource handle,
         .sType=VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
         .imageLayout=VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
         .imageView=depth_view,
-        .loadOp=target.depth_load_op,
-        .storeOp=target.depth_store_op,
+        .loadOp=target->depth_load_op,
+        .storeOp=target->depth_store_op,
         .clearValue.depthStencil.depth=d
     };
     VkRenderingInfo render_info = {
@@ -2286,6 +5400,7 @@ void dm_render_command_begin_rendering(dm_context *context, dm_resource handle,
         .renderArea.extent.height=renderer->swapchain.height
     };
     vkCmdBeginRendering(frame_data.gfx_cmd, &render_info);
+    renderer->rendering_active = true;
 
     VkViewport viewport = {
         .width=renderer->swapchain.width,
@@ -2298,8 +5413,17 @@ void dm_render_command_begin_rendering(dm_context *context, dm_resource handle,
         .extent.height=renderer->swapchain.height
     };
 
-    vkCmdSetViewport(frame_data.gfx_cmd, 0,1, &viewport);
-    vkCmdSetScissor(frame_data.gfx_cmd, 0, 1, &scissor);
+    // shader objects take the viewport count dynamically too
+    if(renderer->gpu.extensions.shader_object)
+    {
+        vkCmdSetViewportWithCount(frame_data.gfx_cmd, 1, &viewport);
+        vkCmdSetScissorWithCount(frame_data.gfx_cmd, 1, &scissor);
+    }
+    else
+    {
+        vkCmdSetViewport(frame_data.gfx_cmd, 0,1, &viewport);
+        vkCmdSetScissor(frame_data.gfx_cmd, 0, 1, &scissor);
+    }
 }
 
 void dm_render_command_end_rendering(dm_context *context, dm_resource handle)
@@ -2308,6 +5432,7 @@ void dm_render_command_end_rendering(dm_context *context, dm_resource handle)
     dm_vulkan_frame_data frame_data = renderer->frame_data[renderer->frame_index];
 
     vkCmdEndRendering(frame_data.gfx_cmd);
+    renderer->rendering_active = false;
 }
 
 void dm_render_command_bind_pipeline(dm_context *context, dm_pipeline handle)
@@ -2315,7 +5440,20 @@ void dm_render_command_bind_pipeline(dm_context *context, dm_pipeline handle)
     dm_vulkan_renderer  *renderer   = dm_arena_get_ptr(context->arena, context->renderer.offset);
     dm_vulkan_frame_data frame_data = renderer->frame_data[renderer->frame_index];
 
-    dm_vulkan_pipeline pipeline = renderer->pipes[handle.index];
+    dm_vulkan_pipeline *pipeline = dm_vulkan_resolve_pipeline(renderer, &handle);
+    renderer->skip_draws = !pipeline;
+    if(!pipeline)
+    {
+        renderer->active_pipeline.type = DM_PIPELINE_TYPE_INVALID;
+        return;
+    }
+
+    if(pipeline->shaders[DM_RASTER_SHADER_STAGE_VERTEX])
+    {
+        dm_vulkan_bind_raster_shaders(renderer, frame_data.gfx_cmd, pipeline);
+        renderer->active_pipeline = handle;
+        return;
+    }
 
     VkPipelineBindPoint bind_point;
 
@@ -2338,7 +5476,8 @@ void dm_render_command_bind_pipeline(dm_context *context, dm_pipeline handle)
             return;
     }
 
-    vkCmdBindPipeline(frame_data.gfx_cmd, bind_point, pipeline.pipeline);
+    vkCmdBindPipeline(frame_data.gfx_cmd, bind_point, pipeline->pipeline);
+    if(handle.type == DM_PIPELINE_TYPE_RASTER) dm_vulkan_reset_raster_state(renderer, frame_data.gfx_cmd, pipeline);
 
     renderer->active_pipeline = handle;
 }
@@ -2348,9 +5487,12 @@ void dm_render_command_bind_index_buffer(dm_context *context, dm_resource handle
     dm_vulkan_renderer  *renderer   = dm_arena_get_ptr(context->arena, context->renderer.offset);
     dm_vulkan_frame_data frame_data = renderer->frame_data[renderer->frame_index];
 
-    dm_vulkan_buffer buffer = renderer->buffers[handle.index];
+    dm_vulkan_buffer *buffer = dm_vulkan_get_buffer(renderer, handle);
+    if(!buffer) return;
+
+    offset += dm_vulkan_buffer_copy(renderer, buffer) * buffer->stride;
 
-    vkCmdBindIndexBuffer(frame_data.gfx_cmd, buffer.device, offset, VK_INDEX_TYPE_UINT32);
+    vkCmdBindIndexBuffer(frame_data.gfx_cmd, buffer->device, offset, VK_INDEX_TYPE_UINT32);
 }
 
 void dm_render_command_push_data(dm_context* context, void* data, size_t size)
@@ -2380,31 +5522,17 @@ void dm_render_command_push_resources(dm_context *context, dm_resource *resource
 
     if(renderer->active_pipeline.type==DM_PIPELINE_TYPE_INVALID)
     {
-        LOG_ERROR("No valid pipeline bound");
+        // not an error while a pipeline is still building
+        if(!renderer->skip_draws) LOG_ERROR("No valid pipeline bound");
         return;
     }
 
-    dm_vulkan_pipeline *pipeline = &renderer->pipes[renderer->active_pipeline.index];
+    dm_vulkan_pipeline *pipeline = dm_vulkan_get_pipeline(renderer, renderer->active_pipeline);
+    if(!pipeline) return;
 
     for(u32 i=0; i<count; i++)
     {
-        dm_resource resource = resources[i];
-
-        switch(resource.type)
-        {
-            case DM_RESOURCE_TYPE_BUFFER:
-                pipeline->push_indices[renderer->frame_index][i] = renderer->buffers[resource.index].heap_index;
-                break;
-            case DM_RESOURCE_TYPE_TEXTURE:
-                pipeline->push_indices[renderer->frame_index][i] = renderer->images[resource.index].heap_index;
-                break;
-            case DM_RESOURCE_TYPE_SAMPLER:
-                pipeline->push_indices[renderer->frame_index][i] = renderer->samplers[resource.index].heap_index;
-                break;
-            default:
-                LOG_ERROR("Unknown/unsupported resource type");
-                return;
-        }
+        if(!dm_vulkan_get_heap_index(renderer, resources[i], &pipeline->push_indices[renderer->frame_index][i])) return;
     }
 
     VkPushDataInfoEXT info = {
@@ -2421,48 +5549,239 @@ void dm_render_command_draw(dm_context *context, u32 index_count, u32 instance_c
     dm_vulkan_renderer  *renderer   = dm_arena_get_ptr(context->arena, context->renderer.offset);
     dm_vulkan_frame_data frame_data = renderer->frame_data[renderer->frame_index];
 
+    if(renderer->skip_draws) return;
+
     vkCmdDrawIndexed(frame_data.gfx_cmd, index_count, instance_count, 0, 0, 0);
 }
 
-void dm_render_command_update_buffer(dm_context *context, dm_resource handle, void *data, size_t size)
+void dm_render_command_set_cull_mode(dm_context *context, dm_cull_mode mode)
 {
-    dm_vulkan_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
+    dm_vulkan_renderer  *renderer   = dm_arena_get_ptr(context->arena, context->renderer.offset);
+    dm_vulkan_frame_data frame_data = renderer->frame_data[renderer->frame_index];
+
+    vkCmdSetCullMode(frame_data.gfx_cmd, dm_convert_cull_mode(mode));
+}
+
+void dm_render_command_set_primitive_topology(dm_context *context, dm_primitive_topology topology)
+{
+    dm_vulkan_renderer  *renderer   = dm_arena_get_ptr(context->arena, context->renderer.offset);
+    dm_vulkan_frame_data frame_data = renderer->frame_data[renderer->frame_index];
+
+    VkPrimitiveTopology vk_topology = dm_convert_primitive_topology(topology);
+
+    // pipelines are built with triangles, without the eds3 property only other triangle topologies are allowed
+    bool triangles = vk_topology == VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST || vk_topology == VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+    if(!triangles && !renderer->gpu.extensions.unrestricted_topology)
+    {
+        if(!renderer->warned_dynamic_topology) LOG_WARN("Device can't switch raster pipelines away from triangles, ignoring topology");
+        renderer->warned_dynamic_topology = true;
+        return;
+    }
+
+    vkCmdSetPrimitiveTopology(frame_data.gfx_cmd, vk_topology);
+}
+
+void dm_render_command_set_depth_test(dm_context *context, bool enable)
+{
+    dm_vulkan_renderer  *renderer   = dm_arena_get_ptr(context->arena, context->renderer.offset);
+    dm_vulkan_frame_data frame_data = renderer->frame_data[renderer->frame_index];
+
+    vkCmdSetDepthTestEnable(frame_data.gfx_cmd, enable);
+}
+
+void dm_render_command_set_depth_write(dm_context *context, bool enable)
+{
+    dm_vulkan_renderer  *renderer   = dm_arena_get_ptr(context->arena, context->renderer.offset);
+    dm_vulkan_frame_data frame_data = renderer->frame_data[renderer->frame_index];
+
+    vkCmdSetDepthWriteEnable(frame_data.gfx_cmd, enable);
+}
+
+void dm_render_command_set_blend(dm_context *context, bool enable, dm_blend_op color_op, dm_blend_factor color_src, dm_blend_factor color_dst, dm_blend_op alpha_op, dm_blend_factor alpha_src, dm_blend_factor alpha_dst)
+{
+    dm_vulkan_renderer  *renderer   = dm_arena_get_ptr(context->arena, context->renderer.offset);
+    dm_vulkan_frame_data frame_data = renderer->frame_data[renderer->frame_index];
+
+    if(!dm_vulkan_has_dynamic_blend(renderer))
+    {
+        if(!renderer->warned_dynamic_blend) LOG_WARN("Device has no dynamic blend state, ignoring blend changes");
+        renderer->warned_dynamic_blend = true;
+        return;
+    }
+
+    VkBool32 blend = enable;
+    VkColorBlendEquationEXT equation = dm_convert_blend_equation(enable, color_op, color_src, color_dst, alpha_op, alpha_src, alpha_dst);
+
+    vkCmdSetColorBlendEnableEXT(frame_data.gfx_cmd, 0, 1, &blend);
+    vkCmdSetColorBlendEquationEXT(frame_data.gfx_cmd, 0, 1, &equation);
+}
 
-    dm_vulkan_buffer buffer = renderer->buffers[handle.index];
+// blocking path for updates outside a frame or inside a render pass
+void dm_vulkan_update_buffer_immediate(dm_vulkan_renderer *renderer, dm_vulkan_buffer *buffer, void *data, size_t offset, size_t size)
+{
+    // device buffers keep no host copy, stage through a temporary one
+    VkBuffer      staging;
+    VmaAllocation staging_alloc;
+    VmaAllocationCreateFlags staging_flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    if(!dm_vulkan_create_buffer(renderer->allocator, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, staging_flags, VMA_MEMORY_USAGE_AUTO, &staging, &staging_alloc, size)) return;
+
+    if(!dm_vulkan_decode_vr(vmaCopyMemoryToAllocation(renderer->allocator, data, staging_alloc, 0, size)))
+    {
+        LOG_ERROR("vmaCopyMemoryToAllocation failed");
+        vmaDestroyBuffer(renderer->allocator, staging, staging_alloc);
+        return;
+    }
 
-    // TODO: need to check if size is different
-    // if so, destroy and recreate and update descriptor
-    dm_vulkan_copy_to_buffer(renderer->allocator, buffer, data, size);
+    VkCommandBuffer cmd = dm_vulkan_one_time_cmd(renderer->gpu.device, renderer->single_use_pool, renderer->single_use_cmd);
 
-    VkCommandBuffer cmd = dm_vulkan_one_time_cmd(renderer->gpu.device, renderer->single_use_pool);
+    // a pending initial upload must not land on top of this
+    dm_vulkan_upload_finish(renderer, cmd);
 
     VkBufferCopy2 region_info = {
         .sType=VK_STRUCTURE_TYPE_BUFFER_COPY_2,
+        .dstOffset=offset,
         .size=size
     };
 
     VkCopyBufferInfo2 copy_info = {
         .sType=VK_STRUCTURE_TYPE_COPY_BUFFER_INFO_2,
-        .srcBuffer=buffer.host,
-        .dstBuffer=buffer.device,
+        .srcBuffer=staging,
+        .dstBuffer=buffer->device,
         .regionCount=1,
         .pRegions=&region_info
     };
 
     vkCmdCopyBuffer2(cmd, &copy_info);
 
-    dm_vulkan_submit_one_time_cmd(renderer->gpu.device, renderer->gpu.gfx_queue, renderer->single_use_pool, cmd);
+    dm_vulkan_submit_one_time_cmd(renderer->gpu.gfx_queue, cmd);
+
+    vmaDestroyBuffer(renderer->allocator, staging, staging_alloc);
+}
+
+// returns the offset of size bytes in the current frame's staging slice, or false if it is full
+bool dm_vulkan_staging_alloc(dm_vulkan_staging_ring *ring, size_t size, VkDeviceSize *offset)
+{
+    VkDeviceSize start = DM_ALIGN(ring->offset, DM_VULKAN_STAGING_ALIGNMENT);
+    if(start + size > ring->end) return false;
+
+    *offset = start;
+    ring->offset = start + size;
+
+    return true;
+}
+
+void dm_render_command_update_buffer_range(dm_context *context, dm_resource handle, void *data, size_t offset, size_t size)
+{
+    dm_vulkan_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
+    dm_vulkan_frame_data frame_data = renderer->frame_data[renderer->frame_index];
+
+    dm_vulkan_buffer *buffer = dm_vulkan_get_buffer(renderer, handle);
+    if(!buffer) return;
+
+    // buffers don't grow, recreate them for more space
+    if(offset > buffer->size || size > buffer->size - offset)
+    {
+        LOG_ERROR("Buffer update of %zu bytes at offset %zu is outside the buffer (%zu bytes)", size, offset, buffer->size);
+        return;
+    }
+    if(!size) return;
+
+    // inside a frame only the copy it uses is written. between frames every copy is,
+    // after the frames still reading them are done
+    if(buffer->mapped)
+    {
+        u32 first = dm_vulkan_buffer_copy(renderer, buffer);
+        u32 last  = first + 1;
+        if(!renderer->frame_active)
+        {
+            dm_vulkan_wait_submitted_frames(renderer);
+
+            first = 0;
+            last  = dm_vulkan_buffer_copy_count(buffer);
+        }
+
+        for(u32 i=first; i<last; i++)
+        {
+            memcpy(buffer->mapped + i * buffer->stride + offset, data, size);
+            vmaFlushAllocation(renderer->allocator, buffer->device_alloc, i * buffer->stride + offset, size);
+        }
+        return;
+    }
+
+    dm_vulkan_dirty_buffer *dirty = dm_vulkan_get_dirty_buffer(renderer, handle, false);
+
+    VkDeviceSize src;
+    if(!renderer->frame_active || renderer->rendering_active || !dm_vulkan_staging_alloc(&renderer->staging_ring, size, &src))
+    {
+        if(renderer->frame_active && !renderer->warned_staging_fallback) LOG_WARN("Buffer update inside a render pass or staging ring is full, falling back to a blocking upload");
+        if(renderer->frame_active) renderer->warned_staging_fallback = true;
+
+        if(dirty) dm_vulkan_dirty_patch(renderer, dirty, data, offset, size);
+        dm_vulkan_update_buffer_immediate(renderer, buffer, data, offset, size);
+        return;
+    }
+
+    memcpy(renderer->staging_ring.mapped + src, data, size);
+    vmaFlushAllocation(renderer->allocator, renderer->staging_ring.allocation, src, size);
+
+    // copy what is pending first when the buffer is close to its range limit or there is no room for another buffer
+    if((dirty && dirty->range_count > DM_VULKAN_MAX_DIRTY_RANGES - 2) || (!dirty && renderer->dirty_buffer_count == DM_VULKAN_MAX_DIRTY_BUFFERS))
+    {
+        dm_vulkan_flush_dirty_buffers(renderer, frame_data.gfx_cmd);
+        dirty = NULL;
+    }
+    if(!dirty) dirty = dm_vulkan_get_dirty_buffer(renderer, handle, true);
+
+    dm_vulkan_dirty_insert(dirty, offset, src, size);
+}
+
+void dm_render_command_update_buffer(dm_context *context, dm_resource handle, void *data, size_t size)
+{
+    dm_render_command_update_buffer_range(context, handle, data, 0, size);
+}
+
+bool dm_renderer_read_buffer(dm_context *context, dm_resource handle, void *data, size_t offset, size_t size)
+{
+    dm_vulkan_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
+
+    dm_vulkan_buffer *buffer = dm_vulkan_get_buffer(renderer, handle);
+    if(!buffer) return false;
+
+    if(buffer->usage != DM_BUFFER_USAGE_READBACK)
+    {
+        LOG_ERROR("Only readback buffers can be read");
+        return false;
+    }
+    if(offset > buffer->size || size > buffer->size - offset)
+    {
+        LOG_ERROR("Buffer read of %zu bytes at offset %zu is outside the buffer (%zu bytes)", size, offset, buffer->size);
+        return false;
+    }
+
+    // whatever the submitted frames write has to land first
+    dm_vulkan_wait_submitted_frames(renderer);
+
+    if(dm_vulkan_decode_vr(vmaCopyAllocationToMemory(renderer->allocator, buffer->device_alloc, offset, data, size))) return true;
+
+    LOG_ERROR("vmaCopyAllocationToMemory failed");
+    return false;
 }
 
 bool dm_render_command_update_texture(dm_context *context, dm_resource handle, void* data, size_t size, u16 width, u16 height)
 {
     dm_vulkan_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
 
-    dm_vulkan_image *image = &renderer->images[handle.index];
-    dm_vulkan_buffer *staging_buffer = &renderer->buffers[image->buffer_index];
+    dm_vulkan_image *image = dm_vulkan_get_image(renderer, handle);
+    if(!image) return false;
+
+    dm_vulkan_buffer *staging_buffer = &image->staging;
+
+    // the last upload may still be reading the staging buffer
+    dm_vulkan_upload_wait(renderer, staging_buffer->upload_value);
 
     if(image->width != width || image->height != height)
     {
+        dm_vulkan_upload_forget(renderer, VK_NULL_HANDLE, image->image);
         vmaDestroyImage(renderer->allocator, image->image, image->allocation);
         vmaDestroyBuffer(renderer->allocator, staging_buffer->host, staging_buffer->host_alloc);
 
@@ -2522,7 +5841,7 @@ bool dm_render_command_update_texture(dm_context *context, dm_resource handle, v
     }
 
     if(!dm_vulkan_copy_to_buffer(renderer->allocator, *staging_buffer, data, size)) return false;
-    dm_vulkan_copy_buffer_to_image(renderer->gpu, renderer->single_use_pool, image->image, staging_buffer->host, width, height);
+    dm_vulkan_upload_image(renderer, image, width, height, true);
 
     return true;
 }
@@ -2530,19 +5849,63 @@ bool dm_render_command_update_texture(dm_context *context, dm_resource handle, v
 /**********
  * COMPUTE
  ***********/
-bool dm_renderer_create_compute_pipeline(dm_context *context, dm_pipeline *handle)
+// safe to call from the job workers
+VkPipeline dm_vulkan_build_compute_pipeline(dm_context *context, dm_compute_pipe_desc desc)
 {
     dm_vulkan_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
 
-    dm_vulkan_pipeline pipeline = { 0 };
+    VkPipeline pipeline = VK_NULL_HANDLE;
+
+    if(desc.constant_count > DM_MAX_SPEC_CONSTANTS)
+    {
+        LOG_ERROR("Compute pipeline has %u specialization constants, max is %u", desc.constant_count, DM_MAX_SPEC_CONSTANTS);
+        return VK_NULL_HANDLE;
+    }
+
+    const char *entry = desc.entry[0] ? desc.entry : "main";
+
+    char path[512];
+    dm_vulkan_get_shader_path(context, desc.path, desc.define_count, path, sizeof(path));
+
+    dm_vulkan_spirv spirv;
+    if(!dm_vulkan_get_spirv(context, path, entry, shaderc_compute_shader, desc.defines, desc.define_count, &spirv))
+    {
+        LOG_ERROR("Could not compile compute shader");
+        return VK_NULL_HANDLE;
+    }
+
+    VkShaderModuleCreateInfo module_info = {
+        .sType=VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .codeSize=spirv.size,
+        .pCode=spirv.code
+    };
+
+    // folded into the kernel by the driver, so these are as good as literals in the glsl
+    VkSpecializationMapEntry map_entries[DM_MAX_SPEC_CONSTANTS];
+    u32 values[DM_MAX_SPEC_CONSTANTS];
+    for(u32 i=0; i<desc.constant_count; i++)
+    {
+        map_entries[i] = (VkSpecializationMapEntry){
+            .constantID=desc.constants[i].id,
+            .offset=i * sizeof(u32),
+            .size=sizeof(u32)
+        };
+        values[i] = desc.constants[i].value;
+    }
 
-    VkShaderModule module = dm_vulkan_create_shader_module(renderer->gpu, "../../assets/shaders/compute.glsl", "main", shaderc_compute_shader);
+    VkSpecializationInfo spec_info = {
+        .mapEntryCount=desc.constant_count,
+        .pMapEntries=map_entries,
+        .dataSize=desc.constant_count * sizeof(u32),
+        .pData=values
+    };
 
     VkPipelineShaderStageCreateInfo shader_info = {
         .sType=VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
         .stage=VK_SHADER_STAGE_COMPUTE_BIT,
-        .pName="main",
-        .module=module
+        .pName=entry,
+        .pNext=&module_info,
+        .pSpecializationInfo=desc.constant_count ? &spec_info : NULL
     };
 
     VkPipelineCreateFlags2CreateInfo flags2 = {
@@ -2556,30 +5919,144 @@ bool dm_renderer_create_compute_pipeline(dm_context *context, dm_pipeline *handl
         .pNext=&flags2
     };
 
-    if(!dm_vulkan_decode_vr(vkCreateComputePipelines(renderer->gpu.device, NULL, 1, &info, NULL, &pipeline.pipeline)))
+    if(!dm_vulkan_create_pipeline(renderer, &info, &flags2, &pipeline))
     {
         LOG_ERROR("vkCreateComputePipelines failed");
+        pipeline = VK_NULL_HANDLE;
+    }
+
+    dm_vulkan_spirv_free(&spirv);
+
+    return pipeline;
+}
+
+bool dm_renderer_create_compute_pipeline(dm_context *context, dm_compute_pipe_desc desc, dm_pipeline *handle)
+{
+    dm_vulkan_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
+
+    u64 hash = dm_vulkan_hash_compute_desc(&desc);
+    if(dm_vulkan_acquire_ready_pipeline(context, hash, handle)) return true;
+
+    dm_vulkan_pipeline pipeline = { .status=DM_PIPELINE_STATUS_READY, .hash=hash };
+
+    pipeline.pipeline = dm_vulkan_build_compute_pipeline(context, desc);
+    if(!pipeline.pipeline) return false;
+
+    if(!dm_vulkan_add_pipeline(renderer, pipeline, DM_PIPELINE_TYPE_COMPUTE, handle))
+    {
+        vkDestroyPipeline(renderer->gpu.device, pipeline.pipeline, DM_VULKAN_ALLOCATOR);
         return false;
     }
 
-    vkDestroyShaderModule(renderer->gpu.device, module, NULL);
+    return true;
+}
+
+/*****************
+ * ASYNC PIPELINES
+ *****************/
+void dm_vulkan_pipeline_build_job(void *data)
+{
+    dm_vulkan_pipeline_build *build = data;
+
+    switch(build->type)
+    {
+        case DM_PIPELINE_TYPE_RASTER:
+            build->success = dm_vulkan_build_raster_pipeline(build->context, build->raster_desc, &build->result);
+            break;
+        case DM_PIPELINE_TYPE_COMPUTE:
+            build->result.pipeline = dm_vulkan_build_compute_pipeline(build->context, build->compute_desc);
+            build->success = build->result.pipeline != VK_NULL_HANDLE;
+            break;
+
+        default:
+            LOG_ERROR("Unknown/unsupported pipeline type");
+            break;
+    }
+
+    if(!build->success) LOG_ERROR("Async pipeline build failed");
+}
+
+bool dm_vulkan_submit_pipeline_build(dm_context *context, dm_vulkan_pipeline_build *build, u64 hash, dm_pipeline fallback, dm_pipeline *handle)
+{
+    dm_vulkan_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
 
-    //
-    renderer->pipes[renderer->pipe_count] = pipeline;
-    handle->type = DM_PIPELINE_TYPE_COMPUTE;
-    handle->index  = renderer->pipe_count++;
+    dm_vulkan_pipeline pipeline = {
+        .status=DM_PIPELINE_STATUS_PENDING,
+        .fallback=fallback,
+        .build=build,
+        .hash=hash
+    };
+
+    // the slot has to exist before the job does so a failure here leaves nothing running
+    if(!dm_vulkan_add_pipeline(renderer, pipeline, build->type, handle))
+    {
+        free(build);
+        return false;
+    }
+
+    dm_job_submit(context, dm_vulkan_pipeline_build_job, build, &build->counter);
 
     return true;
 }
 
+bool dm_renderer_create_raster_pipeline_async(dm_context *context, dm_raster_pipe_desc desc, dm_pipeline fallback, dm_pipeline *handle)
+{
+    dm_vulkan_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
+
+    // whoever asked first picked the fallback
+    u64 hash = dm_vulkan_hash_raster_desc(renderer, &desc);
+    if(dm_vulkan_acquire_pipeline(renderer, hash, handle)) return true;
+
+    dm_vulkan_pipeline_build *build = calloc(1, sizeof(dm_vulkan_pipeline_build));
+    if(!build) return false;
+
+    build->context     = context;
+    build->type        = DM_PIPELINE_TYPE_RASTER;
+    build->raster_desc = desc;
+
+    return dm_vulkan_submit_pipeline_build(context, build, hash, fallback, handle);
+}
+
+bool dm_renderer_create_compute_pipeline_async(dm_context *context, dm_compute_pipe_desc desc, dm_pipeline fallback, dm_pipeline *handle)
+{
+    dm_vulkan_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
+
+    u64 hash = dm_vulkan_hash_compute_desc(&desc);
+    if(dm_vulkan_acquire_pipeline(renderer, hash, handle)) return true;
+
+    dm_vulkan_pipeline_build *build = calloc(1, sizeof(dm_vulkan_pipeline_build));
+    if(!build) return false;
+
+    build->context      = context;
+    build->type         = DM_PIPELINE_TYPE_COMPUTE;
+    build->compute_desc = desc;
+
+    return dm_vulkan_submit_pipeline_build(context, build, hash, fallback, handle);
+}
+
+dm_pipeline_status dm_renderer_get_pipeline_status(dm_context *context, dm_pipeline handle)
+{
+    dm_vulkan_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
+
+    dm_vulkan_pipeline *pipeline = NULL;
+    if(handle.type != DM_PIPELINE_TYPE_INVALID) pipeline = dm_pool_get(&renderer->pipes, handle.index, handle.generation);
+    if(!pipeline) return DM_PIPELINE_STATUS_INVALID;
+
+    dm_vulkan_poll_pipeline(pipeline);
+
+    return pipeline->status;
+}
+
 void dm_compute_command_bind_pipeline(dm_context *context, dm_pipeline handle)
 {
     dm_vulkan_renderer  *renderer   = dm_arena_get_ptr(context->arena, context->renderer.offset);
     dm_vulkan_frame_data frame_data = renderer->frame_data[renderer->frame_index];
 
-    dm_vulkan_pipeline pipeline = renderer->pipes[handle.index];
+    dm_vulkan_pipeline *pipeline = dm_vulkan_resolve_pipeline(renderer, &handle);
+    renderer->skip_dispatches = !pipeline;
+    if(!pipeline) return;
 
-    vkCmdBindPipeline(frame_data.gfx_cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.pipeline);
+    vkCmdBindPipeline(frame_data.gfx_cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->pipeline);
 }
 
 void dm_compute_command_dispatch(dm_context *context, u16 x, u16 y, u16 z)
@@ -2587,9 +6064,401 @@ void dm_compute_command_dispatch(dm_context *context, u16 x, u16 y, u16 z)
     dm_vulkan_renderer  *renderer   = dm_arena_get_ptr(context->arena, context->renderer.offset);
     dm_vulkan_frame_data frame_data = renderer->frame_data[renderer->frame_index];
 
+    if(renderer->skip_dispatches) return;
+
+    dm_vulkan_flush_dirty_buffers(renderer, frame_data.gfx_cmd);
+
     vkCmdDispatch(frame_data.gfx_cmd, x,y,z);
 }
 
+/****************
+ * COMPUTE TUNER
+ ****************/
+// the best workgroup size changes with the device and driver, so results are kept in one file per dm_vulkan_device_id
+#define DM_VULKAN_TUNE_MAGIC       0x4E555444 // "DTUN"
+#define DM_VULKAN_TUNE_VERSION     1
+#define DM_VULKAN_TUNE_MAX_ENTRIES 256
+#define DM_VULKAN_TUNE_REPEATS     8
+
+typedef struct dm_vulkan_tune_header_t
+{
+    u32 magic, version;
+    dm_vulkan_device_id device;
+    u32 entry_count;
+} dm_vulkan_tune_header;
+
+typedef struct dm_vulkan_tune_entry_t
+{
+    u64 key;
+    u32 size[3], padding;
+} dm_vulkan_tune_entry;
+
+// a size of 0 leaves that dimension to the shader
+u32 dm_vulkan_tune_size(u32 size)
+{
+    return size ? size : 1;
+}
+
+u64 dm_vulkan_hash_tune_desc(const dm_compute_tune_desc *desc)
+{
+    u64 hash = dm_vulkan_hash_compute_desc(&desc->pipe);
+    hash = dm_hash_fnv1a_ex(desc->size_ids, sizeof(desc->size_ids), hash);
+    hash = dm_hash_fnv1a_ex(desc->candidates, desc->candidate_count * sizeof(desc->candidates[0]), hash);
+
+    return dm_hash_fnv1a_ex(desc->work, sizeof(desc->work), hash);
+}
+
+void dm_vulkan_tune_cache_path(dm_vulkan_renderer *renderer, char *path, size_t size)
+{
+    dm_vulkan_device_id id = dm_vulkan_get_device_id(renderer->gpu);
+
+    snprintf(path, size, "%s/compute_tune_%016llx.bin", DM_CACHE_DIRECTORY, (unsigned long long)dm_hash_fnv1a(&id, sizeof(id)));
+}
+
+u32 dm_vulkan_load_tune_cache(dm_vulkan_renderer *renderer, dm_vulkan_tune_entry *entries)
+{
+    char path[512];
+    dm_vulkan_tune_cache_path(renderer, path, sizeof(path));
+    if(!dm_file_exists(path)) return 0;
+
+    dm_mapped_file file;
+    if(!dm_file_map(path, &file)) return 0;
+
+    const dm_vulkan_tune_header *header = file.data;
+    dm_vulkan_device_id id = dm_vulkan_get_device_id(renderer->gpu);
+
+    bool valid = file.size >= sizeof(dm_vulkan_tune_header) &&
+                 header->magic == DM_VULKAN_TUNE_MAGIC &&
+                 header->version == DM_VULKAN_TUNE_VERSION &&
+                 memcmp(&header->device, &id, sizeof(id)) == 0 &&
+                 header->entry_count <= DM_VULKAN_TUNE_MAX_ENTRIES &&
+                 file.size == sizeof(dm_vulkan_tune_header) + header->entry_count * sizeof(dm_vulkan_tune_entry);
+
+    u32 count = 0;
+    if(valid)
+    {
+        count = header->entry_count;
+        memcpy(entries, (const u8*)file.data + sizeof(dm_vulkan_tune_header), count * sizeof(dm_vulkan_tune_entry));
+    }
+    else
+    {
+        LOG_INFO("Compute tuning cache %s is stale, retuning", path);
+    }
+
+    dm_file_unmap(&file);
+
+    return count;
+}
+
+bool dm_vulkan_find_tune_result(dm_vulkan_renderer *renderer, u64 key, dm_vulkan_tune_entry *result)
+{
+    dm_vulkan_tune_entry entries[DM_VULKAN_TUNE_MAX_ENTRIES];
+    u32 count = dm_vulkan_load_tune_cache(renderer, entries);
+
+    for(u32 i=0; i<count; i++)
+    {
+        if(entries[i].key != key) continue;
+
+        *result = entries[i];
+        return true;
+    }
+
+    return false;
+}
+
+void dm_vulkan_store_tune_result(dm_vulkan_renderer *renderer, u64 key, const u32 *size)
+{
+    dm_vulkan_tune_entry entries[DM_VULKAN_TUNE_MAX_ENTRIES];
+    u32 count = dm_vulkan_load_tune_cache(renderer, entries);
+
+    u32 i = 0;
+    for(; i<count && entries[i].key != key; i++);
+
+    // full, the oldest result goes
+    if(i == DM_VULKAN_TUNE_MAX_ENTRIES)
+    {
+        memmove(entries, entries + 1, (count - 1) * sizeof(dm_vulkan_tune_entry));
+        i = count - 1;
+    }
+    if(i == count) count++;
+
+    entries[i] = (dm_vulkan_tune_entry){ .key=key, .size={ size[0], size[1], size[2] } };
+
+    dm_vulkan_tune_header header = {
+        .magic=DM_VULKAN_TUNE_MAGIC,
+        .version=DM_VULKAN_TUNE_VERSION,
+        .device=dm_vulkan_get_device_id(renderer->gpu),
+        .entry_count=count
+    };
+
+    size_t data_size = sizeof(header) + count * sizeof(dm_vulkan_tune_entry);
+    u8 *data = malloc(data_size);
+    if(!data) return;
+
+    memcpy(data, &header, sizeof(header));
+    memcpy(data + sizeof(header), entries, count * sizeof(dm_vulkan_tune_entry));
+
+    char path[512];
+    dm_vulkan_tune_cache_path(renderer, path, sizeof(path));
+    if(!dm_write_bytes(path, data, data_size)) LOG_WARN("Could not write compute tuning cache %s", path);
+
+    free(data);
+}
+
+bool dm_vulkan_set_spec_constant(dm_compute_pipe_desc *desc, u32 id, u32 value)
+{
+    for(u32 i=0; i<desc->constant_count; i++)
+    {
+        if(desc->constants[i].id != id) continue;
+
+        desc->constants[i].value = value;
+        return true;
+    }
+
+    if(desc->constant_count >= DM_MAX_SPEC_CONSTANTS) return false;
+
+    desc->constants[desc->constant_count++] = (dm_spec_constant){ .id=id, .value=value };
+    return true;
+}
+
+bool dm_vulkan_apply_workgroup_size(const dm_compute_tune_desc *desc, const u32 *size, dm_compute_pipe_desc *pipe)
+{
+    *pipe = desc->pipe;
+
+    for(u32 i=0; i<3; i++)
+    {
+        if(!size[i]) continue;
+        if(dm_vulkan_set_spec_constant(pipe, desc->size_ids[i], size[i])) continue;
+
+        LOG_ERROR("No room left for the workgroup size specialization constants");
+        return false;
+    }
+
+    return true;
+}
+
+bool dm_vulkan_workgroup_size_fits(dm_vulkan_renderer *renderer, const u32 *size)
+{
+    VkPhysicalDeviceLimits limits = renderer->gpu.properties.limits;
+
+    u32 invocations = 1;
+    for(u32 i=0; i<3; i++)
+    {
+        u32 dim = dm_vulkan_tune_size(size[i]);
+        if(dim > limits.maxComputeWorkGroupSize[i]) return false;
+
+        invocations *= dim;
+    }
+
+    return invocations <= limits.maxComputeWorkGroupInvocations;
+}
+
+// records every ready candidate into one command buffer, each timed over DM_VULKAN_TUNE_REPEATS dispatches after a warm up.
+// times are in nanoseconds per dispatch, negative for candidates that didn't run
+bool dm_vulkan_time_workgroup_sizes(dm_context *context, const dm_compute_tune_desc *desc, const dm_pipeline *pipelines, double *times)
+{
+    dm_vulkan_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
+    VkDevice device = renderer->gpu.device;
+
+    u32 indices[DM_COMPUTE_TUNE_MAX_RESOURCES];
+    for(u32 i=0; i<desc->resource_count; i++)
+    {
+        if(!dm_vulkan_get_heap_index(renderer, desc->resources[i], &indices[i])) return false;
+    }
+
+    VkQueryPool query_pool;
+    VkQueryPoolCreateInfo query_info = {
+        .sType=VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType=VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount=desc->candidate_count * 2
+    };
+    if(!dm_vulkan_decode_vr(vkCreateQueryPool(device, &query_info, DM_VULKAN_ALLOCATOR, &query_pool)))
+    {
+        LOG_ERROR("vkCreateQueryPool failed");
+        return false;
+    }
+
+    // every dispatch waits on the one before, like it would in a frame
+    VkMemoryBarrier2 barrier = {
+        .sType=VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask=VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .srcAccessMask=VK_ACCESS_2_SHADER_WRITE_BIT,
+        .dstStageMask=VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .dstAccessMask=VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT
+    };
+    VkDependencyInfo dependency = {
+        .sType=VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount=1,
+        .pMemoryBarriers=&barrier
+    };
+
+    VkPushDataInfoEXT push_info = {
+        .sType=VK_STRUCTURE_TYPE_PUSH_DATA_INFO_EXT,
+        .data.address=indices,
+        .data.size=sizeof(u32) * desc->resource_count
+    };
+
+    bool timed[DM_COMPUTE_TUNE_MAX_CANDIDATES] = { 0 };
+
+    VkCommandBuffer cmd = dm_vulkan_one_time_cmd(device, renderer->single_use_pool, renderer->single_use_cmd);
+    dm_vulkan_upload_finish(renderer, cmd);
+    vkCmdResetQueryPool(cmd, query_pool, 0, query_info.queryCount);
+    dm_vulkan_bind_heaps(renderer, cmd);
+
+    for(u32 i=0; i<desc->candidate_count; i++)
+    {
+        if(pipelines[i].type == DM_PIPELINE_TYPE_INVALID) continue;
+
+        dm_vulkan_pipeline *pipeline = dm_vulkan_get_pipeline(renderer, pipelines[i]);
+        if(!pipeline) continue;
+
+        dm_vulkan_wait_pipeline(context, pipeline);
+        if(pipeline->status != DM_PIPELINE_STATUS_READY) continue;
+
+        u32 groups[3];
+        for(u32 j=0; j<3; j++)
+        {
+            u32 size = dm_vulkan_tune_size(desc->candidates[i][j]);
+            groups[j] = (dm_vulkan_tune_size(desc->work[j]) + size - 1) / size;
+        }
+
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->pipeline);
+        if(desc->resource_count) vkCmdPushDataEXT(cmd, &push_info);
+
+        vkCmdDispatch(cmd, groups[0], groups[1], groups[2]);
+        vkCmdPipelineBarrier2(cmd, &dependency);
+
+        vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, query_pool, i * 2);
+        for(u32 r=0; r<DM_VULKAN_TUNE_REPEATS; r++)
+        {
+            vkCmdDispatch(cmd, groups[0], groups[1], groups[2]);
+            vkCmdPipelineBarrier2(cmd, &dependency);
+        }
+        vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, query_pool, i * 2 + 1);
+
+        timed[i] = true;
+    }
+
+    dm_vulkan_submit_one_time_cmd(renderer->gpu.gfx_queue, cmd);
+
+    u32 bits = renderer->gpu.gfx_timestamp_bits;
+    u64 mask = bits >= 64 ? ~0ULL : (1ULL << bits) - 1;
+
+    for(u32 i=0; i<desc->candidate_count; i++)
+    {
+        times[i] = -1;
+        if(!timed[i]) continue;
+
+        u64 timestamps[2];
+        VkResult vr = vkGetQueryPoolResults(device, query_pool, i * 2, 2, sizeof(timestamps), timestamps, sizeof(u64), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+        if(vr != VK_SUCCESS) continue;
+
+        u64 ticks = (timestamps[1] - timestamps[0]) & mask;
+        times[i] = (double)ticks * renderer->gpu.properties.limits.timestampPeriod / DM_VULKAN_TUNE_REPEATS;
+    }
+
+    vkDestroyQueryPool(device, query_pool, DM_VULKAN_ALLOCATOR);
+
+    return true;
+}
+
+bool dm_renderer_tune_compute_pipeline(dm_context *context, dm_compute_tune_desc desc, dm_compute_pipe_desc *tuned)
+{
+    dm_vulkan_renderer *renderer = dm_arena_get_ptr(context->arena, context->renderer.offset);
+
+    if(!desc.candidate_count || desc.candidate_count > DM_COMPUTE_TUNE_MAX_CANDIDATES)
+    {
+        LOG_ERROR("Compute tuning needs between 1 and %u candidates", DM_COMPUTE_TUNE_MAX_CANDIDATES);
+        return false;
+    }
+    if(desc.resource_count > DM_COMPUTE_TUNE_MAX_RESOURCES || sizeof(u32) * desc.resource_count >= renderer->gpu.heap_props.maxPushDataSize)
+    {
+        LOG_ERROR("Compute tuning was given too many resources");
+        return false;
+    }
+
+    // every candidate needs the same room, so checking one covers all of them
+    if(!dm_vulkan_apply_workgroup_size(&desc, desc.candidates[0], tuned)) return false;
+
+    u64 key = dm_vulkan_hash_tune_desc(&desc);
+
+    dm_vulkan_tune_entry cached;
+    if(dm_vulkan_find_tune_result(renderer, key, &cached))
+    {
+        LOG_INFO("Using cached workgroup size %ux%ux%u for %s", cached.size[0], cached.size[1], cached.size[2], desc.pipe.path);
+        return dm_vulkan_apply_workgroup_size(&desc, cached.size, tuned);
+    }
+
+    // nothing to compare without timestamps, the first candidate that fits and builds is as good a guess as any
+    if(!renderer->gpu.gfx_timestamp_bits)
+    {
+        LOG_WARN("Graphics queue has no timestamps, not tuning %s", desc.pipe.path);
+
+        for(u32 i=0; i<desc.candidate_count; i++)
+        {
+            if(!dm_vulkan_workgroup_size_fits(renderer, desc.candidates[i])) continue;
+
+            dm_compute_pipe_desc pipe;
+            dm_vulkan_apply_workgroup_size(&desc, desc.candidates[i], &pipe);
+
+            dm_pipeline pipeline;
+            if(!dm_renderer_create_compute_pipeline(context, pipe, &pipeline)) continue;
+            dm_renderer_destroy_pipeline(context, pipeline);
+
+            *tuned = pipe;
+            return true;
+        }
+
+        LOG_ERROR("No workgroup size candidate could be built for %s", desc.pipe.path);
+        return false;
+    }
+
+    // all candidates compile at the same time on the job workers
+    dm_pipeline pipelines[DM_COMPUTE_TUNE_MAX_CANDIDATES] = { 0 };
+    for(u32 i=0; i<desc.candidate_count; i++)
+    {
+        const u32 *size = desc.candidates[i];
+        if(!dm_vulkan_workgroup_size_fits(renderer, size))
+        {
+            LOG_WARN("Workgroup size %ux%ux%u is too large for this device, skipping", size[0], size[1], size[2]);
+            continue;
+        }
+
+        dm_compute_pipe_desc pipe;
+        dm_vulkan_apply_workgroup_size(&desc, size, &pipe);
+        if(!dm_renderer_create_compute_pipeline_async(context, pipe, (dm_pipeline){ 0 }, &pipelines[i])) pipelines[i] = (dm_pipeline){ 0 };
+    }
+
+    double times[DM_COMPUTE_TUNE_MAX_CANDIDATES];
+    bool result = dm_vulkan_time_workgroup_sizes(context, &desc, pipelines, times);
+
+    for(u32 i=0; i<desc.candidate_count; i++)
+    {
+        if(pipelines[i].type != DM_PIPELINE_TYPE_INVALID) dm_renderer_destroy_pipeline(context, pipelines[i]);
+    }
+    if(!result) return false;
+
+    u32 best = UINT32_MAX;
+    for(u32 i=0; i<desc.candidate_count; i++)
+    {
+        if(times[i] < 0) continue;
+
+        LOG_INFO("Workgroup size %ux%ux%u: %.2f us", desc.candidates[i][0], desc.candidates[i][1], desc.candidates[i][2], times[i] / 1000.0);
+        // strictly faster only, a tie keeps the earlier candidate
+        if(best == UINT32_MAX || times[best] > times[i]) best = i;
+    }
+
+    if(best == UINT32_MAX)
+    {
+        LOG_ERROR("No workgroup size candidate could be run for %s", desc.pipe.path);
+        return false;
+    }
+
+    dm_vulkan_store_tune_result(renderer, key, desc.candidates[best]);
+
+    return dm_vulkan_apply_workgroup_size(&desc, desc.candidates[best], tuned);
+}
+
 /************
  * DECODE VR
  *************/
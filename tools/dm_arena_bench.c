@@ -0,0 +1,142 @@
+// times alloc/reset cycles of the virtual memory arena against malloc/free and the old calloc arena
+// usage: dm_arena_bench [allocs per cycle] [cycles]
+#include "dm.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define DM_ARENA_BENCH_DEFAULT_ALLOCS 4096
+#define DM_ARENA_BENCH_DEFAULT_CYCLES 1000
+#define DM_ARENA_BENCH_MAX_SIZE       256
+
+// the arena before it was backed by reserved virtual memory, one calloc of a fixed capacity
+typedef struct dm_calloc_arena_t
+{
+    size_t size, capacity;
+    u8*    start;
+} dm_calloc_arena;
+
+void* dm_calloc_arena_alloc(dm_calloc_arena *arena, size_t size)
+{
+    size = DM_ALIGN(size, DM_ARENA_ALIGNMENT);
+    if(arena->size + size >= arena->capacity) return NULL;
+
+    arena->size += size;
+    return arena->start + arena->size - size;
+}
+
+double dm_arena_bench_now()
+{
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+// touches every allocation so none of them can be optimized out
+static volatile u8 dm_arena_bench_sink;
+
+void dm_arena_bench_report(const char *name, double seconds, u32 allocs, u32 cycles)
+{
+    double total = (double)allocs * cycles;
+    printf("%-14s %10.3f ms  %8.2f ns/alloc  %10.2f Malloc/s\n", name, seconds * 1e3, seconds * 1e9 / total, total / seconds * 1e-6);
+}
+
+int main(int argc, char **argv)
+{
+    u32 allocs = argc > 1 ? (u32)atoi(argv[1]) : DM_ARENA_BENCH_DEFAULT_ALLOCS;
+    u32 cycles = argc > 2 ? (u32)atoi(argv[2]) : DM_ARENA_BENCH_DEFAULT_CYCLES;
+    if(!allocs || !cycles)
+    {
+        fprintf(stderr, "usage: %s [allocs per cycle] [cycles]\n", argv[0]);
+        return 1;
+    }
+
+    // same pseudo random sizes for every allocator
+    size_t *sizes    = malloc(allocs * sizeof(size_t));
+    void  **pointers = malloc(allocs * sizeof(void*));
+    if(!sizes || !pointers) return 1;
+
+    u32 state = 0x12345678;
+    size_t cycle_size = 0;
+    for(u32 i=0; i<allocs; i++)
+    {
+        state = state * 1664525 + 1013904223;
+        sizes[i] = 1 + (state >> 8) % DM_ARENA_BENCH_MAX_SIZE;
+        cycle_size += DM_ALIGN(sizes[i], DM_ARENA_ALIGNMENT);
+    }
+
+    printf("%u allocs of 1-%d bytes per cycle, %u cycles\n", allocs, DM_ARENA_BENCH_MAX_SIZE, cycles);
+
+    // virtual memory arena, starts small and commits while the first cycle runs
+    dm_arena arena;
+    if(!dm_arena_create(&arena, DM_ARENA_COMMIT_SIZE)) return 1;
+
+    double start = dm_arena_bench_now();
+    for(u32 c=0; c<cycles; c++)
+    {
+        for(u32 i=0; i<allocs; i++)
+        {
+            u8 *ptr = dm_arena_alloc(&arena, sizes[i], NULL);
+            ptr[0] = (u8)i;
+            dm_arena_bench_sink += ptr[0];
+        }
+        dm_arena_reset(&arena);
+    }
+    dm_arena_bench_report("dm_arena", dm_arena_bench_now() - start, allocs, cycles);
+    dm_arena_detroy(&arena);
+
+    // malloc/free, reset frees every allocation of the cycle
+    start = dm_arena_bench_now();
+    for(u32 c=0; c<cycles; c++)
+    {
+        for(u32 i=0; i<allocs; i++)
+        {
+            u8 *ptr = malloc(sizes[i]);
+            ptr[0] = (u8)i;
+            dm_arena_bench_sink += ptr[0];
+            pointers[i] = ptr;
+        }
+        for(u32 i=0; i<allocs; i++)
+        {
+            free(pointers[i]);
+        }
+    }
+    dm_arena_bench_report("malloc", dm_arena_bench_now() - start, allocs, cycles);
+
+    // old arena, sized up front for the whole cycle since it could not grow. it never zeroed on reuse
+    dm_calloc_arena calloc_arena = { .capacity=cycle_size + 1 };
+
+    start = dm_arena_bench_now();
+    calloc_arena.start = calloc(sizeof(u8), calloc_arena.capacity);
+    if(!calloc_arena.start) return 1;
+    for(u32 c=0; c<cycles; c++)
+    {
+        for(u32 i=0; i<allocs; i++)
+        {
+            u8 *ptr = dm_calloc_arena_alloc(&calloc_arena, sizes[i]);
+            ptr[0] = (u8)i;
+            dm_arena_bench_sink += ptr[0];
+        }
+        calloc_arena.size = 0;
+    }
+    dm_arena_bench_report("calloc arena", dm_arena_bench_now() - start, allocs, cycles);
+    free(calloc_arena.start);
+
+    free(pointers);
+    free(sizes);
+
+    return 0;
+}
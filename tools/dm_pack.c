@@ -0,0 +1,420 @@
+// packs a directory into a single dm archive
+// usage: dm_pack [-c none|lz4|zstd] [-l level] <directory> <output>
+#include "dm.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef DM_ZSTD
+#include <zstd.h>
+#endif
+#ifdef DM_LZ4
+#include <lz4.h>
+#include <lz4hc.h>
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+typedef struct dm_pack_file_t
+{
+    char* path;    // on disk
+    char* name;    // relative to the packed directory, '/' separated
+    u64   size;
+
+    dm_archive_entry entry;
+} dm_pack_file;
+
+typedef struct dm_pack_t
+{
+    dm_pack_file* files;
+    u32           count, capacity;
+
+    dm_archive_compression compression;
+    int                    level;
+} dm_pack;
+
+bool dm_pack_add(dm_pack *pack, const char *path, const char *name, u64 size)
+{
+    if(pack->count == pack->capacity)
+    {
+        u32 capacity = pack->capacity ? pack->capacity * 2 : 256;
+        dm_pack_file *files = realloc(pack->files, capacity * sizeof(dm_pack_file));
+        if(!files) return false;
+
+        pack->files    = files;
+        pack->capacity = capacity;
+    }
+
+    dm_pack_file *file = &pack->files[pack->count++];
+    *file = (dm_pack_file){ .path=strdup(path), .name=strdup(name), .size=size };
+
+    return file->path && file->name;
+}
+
+bool dm_pack_walk(dm_pack *pack, const char *directory, const char *prefix)
+{
+    char path[4096], name[4096];
+
+#ifdef _WIN32
+    char search[4096];
+    snprintf(search, sizeof(search), "%s/*", directory);
+
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA(search, &data);
+    if(find == INVALID_HANDLE_VALUE)
+    {
+        LOG_ERROR("Could not open directory: %s", directory);
+        return false;
+    }
+
+    do
+    {
+        const char *entry = data.cFileName;
+        if(!strcmp(entry, ".") || !strcmp(entry, "..")) continue;
+
+        snprintf(path, sizeof(path), "%s/%s", directory, entry);
+        snprintf(name, sizeof(name), "%s%s", prefix, entry);
+
+        if(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+        {
+            strncat(name, "/", sizeof(name) - strlen(name) - 1);
+            if(!dm_pack_walk(pack, path, name)) { FindClose(find); return false; }
+            continue;
+        }
+
+        u64 size = ((u64)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+        if(!dm_pack_add(pack, path, name, size)) { FindClose(find); return false; }
+    } while(FindNextFileA(find, &data));
+
+    FindClose(find);
+#else
+    DIR *dir = opendir(directory);
+    if(!dir)
+    {
+        LOG_ERROR("Could not open directory: %s", directory);
+        return false;
+    }
+
+    struct dirent *entry;
+    while((entry = readdir(dir)))
+    {
+        if(!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, "..")) continue;
+
+        snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+        snprintf(name, sizeof(name), "%s%s", prefix, entry->d_name);
+
+        struct stat st;
+        if(stat(path, &st) != 0)
+        {
+            LOG_ERROR("Could not stat: %s", path);
+            closedir(dir);
+            return false;
+        }
+
+        if(S_ISDIR(st.st_mode))
+        {
+            strncat(name, "/", sizeof(name) - strlen(name) - 1);
+            if(!dm_pack_walk(pack, path, name)) { closedir(dir); return false; }
+            continue;
+        }
+        if(!S_ISREG(st.st_mode)) continue;
+
+        if(!dm_pack_add(pack, path, name, st.st_size)) { closedir(dir); return false; }
+    }
+
+    closedir(dir);
+#endif
+
+    return true;
+}
+
+int dm_pack_compare(const void *a, const void *b)
+{
+    const dm_pack_file *file_a = a;
+    const dm_pack_file *file_b = b;
+
+    if(file_a->entry.hash != file_b->entry.hash) return file_a->entry.hash < file_b->entry.hash ? -1 : 1;
+    return strcmp(file_a->name, file_b->name);
+}
+
+bool dm_pack_write_padding(FILE *fp, u64 size)
+{
+    static const u8 zeros[DM_ARCHIVE_ALIGNMENT] = { 0 };
+
+    while(size)
+    {
+        u64 chunk = size < sizeof(zeros) ? size : sizeof(zeros);
+        if(fwrite(zeros, 1, chunk, fp) != chunk) return false;
+        size -= chunk;
+    }
+
+    return true;
+}
+
+bool dm_pack_read_file(dm_pack_file *file, u8 *buffer)
+{
+    FILE *in = fopen(file->path, "rb");
+    if(!in)
+    {
+        LOG_ERROR("Could not open file: %s", file->path);
+        return false;
+    }
+
+    bool result = fread(buffer, 1, file->size, in) == file->size;
+    fclose(in);
+
+    if(!result) LOG_ERROR("Could not read file: %s", file->path);
+
+    return result;
+}
+
+size_t dm_pack_compress_bound(dm_archive_compression compression, size_t size)
+{
+    switch(compression)
+    {
+#ifdef DM_LZ4
+        case DM_ARCHIVE_COMPRESSION_LZ4:
+        return LZ4_compressBound((int)size);
+#endif
+#ifdef DM_ZSTD
+        case DM_ARCHIVE_COMPRESSION_ZSTD:
+        return ZSTD_compressBound(size);
+#endif
+        default:
+        return size;
+    }
+}
+
+// 0 on failure
+size_t dm_pack_compress_chunk(dm_pack *pack, const u8 *src, size_t src_size, u8 *dst, size_t dst_capacity)
+{
+    switch(pack->compression)
+    {
+#ifdef DM_LZ4
+        case DM_ARCHIVE_COMPRESSION_LZ4:
+        return LZ4_compress_HC((const char*)src, (char*)dst, (int)src_size, (int)dst_capacity, pack->level ? pack->level : LZ4HC_CLEVEL_DEFAULT);
+#endif
+#ifdef DM_ZSTD
+        case DM_ARCHIVE_COMPRESSION_ZSTD:
+        {
+            size_t result = ZSTD_compress(dst, dst_capacity, src, src_size, pack->level ? pack->level : 19);
+            return ZSTD_isError(result) ? 0 : result;
+        }
+#endif
+        default:
+        return 0;
+    }
+}
+
+// worst case for a compressed entry of the given size, offset table included
+u64 dm_pack_packed_bound(dm_pack *pack, u64 size)
+{
+    u64 chunk_count = (size + DM_ARCHIVE_CHUNK_SIZE - 1) / DM_ARCHIVE_CHUNK_SIZE;
+
+    return (chunk_count + 1) * sizeof(u64) + chunk_count * dm_pack_compress_bound(pack->compression, DM_ARCHIVE_CHUNK_SIZE);
+}
+
+// compresses data into chunks behind an offset table, see dm.h for the layout.
+// dst must hold dm_pack_packed_bound bytes.
+// returns false if the result would not be smaller than the input so the file gets stored as is
+bool dm_pack_compress(dm_pack *pack, const u8 *data, u64 size, u8 *dst, u64 *packed_size)
+{
+    if(pack->compression == DM_ARCHIVE_COMPRESSION_NONE || !size) return false;
+
+    u32 chunk_count = (size + DM_ARCHIVE_CHUNK_SIZE - 1) / DM_ARCHIVE_CHUNK_SIZE;
+    u64 *offsets    = (u64*)dst;
+    u64 offset      = (u64)(chunk_count + 1) * sizeof(u64);
+
+    for(u32 i=0; i<chunk_count; i++)
+    {
+        u64 chunk_offset = (u64)i * DM_ARCHIVE_CHUNK_SIZE;
+        u64 chunk_size   = size - chunk_offset < DM_ARCHIVE_CHUNK_SIZE ? size - chunk_offset : DM_ARCHIVE_CHUNK_SIZE;
+        size_t bound     = dm_pack_compress_bound(pack->compression, chunk_size);
+
+        size_t written = dm_pack_compress_chunk(pack, data + chunk_offset, chunk_size, dst + offset, bound);
+        if(!written) return false;
+
+        offsets[i] = offset;
+        offset += written;
+    }
+    offsets[chunk_count] = offset;
+
+    *packed_size = offset;
+
+    return offset < size;
+}
+
+bool dm_pack_write(dm_pack *pack, const char *output)
+{
+    // toc is sorted by name hash so lookups can binary search it
+    for(u32 i=0; i<pack->count; i++)
+    {
+        pack->files[i].entry.hash = dm_hash_fnv1a(pack->files[i].name, strlen(pack->files[i].name));
+    }
+    qsort(pack->files, pack->count, sizeof(dm_pack_file), dm_pack_compare);
+
+    // layout
+    dm_archive_header header = {
+        .magic=DM_ARCHIVE_MAGIC,
+        .version=DM_ARCHIVE_VERSION,
+        .entry_count=pack->count,
+        .alignment=DM_ARCHIVE_ALIGNMENT,
+        .toc_offset=sizeof(dm_archive_header)
+    };
+    header.names_offset = header.toc_offset + (u64)pack->count * sizeof(dm_archive_entry);
+
+    for(u32 i=0; i<pack->count; i++)
+    {
+        dm_pack_file *file = &pack->files[i];
+        size_t length = strlen(file->name);
+
+        if(header.names_size + length > UINT32_MAX)
+        {
+            LOG_ERROR("Name table is too large");
+            return false;
+        }
+
+        file->entry.name_offset = header.names_size;
+        file->entry.name_length = length;
+        header.names_size += length;
+    }
+
+    // write, entry data first since compression decides where each entry lands
+    FILE *fp = fopen(output, "wb");
+    if(!fp)
+    {
+        LOG_ERROR("Could not open output: %s", output);
+        return false;
+    }
+
+    u64 max_size = 0;
+    for(u32 i=0; i<pack->count; i++)
+    {
+        if(pack->files[i].size > max_size) max_size = pack->files[i].size;
+    }
+
+    u8 *data   = malloc(max_size ? max_size : 1);
+    u8 *packed = malloc(dm_pack_packed_bound(pack, max_size));
+    bool result = data && packed;
+    if(!result) LOG_ERROR("Could not allocate %llu bytes", (unsigned long long)max_size);
+
+    u64 written = header.names_offset + header.names_size;
+    u64 packed_total = 0, size_total = 0;
+
+    if(result) result = dm_pack_write_padding(fp, DM_ALIGN(written, (u64)DM_ARCHIVE_ALIGNMENT));
+    written = DM_ALIGN(written, (u64)DM_ARCHIVE_ALIGNMENT);
+
+    for(u32 i=0; result && i<pack->count; i++)
+    {
+        dm_pack_file *file = &pack->files[i];
+        dm_archive_entry *entry = &file->entry;
+
+        result = dm_pack_read_file(file, data);
+        if(!result) break;
+
+        entry->offset     = written;
+        entry->size       = file->size;
+        entry->chunk_size = DM_ARCHIVE_CHUNK_SIZE;
+
+        const u8 *src = data;
+        if(dm_pack_compress(pack, data, file->size, packed, &entry->packed_size))
+        {
+            entry->compression = pack->compression;
+            src = packed;
+        }
+        else
+        {
+            entry->compression = DM_ARCHIVE_COMPRESSION_NONE;
+            entry->packed_size = file->size;
+        }
+
+        result = fwrite(src, 1, entry->packed_size, fp) == entry->packed_size;
+
+        u64 end = entry->offset + entry->packed_size;
+        written = DM_ALIGN(end, (u64)DM_ARCHIVE_ALIGNMENT);
+        if(result && i + 1 < pack->count) result = dm_pack_write_padding(fp, written - end);
+        else                              written = end;
+
+        size_total   += entry->size;
+        packed_total += entry->packed_size;
+    }
+
+    free(packed);
+    free(data);
+
+    // now that every entry is placed, go back for the header, toc and names
+    if(result) result = fseek(fp, 0, SEEK_SET) == 0;
+    if(result) result = fwrite(&header, sizeof(header), 1, fp) == 1;
+    for(u32 i=0; result && i<pack->count; i++)
+    {
+        result = fwrite(&pack->files[i].entry, sizeof(dm_archive_entry), 1, fp) == 1;
+    }
+    for(u32 i=0; result && i<pack->count; i++)
+    {
+        result = fwrite(pack->files[i].name, 1, pack->files[i].entry.name_length, fp) == pack->files[i].entry.name_length;
+    }
+
+    if(fclose(fp) != 0) result = false;
+    if(!result)
+    {
+        LOG_ERROR("Could not write archive: %s", output);
+        remove(output);
+        return false;
+    }
+
+    LOG_INFO("Packed %u files into %s (%llu bytes, %llu of %llu bytes of data)", pack->count, output, (unsigned long long)written, (unsigned long long)packed_total, (unsigned long long)size_total);
+
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    dm_pack pack = { 0 };
+
+    int arg = 1;
+    for(; arg + 1 < argc && argv[arg][0] == '-'; arg += 2)
+    {
+        if(!strcmp(argv[arg], "-l"))
+        {
+            pack.level = atoi(argv[arg + 1]);
+            continue;
+        }
+        if(strcmp(argv[arg], "-c")) break;
+
+        const char *name = argv[arg + 1];
+        if(!strcmp(name, "none")) pack.compression = DM_ARCHIVE_COMPRESSION_NONE;
+#ifdef DM_LZ4
+        else if(!strcmp(name, "lz4")) pack.compression = DM_ARCHIVE_COMPRESSION_LZ4;
+#endif
+#ifdef DM_ZSTD
+        else if(!strcmp(name, "zstd")) pack.compression = DM_ARCHIVE_COMPRESSION_ZSTD;
+#endif
+        else
+        {
+            fprintf(stderr, "unsupported compression: %s\n", name);
+            return 1;
+        }
+    }
+
+    if(argc - arg != 2)
+    {
+        fprintf(stderr, "usage: %s [-c none|lz4|zstd] [-l level] <directory> <output>\n", argv[0]);
+        return 1;
+    }
+
+    bool result = dm_pack_walk(&pack, argv[arg], "") && dm_pack_write(&pack, argv[arg + 1]);
+
+    for(u32 i=0; i<pack.count; i++)
+    {
+        free(pack.files[i].path);
+        free(pack.files[i].name);
+    }
+    free(pack.files);
+
+    return result ? 0 : 1;
+}
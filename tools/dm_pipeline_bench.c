@@ -0,0 +1,127 @@
+// times raster pipeline creation and binding through the public api.
+// measures whichever path the library was built with, so build it with and without
+// DM_VULKAN_SHADER_OBJECT to compare vkCreateGraphicsPipelines against VK_EXT_shader_object
+// usage: dm_pipeline_bench <vertex shader> <fragment shader> [creates] [binds per frame]
+// shader paths are given without extension, like in dm_raster_shader
+#include "dm.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define DM_PIPELINE_BENCH_DEFAULT_CREATES 100
+#define DM_PIPELINE_BENCH_DEFAULT_BINDS   1000
+
+double dm_pipeline_bench_now()
+{
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+int main(int argc, char **argv)
+{
+    if(argc < 3)
+    {
+        fprintf(stderr, "usage: %s <vertex shader> <fragment shader> [creates] [binds per frame]\n", argv[0]);
+        return 1;
+    }
+
+    u32 creates = argc > 3 ? (u32)atoi(argv[3]) : DM_PIPELINE_BENCH_DEFAULT_CREATES;
+    u32 binds   = argc > 4 ? (u32)atoi(argv[4]) : DM_PIPELINE_BENCH_DEFAULT_BINDS;
+    if(!creates || !binds)
+    {
+        fprintf(stderr, "usage: %s <vertex shader> <fragment shader> [creates] [binds per frame]\n", argv[0]);
+        return 1;
+    }
+
+    static dm_context context;
+    if(!dm_init(&context, 640, 480, "dm_pipeline_bench", 0)) return 1;
+
+    dm_raster_pipe_desc desc = { 0 };
+    snprintf(desc.shaders[DM_RASTER_SHADER_STAGE_VERTEX].path, sizeof(desc.shaders[0].path), "%s", argv[1]);
+    snprintf(desc.shaders[DM_RASTER_SHADER_STAGE_FRAGMENT].path, sizeof(desc.shaders[0].path), "%s", argv[2]);
+
+    dm_render_target_desc target_desc = {
+        .color_attachment={ .load_op=DM_RENDER_ATTACHMENT_LOAD_OP_CLEAR, .store_op=DM_RENDER_ATTACHMENT_STORE_OP_STORE },
+        .swapchain=true
+    };
+    dm_resource target;
+    if(!dm_renderer_create_render_target(&context, target_desc, &target))
+    {
+        dm_shutdown(&context);
+        return 1;
+    }
+
+    // first create compiles or loads the spir-v, which stays cached as a variant, so every timed create
+    // after it is only the driver building the pipeline or shader objects
+    dm_pipeline pipeline;
+    if(!dm_renderer_create_raster_pipeline(&context, desc, &pipeline))
+    {
+        dm_shutdown(&context);
+        return 1;
+    }
+    dm_renderer_destroy_pipeline(&context, pipeline);
+
+    double create_time = 0, bind_time = 0;
+    u32 frames = 0;
+
+    // one create per frame so the deferred destroy of the previous one gets retired
+    for(; frames<creates && dm_is_running(&context); frames++)
+    {
+        if(!dm_update_begin(&context)) break;
+
+        double start = dm_pipeline_bench_now();
+        bool created = dm_renderer_create_raster_pipeline(&context, desc, &pipeline);
+        create_time += dm_pipeline_bench_now() - start;
+        if(!created) break;
+
+        if(!dm_render_begin(&context)) break;
+
+        dm_render_command_begin_rendering(&context, target, 0, 0, 0, 1, 1);
+
+        start = dm_pipeline_bench_now();
+        for(u32 i=0; i<binds; i++)
+        {
+            dm_render_command_bind_pipeline(&context, pipeline);
+        }
+        bind_time += dm_pipeline_bench_now() - start;
+
+        dm_render_command_end_rendering(&context, target);
+        if(!dm_render_end(&context)) break;
+
+        dm_update_end(&context);
+
+        dm_renderer_destroy_pipeline(&context, pipeline);
+    }
+
+#ifdef DM_VULKAN_SHADER_OBJECT
+    const char *path = "shader objects where supported";
+#else
+    const char *path = "pipelines";
+#endif
+
+    printf("%s, %u creates, %u binds per frame\n", path, frames, binds);
+    if(frames)
+    {
+        printf("create %10.3f us/pipeline\n", create_time * 1e6 / frames);
+        printf("bind   %10.3f ns/bind\n", bind_time * 1e9 / ((double)frames * binds));
+    }
+
+    dm_renderer_destroy_render_target(&context, target);
+    dm_shutdown(&context);
+
+    return frames == creates ? 0 : 1;
+}
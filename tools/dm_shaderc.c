@@ -0,0 +1,332 @@
+// bakes glsl into optimized spir-v so the runtime can load it without compiling
+// usage: dm_shaderc [-k vertex|fragment|compute] [-e entry] [-D name[=value]]... [-g] [-O0] [-M depfile] <input> <output>
+//   -g keeps debug info, -O0 skips optimization, -M writes a make style depfile listing the includes.
+//   -D bakes one variant of a shader with defines, the runtime compiles those lazily from the glsl otherwise
+//   without -k the stage comes from a #pragma shader_stage() in the source
+#include "dm.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <shaderc/shaderc.h>
+#include <spirv-tools/libspirv.h>
+
+#define DM_SHADERC_MAX_INCLUDES 64
+#define DM_SHADERC_MAX_DEFINES  DM_MAX_SHADER_DEFINES
+
+typedef struct dm_shaderc_args_t
+{
+    const char* input;
+    const char* output;
+    const char* entry;
+    const char* depfile;
+
+    const char* defines[DM_SHADERC_MAX_DEFINES];
+    u32         define_count;
+
+    shaderc_shader_kind kind;
+    bool                debug_info, optimize;
+} dm_shaderc_args;
+
+typedef struct dm_shaderc_include_t
+{
+    shaderc_include_result result;
+    char                   path[4096];
+    void*                  data;
+} dm_shaderc_include;
+
+typedef struct dm_shaderc_includes_t
+{
+    char* paths[DM_SHADERC_MAX_INCLUDES];
+    u32   count;
+} dm_shaderc_includes;
+
+static shaderc_include_result dm_shaderc_include_oom = { .content="out of memory", .content_length=13 };
+
+void* dm_shaderc_read_file(const char *path, size_t *size)
+{
+    FILE *fp = fopen(path, "rb");
+    if(!fp) return NULL;
+
+    fseek(fp, 0, SEEK_END);
+    long file_size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    void *data = file_size >= 0 ? malloc(file_size ? file_size : 1) : NULL;
+    if(data && file_size && fread(data, file_size, 1, fp) != 1)
+    {
+        free(data);
+        data = NULL;
+    }
+    fclose(fp);
+
+    *size = data ? file_size : 0;
+
+    return data;
+}
+
+// "..." includes are relative to the including file, <...> ones to the working directory like the runtime
+shaderc_include_result* dm_shaderc_include_resolve(void *user_data, const char *requested_source, int type, const char *requesting_source, size_t include_depth)
+{
+    dm_shaderc_includes *includes = user_data;
+
+    dm_shaderc_include *include = calloc(1, sizeof(dm_shaderc_include));
+    if(!include) return &dm_shaderc_include_oom;
+    include->result.user_data = include;
+
+    int directory_length = 0;
+    if(type == shaderc_include_type_relative)
+    {
+        const char *slash = strrchr(requesting_source, '/');
+        const char *backslash = strrchr(requesting_source, '\\');
+        if(backslash > slash) slash = backslash;
+        if(slash) directory_length = slash - requesting_source + 1;
+    }
+    snprintf(include->path, sizeof(include->path), "%.*s%s", directory_length, requesting_source, requested_source);
+
+    size_t size;
+    include->data = dm_shaderc_read_file(include->path, &size);
+    if(!include->data)
+    {
+        include->result.content = "could not open include";
+        include->result.content_length = strlen(include->result.content);
+        return &include->result;
+    }
+
+    include->result.source_name        = include->path;
+    include->result.source_name_length = strlen(include->path);
+    include->result.content            = include->data;
+    include->result.content_length     = size;
+
+    for(u32 i=0; i<includes->count; i++)
+    {
+        if(!strcmp(includes->paths[i], include->path)) return &include->result;
+    }
+    if(includes->count < DM_SHADERC_MAX_INCLUDES) includes->paths[includes->count++] = strdup(include->path);
+
+    return &include->result;
+}
+
+void dm_shaderc_include_release(void *user_data, shaderc_include_result *result)
+{
+    if(result == &dm_shaderc_include_oom) return;
+
+    dm_shaderc_include *include = result->user_data;
+
+    free(include->data);
+    free(include);
+}
+
+void dm_shaderc_optimizer_message(spv_message_level_t level, const char *source, const spv_position_t *position, const char *message)
+{
+    switch(level)
+    {
+        case SPV_MSG_FATAL:
+        case SPV_MSG_INTERNAL_ERROR:
+        case SPV_MSG_ERROR:
+        LOG_ERROR("spirv-opt: %s", message);
+        break;
+
+        case SPV_MSG_WARNING:
+        LOG_WARN("spirv-opt: %s", message);
+        break;
+
+        default:
+        break;
+    }
+}
+
+// shaderc already optimizes at performance level, this runs the full spirv-opt performance recipe on top
+// and strips what is only there for debuggers
+bool dm_shaderc_optimize(const dm_shaderc_args *args, const u32 *words, size_t word_count, spv_binary *binary)
+{
+    spv_optimizer_t *optimizer = spvOptimizerCreate(SPV_ENV_VULKAN_1_4);
+    if(!optimizer) return false;
+
+    spvOptimizerSetMessageConsumer(optimizer, dm_shaderc_optimizer_message);
+    spvOptimizerRegisterPerformancePasses(optimizer);
+    if(!args->debug_info)
+    {
+        spvOptimizerRegisterPassFromFlag(optimizer, "--strip-debug");
+        spvOptimizerRegisterPassFromFlag(optimizer, "--strip-nonsemantic");
+    }
+
+    spv_optimizer_options options = spvOptimizerOptionsCreate();
+    spvOptimizerOptionsSetRunValidator(options, true);
+
+    spv_result_t result = spvOptimizerRun(optimizer, words, word_count, binary, options);
+
+    spvOptimizerOptionsDestroy(options);
+    spvOptimizerDestroy(optimizer);
+
+    return result == SPV_SUCCESS;
+}
+
+bool dm_shaderc_write(const char *path, const void *data, size_t size)
+{
+    FILE *fp = fopen(path, "wb");
+    if(!fp)
+    {
+        LOG_ERROR("Could not open output: %s", path);
+        return false;
+    }
+
+    bool result = fwrite(data, size, 1, fp) == 1;
+    if(fclose(fp) != 0) result = false;
+
+    if(!result)
+    {
+        LOG_ERROR("Could not write output: %s", path);
+        remove(path);
+    }
+
+    return result;
+}
+
+bool dm_shaderc_write_depfile(const dm_shaderc_args *args, const dm_shaderc_includes *includes)
+{
+    FILE *fp = fopen(args->depfile, "w");
+    if(!fp)
+    {
+        LOG_ERROR("Could not open depfile: %s", args->depfile);
+        return false;
+    }
+
+    fprintf(fp, "%s: %s", args->output, args->input);
+    for(u32 i=0; i<includes->count; i++)
+    {
+        fprintf(fp, " \\\n  %s", includes->paths[i]);
+    }
+    fprintf(fp, "\n");
+
+    return fclose(fp) == 0;
+}
+
+bool dm_shaderc_compile(const dm_shaderc_args *args)
+{
+    size_t source_size;
+    char *source = dm_shaderc_read_file(args->input, &source_size);
+    if(!source)
+    {
+        LOG_ERROR("Could not read file: %s", args->input);
+        return false;
+    }
+
+    dm_shaderc_includes includes = { 0 };
+
+    shaderc_compiler_t compiler       = shaderc_compiler_initialize();
+    shaderc_compile_options_t options = shaderc_compile_options_initialize();
+
+    shaderc_compile_options_set_target_env(options, shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_4);
+    shaderc_compile_options_set_target_spirv(options, shaderc_spirv_version_1_6);
+    shaderc_compile_options_set_optimization_level(options, args->optimize ? shaderc_optimization_level_performance : shaderc_optimization_level_zero);
+    if(args->debug_info) shaderc_compile_options_set_generate_debug_info(options);
+    shaderc_compile_options_set_include_callbacks(options, dm_shaderc_include_resolve, dm_shaderc_include_release, &includes);
+
+    for(u32 i=0; i<args->define_count; i++)
+    {
+        const char *define = args->defines[i];
+        const char *equals = strchr(define, '=');
+
+        if(equals) shaderc_compile_options_add_macro_definition(options, define, equals - define, equals + 1, strlen(equals + 1));
+        else       shaderc_compile_options_add_macro_definition(options, define, strlen(define), NULL, 0);
+    }
+
+    shaderc_compilation_result_t result = shaderc_compile_into_spv(compiler, source, source_size, args->kind, args->input, args->entry, options);
+    free(source);
+
+    bool success = shaderc_result_get_compilation_status(result) == shaderc_compilation_status_success;
+    if(!success)
+    {
+        LOG_ERROR("Could not compile shader \'%s\'", args->input);
+        LOG_ERROR("%s", shaderc_result_get_error_message(result));
+    }
+
+    if(success && args->optimize)
+    {
+        spv_binary binary = NULL;
+
+        success = dm_shaderc_optimize(args, (const u32*)shaderc_result_get_bytes(result), shaderc_result_get_length(result) / sizeof(u32), &binary);
+        if(success) success = dm_shaderc_write(args->output, binary->code, binary->wordCount * sizeof(u32));
+        else        LOG_ERROR("Could not optimize shader \'%s\'", args->input);
+
+        spvBinaryDestroy(binary);
+    }
+    else if(success)
+    {
+        success = dm_shaderc_write(args->output, shaderc_result_get_bytes(result), shaderc_result_get_length(result));
+    }
+
+    if(success && args->depfile) success = dm_shaderc_write_depfile(args, &includes);
+
+    for(u32 i=0; i<includes.count; i++)
+    {
+        free(includes.paths[i]);
+    }
+
+    shaderc_result_release(result);
+    shaderc_compile_options_release(options);
+    shaderc_compiler_release(compiler);
+
+    return success;
+}
+
+bool dm_shaderc_parse_kind(const char *name, shaderc_shader_kind *kind)
+{
+    if(!strcmp(name, "vertex"))        *kind = shaderc_vertex_shader;
+    else if(!strcmp(name, "fragment")) *kind = shaderc_fragment_shader;
+    else if(!strcmp(name, "compute"))  *kind = shaderc_compute_shader;
+    else return false;
+
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    dm_shaderc_args args = {
+        .entry="main",
+        .kind=shaderc_glsl_infer_from_source,
+        .optimize=true
+    };
+
+    int arg = 1;
+    for(; arg < argc && argv[arg][0] == '-'; arg++)
+    {
+        const char *flag = argv[arg];
+
+        if(!strcmp(flag, "-g"))  { args.debug_info = true; continue; }
+        if(!strcmp(flag, "-O0")) { args.optimize = false; continue; }
+
+        if(arg + 1 == argc) break;
+        const char *value = argv[++arg];
+
+        if(!strcmp(flag, "-e"))      args.entry = value;
+        else if(!strcmp(flag, "-M")) args.depfile = value;
+        else if(!strcmp(flag, "-D"))
+        {
+            if(args.define_count == DM_SHADERC_MAX_DEFINES)
+            {
+                fprintf(stderr, "too many defines, max is %d\n", DM_SHADERC_MAX_DEFINES);
+                return 1;
+            }
+            args.defines[args.define_count++] = value;
+        }
+        else if(!strcmp(flag, "-k") && dm_shaderc_parse_kind(value, &args.kind)) continue;
+        else
+        {
+            fprintf(stderr, "unknown option: %s %s\n", flag, value);
+            return 1;
+        }
+    }
+
+    if(argc - arg != 2)
+    {
+        fprintf(stderr, "usage: %s [-k vertex|fragment|compute] [-e entry] [-D name[=value]]... [-g] [-O0] [-M depfile] <input> <output>\n", argv[0]);
+        return 1;
+    }
+
+    args.input  = argv[arg];
+    args.output = argv[arg + 1];
+
+    return dm_shaderc_compile(&args) ? 0 : 1;
+}